@@ -0,0 +1,69 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTUATORMIXER_HH_
+#define ACTUATORMIXER_HH_
+
+#include <cstddef>
+#include <vector>
+
+/// \brief Mixing matrix from normalised servo channels to actuator
+/// commands.
+///
+/// The matrix is stored row-major with each row padded to a multiple of
+/// four with zeros, so the product is a run of four wide dot products.
+/// These use AVX or SSE2 on x86, NEON on aarch64 and a scalar loop
+/// otherwise.
+class ActuatorMixer
+{
+public:
+    /// \brief Set the matrix.
+    /// \param[in] _rows Number of outputs.
+    /// \param[in] _cols Number of inputs.
+    /// \param[in] _matrix Row-major coefficients, _rows * _cols values.
+    void SetMatrix(size_t _rows, size_t _cols,
+                   const std::vector<double> &_matrix);
+
+    /// \brief Number of outputs.
+    size_t Rows() const;
+
+    /// \brief Number of inputs.
+    size_t Cols() const;
+
+    /// \brief True if the matrix is empty.
+    bool Empty() const;
+
+    /// \brief Compute the outputs.
+    /// \param[in] _in Cols() inputs.
+    /// \param[out] _out Rows() outputs.
+    void Mix(const double *_in, double *_out);
+
+private:
+    size_t rows{0};
+    size_t cols{0};
+
+    /// \brief Padded row length.
+    size_t stride{0};
+
+    /// \brief Padded coefficients.
+    std::vector<double> matrix;
+
+    /// \brief Padded input.
+    std::vector<double> input;
+};
+
+#endif  // ACTUATORMIXER_HH_
@@ -0,0 +1,115 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADAPTIVEBITRATE_HH_
+#define ADAPTIVEBITRATE_HH_
+
+#include <cstdint>
+
+/// \brief Congestion-aware bitrate controller for a video encoder.
+///
+/// The controller is driven by receiver feedback (typically an RTCP
+/// receiver report) and steers the encoder bitrate and keyframe spacing.
+/// It combines a loss-based and a delay-based estimate:
+///
+///   - loss above `lossHigh` decreases the bitrate in proportion to the
+///     loss and shortens the keyframe interval so the decoder recovers,
+///   - a round trip time rising above the observed minimum (queuing in
+///     the bottleneck) backs the bitrate off before loss occurs,
+///   - otherwise the bitrate increases multiplicatively towards `maxKbps`.
+///
+/// The controller has no dependency on GStreamer so it may be driven by
+/// recorded or synthetic reports.
+class AdaptiveBitrateController
+{
+public:
+    /// \brief Controller parameters.
+    struct Params
+    {
+        /// \brief Lower bitrate bound (kbit/s).
+        uint32_t minKbps{200};
+
+        /// \brief Upper bitrate bound (kbit/s).
+        uint32_t maxKbps{4000};
+
+        /// \brief Initial bitrate (kbit/s).
+        uint32_t startKbps{800};
+
+        /// \brief Loss fraction below which the bitrate may increase.
+        double lossLow{0.02};
+
+        /// \brief Loss fraction above which the bitrate is decreased.
+        double lossHigh{0.10};
+
+        /// \brief Queuing delay (ms) above the minimum RTT that is
+        /// treated as congestion.
+        double delayThresholdMs{30.0};
+
+        /// \brief Multiplicative increase per second when uncongested.
+        double increaseRate{0.08};
+
+        /// \brief Multiplicative decrease on delay based congestion.
+        double delayBackoff{0.85};
+
+        /// \brief Keyframe interval (frames) when the link is clean.
+        uint32_t maxKeyInterval{60};
+
+        /// \brief Keyframe interval (frames) while losses are observed.
+        uint32_t minKeyInterval{10};
+    };
+
+    /// \brief Constructor.
+    explicit AdaptiveBitrateController(const Params &_params);
+
+    /// \brief Process a receiver report.
+    /// \param[in] _time Time of the report (s), monotonic.
+    /// \param[in] _fractionLost Fraction of packets lost in [0, 1].
+    /// \param[in] _rttMs Round trip time (ms), negative if unknown.
+    /// \return True if the bitrate or keyframe interval changed.
+    bool Update(double _time, double _fractionLost, double _rttMs);
+
+    /// \brief Current target bitrate (kbit/s).
+    uint32_t BitrateKbps() const;
+
+    /// \brief Current keyframe interval (frames).
+    uint32_t KeyframeInterval() const;
+
+    /// \brief True once if a keyframe should be forced to recover
+    /// from losses. The request is cleared when read.
+    bool TakeKeyframeRequest();
+
+private:
+    /// \brief Controller parameters.
+    Params params;
+
+    /// \brief Target bitrate (kbit/s).
+    double bitrate;
+
+    /// \brief Current keyframe interval (frames).
+    uint32_t keyInterval;
+
+    /// \brief Minimum observed round trip time (ms).
+    double minRttMs{-1.0};
+
+    /// \brief Time of the previous report (s).
+    double lastTime{-1.0};
+
+    /// \brief Set when a keyframe should be forced.
+    bool keyframeRequested{false};
+};
+
+#endif  // ADAPTIVEBITRATE_HH_
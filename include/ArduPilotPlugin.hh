@@ -18,6 +18,9 @@
 #define ARDUPILOTPLUGIN_HH_
 
 #include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
 #include <gz/sim/System.hh>
@@ -29,9 +32,8 @@ namespace sim
 {
 namespace systems
 {
-/// \todo(srmainwaring) handle 16 or 32 based on magic
-
 // The servo packet received from ArduPilot SITL. Defined in SIM_JSON.h.
+// The format is detected from the magic value and the packet size.
 struct servo_packet_16 {
     uint16_t magic;         // 18458 expected magic value
     uint16_t frame_rate;
@@ -46,6 +48,40 @@ struct servo_packet_32 {
     uint16_t pwm[32];
 };
 
+// Extended servo packet: a versioned header followed by `frames` frames
+// of `channels` PWM values each, oldest first. The header is 16 bytes so
+// the PWM values stay aligned. A batch carries consecutive frames, the
+// first numbered frame_count. Only the most recent frame is applied.
+struct servo_packet_ext_header {
+    uint16_t magic;         // 33471 expected magic value
+    uint8_t version;        // 1
+    uint8_t flags;          // servo_ext_flags capabilities of the sender
+    uint16_t frame_rate;
+    uint16_t channels;      // PWM values per frame, at most 32
+    uint16_t frames;        // frames in the batch, at least 1
+    uint16_t reserved;
+    uint32_t frame_count;
+};
+
+// Capabilities advertised in servo_packet_ext_header::flags.
+enum servo_ext_flags : uint8_t {
+    SERVO_EXT_FLAG_NONE = 0,
+    // the sender accepts the binary state frame in reply
+    SERVO_EXT_FLAG_BINARY_STATE = 1 << 0,
+};
+
+// Magic values identifying the servo packet formats.
+constexpr uint16_t kServoMagic16 = 18458;
+constexpr uint16_t kServoMagic32 = 29569;
+constexpr uint16_t kServoMagicExt = 33471;
+constexpr uint8_t kServoExtVersion = 1;
+
+// Largest number of PWM channels in a frame.
+constexpr uint16_t kMaxServoChannels = 32;
+
+// Receive buffer size, large enough for any supported servo packet.
+constexpr size_t kServoBufferSize = 1472;
+
 // Forward declare private data class
 class ArduPilotSocketPrivate;
 class ArduPilotPluginPrivate;
@@ -61,9 +97,32 @@ class ArduPilotPluginPrivate;
 ///    <offset>           command offset
 ///    <servo_max>        upper limit for PWM input
 ///    <servo_min>        lower limit for PWM input
+///    <curve>            optional nonlinear PWM response, applied to the
+///                       PWM normalised to [0, 1] before <multiplier>
+///                       and <offset>. Compiled into a lookup table at load.
+///       <deadband>      normalised input below which the output is zero
+///       <exponent>      output = input^exponent, e.g. 2 for thrust
+///       <table>         piecewise linear <point>input output</point> list,
+///                       replaces <exponent>
 ///    <!-- output to Gazebo -->
 ///    <type>             type of control, VELOCITY, POSITION, EFFORT or COMMAND
 ///    <useForce>         1 if joint forces are applied, 0 to set joint directly
+///    <max_rate>         kinematic POSITION (useForce 0) rate limit
+///    <max_accel>        kinematic POSITION (useForce 0) acceleration limit
+///    <controller>       pid (default) or motor_model, a first-order
+///                       response solved exactly per step and applied as
+///                       a joint velocity, stable at large step sizes,
+///                       or rotor, a first-order rotor speed whose thrust
+///                       and drag torque are applied to the body link
+///                       while the rotor joint only spins visually
+///    <time_constant>    motor_model and rotor time constant in seconds
+///    <rotor>            rotor controller parameters
+///       <thrust_coefficient> thrust = k * w^2 along the joint axis
+///       <torque_coefficient> drag torque = k * w^2 against the spin
+///       <link>          link the wrench is applied to, default the
+///                       joint parent link
+///       <visual_slowdown> joint spin is w / visual_slowdown (default
+///                       10), 0 to hold the joint
 ///    <p_gain>           velocity pid p gain
 ///    <i_gain>           velocity pid i gain
 ///    <d_gain>           velocity pid d gain
@@ -76,15 +135,103 @@ class ArduPilotPluginPrivate;
 ///                       by other plugins
 ///
 ///    <turningDirection> rotor turning direction, 'cw' or 'ccw'
-///    <frequencyCutoff>  filter incoming joint state
-///    <samplingRate>     sampling rate for filtering incoming joint state
+///    <filter>           filter of the joint state fed back to the pid,
+///                       none (default), one_pole, biquad (second-order
+///                       low pass) or notch
+///    <frequencyCutoff>  filter cutoff or notch frequency in Hz
+///    <samplingRate>     filter sampling rate in Hz, 0 (default) for the
+///                       physics update rate
+///    <filter_q>         biquad and notch quality factor (default 0.7071)
+///    <notch_blades>     if set, the notch follows the blade pass
+///                       frequency of the velocity target, no lower than
+///                       frequencyCutoff
 ///    <rotorVelocitySlowdownSim> for rotor aliasing problem, experimental
 ///
+/// <mixer>       optional mixing matrix for controls driven by several
+///               channels, e.g. elevons or V-tails
+///    <input>            "channel" attribute, with optional <servo_min>
+///                       and <servo_max>, the PWM normalised to [-1, 1]
+///    <output>           "joint" attribute naming a <control>, value the
+///                       row of coefficients, one per <input>. The control
+///                       command is multiplier * (row . inputs + offset)
+///                       and the control channel and curve are not used.
+///
+/// <sensor>      range sensor sent as rng_<index>
+///    <type>             sensor type, raycast for a ray cast by the
+///                       RangefinderPlugin world system, otherwise a
+///                       gz.msgs.LaserScan subscription
+///    <index>            rangefinder index from 1
+///    <topic>            LaserScan topic
+///    <link>             raycast: link the ray is attached to
+///    <pose>             raycast: pose relative to the link, along +x
+///    <min_range>        raycast: minimum range in m
+///    <max_range>        raycast: maximum range in m
+/// <optical_flow> synthetic optical flow sent as optical_flow, derived
+///               from the body velocity and rate and the ground distance
+///    <update_rate>      rate in Hz, 0 for every state (default 20)
+///    <noise_stddev>     flow rate noise standard deviation in rad/s
+///    <link>             link of a downward ground distance ray cast by
+///                       the RangefinderPlugin, if not given the height
+///                       above flat ground at z = 0 is used
+///    <pose>             pose of the ray relative to the link, along +x
+///                       (default points down the link z axis)
+///    <min_range>        minimum ground distance in m (default 0.05)
+///    <max_range>        maximum ground distance in m (default 40)
 /// <imuName>     scoped name for the imu sensor
 /// <anemometer>  scoped name for the wind sensor
 /// <connectionTimeoutMaxCount> timeout before giving up on
-///                             controller synchronization
-/// <have_32_channels>    set true if 32 channels are enabled
+///                             controller synchronization, in 10 ms
+///                             units, the default lost_timeout
+/// <connection_health> optional connection health monitor settings,
+///               state changes are published as gz.msgs.StringMsg on
+///               /world/<world>/model/<model>/ardupilot/connection
+///    <degraded_timeout> time in s without a frame before degraded
+///    <lost_timeout>     time in s without a frame before lost
+///    <degraded_rate_fraction> fraction of the advertised frame rate
+///                       below which the link is degraded
+/// <fdm_port_in> port the plugin listens on (default 9002), the base
+///               port when <instance> is set
+/// <instance>    vehicle instance N, the port is fdm_port_in plus
+///               N * instance_port_stride to match SITL -I N. auto takes
+///               N from the trailing digits of the top level model name,
+///               e.g. iris_7, and 0 if there are none
+/// <instance_port_stride> port spacing of instances (default 10)
+/// <rtf_matching> optional matching of the world real time factor to
+///               the speed the controller achieves (e.g. SIM_SPEEDUP),
+///               set through /world/<world>/set_physics, see
+///               RealTimeFactorMatcher.hh. The factor is world-wide,
+///               only the first vehicle loaded with it matches it
+///    <min_factor>       lowest real time factor (default 0.1)
+///    <max_factor>       highest real time factor (default 100)
+///    <period>           wall time in s between adjustments (default 1)
+///    <wait_fraction>    fraction of time waiting on the controller above
+///                       which it sets the pace (default 0.2)
+///    <step_up>          factor to raise a limiting target by (default
+///                       1.25)
+///    <headroom>         margin above a measured factor (default 0.1)
+///    <deadband>         relative change below which the factor is kept
+///                       (default 0.05)
+/// <have_32_channels>    hint that 32 channels are enabled, the servo
+///                       packet format is detected from each packet
+/// <state_format>        json (default), binary (fdm_state_binary_v1 in
+///                       ArduPilotStateFrame.hh) or auto, binary when the
+///                       servo packet advertises SERVO_EXT_FLAG_BINARY_STATE
+/// <impairment>  optional seeded network impairment of the FDM link
+///    <delay>            mean one-way delay in ms
+///    <jitter>           delay jitter in ms
+///    <distribution>     constant, uniform, normal or pareto
+///    <loss>             probability a packet is dropped
+///    <reorder>          probability a packet skips the delay
+///    <duplicate>        probability a packet is delivered twice
+///    <direction>        both (default), send or recv
+///    <seed>             random seed, the same seed gives the same pattern
+/// <low_latency> optional low latency socket profile (Linux)
+///    <rcvbuf>           SO_RCVBUF in bytes
+///    <sndbuf>           SO_SNDBUF in bytes
+///    <busy_poll>        SO_BUSY_POLL in us
+///    <priority>         SO_PRIORITY
+///    <spin>             receive on a dedicated spinning thread
+///    <spin_cpu>         cpu to pin the spinning thread to
 ///
 class GZ_SIM_VISIBLE ArduPilotPlugin:
   public gz::sim::System,
@@ -143,10 +290,37 @@ class GZ_SIM_VISIBLE ArduPilotPlugin:
       sdf::ElementPtr _sdf,
       gz::sim::EntityComponentManager &_ecm);
 
+  /// \brief Load the rotor controller parameters of a control
+  private: void LoadRotor(
+      sdf::ElementPtr _sdf,
+      Control &_control,
+      gz::sim::EntityComponentManager &_ecm);
+
+  /// \brief Load the mixing matrix
+  private: void LoadMixer(sdf::ElementPtr _sdf);
+
+  /// \brief Load the synthetic optical flow sensor
+  private: void LoadOpticalFlow(
+      sdf::ElementPtr _sdf,
+      gz::sim::EntityComponentManager &_ecm);
+
   /// \brief Update the control surfaces controllers.
   /// \param[in] _info Update information provided by the server.
   private: void OnUpdate();
 
+  /// \brief Filter the joint state of all controls.
+  /// \param[in] _dt time step size since last update.
+  private: void UpdateJointStateFilters(
+      const double _dt,
+      const gz::sim::EntityComponentManager &_ecm);
+
+  /// \brief Adjust the world real time factor to the controller speed.
+  /// \param[in] _info Update info.
+  /// \param[in] _recvStart Wall time the servo packet wait started.
+  private: void UpdateRealTimeFactor(
+      const gz::sim::UpdateInfo &_info,
+      const std::chrono::steady_clock::time_point &_recvStart);
+
   /// \brief Update PID Joint controllers.
   /// \param[in] _dt time step size since last update.
   private: void ApplyMotorForces(
@@ -162,19 +336,32 @@ class GZ_SIM_VISIBLE ArduPilotPlugin:
   private: bool ReceiveServoPacket();
 
   /// \brief Update the motor commands given servo PWM values
-  private: void UpdateMotorCommands(const std::array<uint16_t, 32> &_pwm);
+  /// \param[in] _pwm PWM values, indexed by channel.
+  /// \param[in] _channels Number of PWM values.
+  private: void UpdateMotorCommands(const uint16_t *_pwm, size_t _channels);
 
-  /// \brief Create the state JSON
-  private: void CreateStateJSON(
+  /// \brief Create the state, as JSON or as the binary state frame
+  private: void CreateState(
       double _simTime,
       const gz::sim::EntityComponentManager &_ecm) const;
 
   /// \brief Send state to ArduPilot
   private: void SendState() const;
 
+  /// \brief Load the vehicle instance that offsets the FDM port
+  /// \return False if the instance is invalid
+  private: bool LoadInstance(
+      sdf::ElementPtr _sdf,
+      const gz::sim::EntityComponentManager &_ecm);
+
   /// \brief Initialise flight dynamics model socket
   private: bool InitSockets(sdf::ElementPtr _sdf) const;
 
+  /// \brief Accumulate and periodically log the latency from sending a
+  /// state to receiving a servo packet when the link is impaired or in
+  /// the low latency profile, with the socket statistics.
+  private: void ReportLinkLatency();
+
   /// \brief Private data pointer.
   private: std::unique_ptr<ArduPilotPluginPrivate> dataPtr;
 };
@@ -0,0 +1,154 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARDUPILOTSTATEFRAME_HH_
+#define ARDUPILOTSTATEFRAME_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// \brief Binary flight dynamics state sent to ArduPilot in place of the
+/// JSON state.
+///
+/// The layout is fixed and little-endian, with no padding, and carries
+/// the same values as the JSON state:
+///
+///   timestamp   simulation time (s)
+///   gyro        body angular velocity (rad/s), FRD
+///   accel_body  body specific force (m/s^2), FRD
+///   position    position (m), NED
+///   quaternion  attitude w, x, y, z, NED to FRD
+///   velocity    velocity (m/s), NED
+///   rng         range sensor distances (m), the first range_count valid
+///   windvane    apparent wind direction (rad) and speed (m/s) in the
+///               body frame, valid if STATE_FLAG_WINDVANE is set
+///
+/// Optional blocks follow the frame when their flag is set, and length
+/// is the size of the frame including them:
+///
+///   fdm_state_flow_v1   if STATE_FLAG_OPTICAL_FLOW is set
+///
+/// The header only depends on the C++ standard library so it may be used
+/// by the receiving peer as a reference decoder.
+struct fdm_state_binary_v1 {
+    uint16_t magic;             // 30181 expected magic value
+    uint8_t version;            // 1
+    uint8_t flags;              // state_binary_flags
+    uint16_t length;            // frame size including optional blocks
+    uint8_t range_count;        // valid entries in rng
+    uint8_t reserved0;
+    uint32_t frame_count;       // last servo frame_count received
+    uint32_t reserved1;
+    double timestamp;
+    double gyro[3];
+    double accel_body[3];
+    double position[3];
+    double quaternion[4];
+    double velocity[3];
+    double rng[6];
+    double wind_direction;
+    double wind_speed;
+};
+
+static_assert(sizeof(fdm_state_binary_v1) == 216,
+              "fdm_state_binary_v1 layout must not change");
+
+/// \brief Synthetic optical flow, appended to the state frame.
+///
+///   flow_rate   flow about the body x and y axes (rad/s), including the
+///               body rate as reported by a flow sensor
+///   body_rate   body angular rate about x and y (rad/s)
+///   distance    ground distance along the sensor axis (m)
+///   quality     0 (invalid) to 255
+struct fdm_state_flow_v1 {
+    double flow_rate[2];
+    double body_rate[2];
+    double distance;
+    uint8_t quality;
+    uint8_t reserved[7];
+};
+
+static_assert(sizeof(fdm_state_flow_v1) == 48,
+              "fdm_state_flow_v1 layout must not change");
+
+/// \brief A state frame with room for all optional blocks.
+struct fdm_state_binary_frame {
+    fdm_state_binary_v1 state;
+    fdm_state_flow_v1 flow;
+};
+
+static_assert(sizeof(fdm_state_binary_frame) ==
+              sizeof(fdm_state_binary_v1) + sizeof(fdm_state_flow_v1),
+              "fdm_state_binary_frame must not be padded");
+
+/// \brief Flags in fdm_state_binary_v1::flags.
+enum state_binary_flags : uint8_t {
+    STATE_FLAG_NONE = 0,
+    STATE_FLAG_WINDVANE = 1 << 0,
+    STATE_FLAG_OPTICAL_FLOW = 1 << 1,
+};
+
+/// \brief Magic value identifying the binary state frame.
+constexpr uint16_t kStateBinaryMagic = 30181;
+
+/// \brief Version of the binary state frame.
+constexpr uint8_t kStateBinaryVersion = 1;
+
+/// \brief Reference decoder for the binary state frame.
+///
+/// \param[in] _buf Received datagram.
+/// \param[in] _size Size of the datagram in bytes.
+/// \param[out] _state Decoded state.
+/// \return True if the datagram is a binary state frame of a supported
+/// version, false if it should be handled otherwise (e.g. as JSON).
+inline bool decode_state_binary(const void *_buf, size_t _size,
+                                fdm_state_binary_v1 &_state)
+{
+    if (_size < sizeof(fdm_state_binary_v1)) {
+        return false;
+    }
+    std::memcpy(&_state, _buf, sizeof(_state));
+    return _state.magic == kStateBinaryMagic &&
+           _state.version == kStateBinaryVersion &&
+           _state.length >= sizeof(fdm_state_binary_v1) &&
+           _state.length <= _size &&
+           _state.range_count <= 6;
+}
+
+/// \brief Reference decoder for the optical flow block.
+///
+/// \param[in] _buf Received datagram.
+/// \param[in] _state State decoded from it by decode_state_binary.
+/// \param[out] _flow Decoded optical flow.
+/// \return True if the frame carries optical flow.
+inline bool decode_state_flow(const void *_buf,
+                              const fdm_state_binary_v1 &_state,
+                              fdm_state_flow_v1 &_flow)
+{
+    if ((_state.flags & STATE_FLAG_OPTICAL_FLOW) == 0 ||
+        _state.length < sizeof(fdm_state_binary_frame)) {
+        return false;
+    }
+    std::memcpy(&_flow,
+                static_cast<const uint8_t *>(_buf) +
+                    sizeof(fdm_state_binary_v1),
+                sizeof(_flow));
+    return true;
+}
+
+#endif  // ARDUPILOTSTATEFRAME_HH_
@@ -0,0 +1,145 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLLISIONSCENE_HH_
+#define COLLISIONSCENE_HH_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gz/math/Pose3.hh>
+#include <gz/sim/Entity.hh>
+#include <gz/sim/EntityComponentManager.hh>
+#include <gz/sim/Types.hh>
+#include <sdf/Geometry.hh>
+
+#include "RayCastScene.hh"
+
+/// \brief Keeps a RayCastScene in step with the collisions of a world.
+///
+/// Collisions are added as their entities are created and removed with
+/// them. Only the links of non-static models are tracked for motion, so
+/// a static world costs nothing per step once built. Objects are grouped
+/// by their top level model.
+class CollisionScene
+{
+public:
+    /// \brief Add, remove and move collisions, then update the hierarchy.
+    /// \param[in] _ecm The entity component manager.
+    void Update(gz::sim::EntityComponentManager &_ecm);
+
+    /// \brief The ray cast scene.
+    const RayCastScene &Scene() const;
+
+    /// \brief The collision entity of a scene object.
+    gz::sim::Entity CollisionEntity(uint32_t _object) const;
+
+private:
+    /// \brief A collision attached to a moving link.
+    struct Dynamic
+    {
+        gz::sim::Entity link;
+        gz::math::Pose3d linkPose;
+        gz::math::Pose3d offset;
+        uint32_t object;
+    };
+
+    /// \brief Add a collision to the scene.
+    void AddCollision(const gz::sim::EntityComponentManager &_ecm,
+                      gz::sim::Entity _collision,
+                      const sdf::Geometry &_geometry,
+                      const gz::math::Pose3d &_pose,
+                      gz::sim::Entity _link);
+
+    /// \brief Load a mesh into the scene, cached by file and scale.
+    /// \return False if the mesh could not be loaded.
+    bool LoadMesh(const sdf::Geometry &_geometry, uint32_t &_mesh);
+
+    /// \brief The ray cast scene.
+    RayCastScene scene;
+
+    /// \brief Collision entity of each scene object.
+    std::vector<gz::sim::Entity> collisions;
+
+    /// \brief Scene object of each collision entity.
+    std::unordered_map<gz::sim::Entity, uint32_t> objects;
+
+    /// \brief Collisions attached to moving links.
+    std::vector<Dynamic> dynamics;
+
+    /// \brief Moving links added in this update.
+    std::vector<gz::sim::Entity> newLinks;
+
+    /// \brief Scene meshes by file and scale.
+    std::unordered_map<std::string, uint32_t> meshes;
+
+    /// \brief Set once the collisions present at start are added.
+    bool initialized{false};
+
+    /// \brief Set once unsupported geometry has been reported.
+    bool warned{false};
+};
+
+/// \brief The CollisionScene of a world, shared by the systems that
+/// query it.
+///
+/// The rangefinder and picking systems cast against the same collisions,
+/// so they share one scene per world rather than each building and
+/// refitting its own. The first system to update it in a step refits it,
+/// the others find it current. The registry lives in the CollisionScene
+/// library, which both plugins link, so it is common to them.
+class SharedCollisionScene
+{
+public:
+    /// \brief The scene of a world, created on first use and destroyed
+    /// with its last user.
+    /// \param[in] _world World name.
+    static std::shared_ptr<SharedCollisionScene> ForWorld(
+        const std::string &_world);
+
+    /// \brief Update the scene unless it is already current for this step.
+    /// \param[in] _info The update info of the step.
+    /// \param[in] _ecm The entity component manager.
+    /// \note The mutex must be held.
+    void Update(const gz::sim::UpdateInfo &_info,
+                gz::sim::EntityComponentManager &_ecm);
+
+    /// \brief The collisions.
+    /// \note The mutex must be held by threads other than the simulation
+    /// thread.
+    const CollisionScene &Collisions() const;
+
+    /// \brief Protects the scene from queries on other threads.
+    std::mutex mutex;
+
+private:
+    /// \brief The collisions.
+    CollisionScene collisions;
+
+    /// \brief The step of the last update, identified by its iteration
+    /// and wall time as both stay the same while paused.
+    uint64_t iterations{0};
+    std::chrono::steady_clock::duration realTime{0};
+    bool updated{false};
+};
+
+#endif  // COLLISIONSCENE_HH_
@@ -0,0 +1,124 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONNECTIONHEALTHMONITOR_HH_
+#define CONNECTIONHEALTHMONITOR_HH_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+/// \brief Time based health of the link to the ArduPilot controller.
+///
+/// The simulation thread reports each servo frame it receives and the
+/// monitor classifies the link on its own thread against monotonic
+/// deadlines, so the simulation never blocks to find out the controller
+/// has gone:
+///
+///   - CONNECTING until the first frame,
+///   - ONLINE while frames arrive within `degradedTimeout` at a rate near
+///     the one the controller advertises,
+///   - DEGRADED if a frame is late or the observed rate falls below
+///     `degradedRateFraction` of the advertised rate,
+///   - LOST if no frame arrives within `lostTimeout`, until the next one.
+///
+/// The observed rate is measured in simulation time, so it does not
+/// depend on the real time factor. The deadlines are measured in wall
+/// time and are held while the monitor is inactive, e.g. when the
+/// simulation is paused.
+class ConnectionHealthMonitor
+{
+public:
+    /// \brief Link state.
+    enum class State : uint8_t
+    {
+        CONNECTING,
+        ONLINE,
+        DEGRADED,
+        LOST
+    };
+
+    /// \brief Monitor parameters.
+    struct Params
+    {
+        /// \brief Time (s) without a frame before the link is degraded.
+        double degradedTimeout{0.05};
+
+        /// \brief Time (s) without a frame before the link is lost.
+        double lostTimeout{0.5};
+
+        /// \brief Fraction of the advertised frame rate below which the
+        /// link is degraded, 0 to disable the rate check.
+        double degradedRateFraction{0.5};
+
+        /// \brief Period (s) at which the monitor thread checks the link.
+        double checkPeriod{0.01};
+    };
+
+    /// \brief Called on the monitor thread when the state changes.
+    using Callback = std::function<void(State _from, State _to)>;
+
+    /// \brief Constructor, the thread is started by Start.
+    explicit ConnectionHealthMonitor(const Params &_params);
+
+    /// \brief Destructor, stops the thread.
+    ~ConnectionHealthMonitor();
+
+    /// \brief Start the monitor thread.
+    /// \param[in] _callback Called on each state change, may be empty.
+    void Start(Callback _callback);
+
+    /// \brief Stop the monitor thread.
+    void Stop();
+
+    /// \brief Report a received frame. Called on the simulation thread,
+    /// does not block.
+    /// \param[in] _simTime Simulation time of the frame (s).
+    /// \param[in] _frameRate Frame rate advertised by the controller (Hz).
+    void OnFrame(double _simTime, uint16_t _frameRate);
+
+    /// \brief Hold the deadlines while inactive. Does not block.
+    void SetActive(bool _active);
+
+    /// \brief The current state.
+    State CurrentState() const;
+
+    /// \brief Observed frame rate in simulation time (Hz).
+    double ObservedRate() const;
+
+    /// \brief The parameters.
+    const Params &Parameters() const;
+
+    /// \brief Name of a state.
+    static const char *StateName(State _state);
+
+private:
+    /// \brief Monitor thread loop.
+    void Run();
+
+    /// \brief Classify the link at a wall time (ns).
+    State Classify(int64_t _now) const;
+
+    /// \brief Parameters.
+    Params params;
+
+    /// \brief Thread and shared state.
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+#endif  // CONNECTIONHEALTHMONITOR_HH_
@@ -39,11 +39,19 @@ namespace systems {
 /// Parameters
 ///  <udp_host>            the UDP host IP, defaults to 127.0.0.1
 ///  <udp_port>            the UDP port, defaults to 5600
+///  <mosaic>              tile several cameras into one stream (world plugin)
+///  <simulcast>           several encodings of the one camera, see below
+///  <pipeline>            custom gst_parse_launch description for the
+///                        elements after the appsrc, see below
 ///  <rtmp_location>       the RTMP location
 ///  <use_basic_pipeline>  set to true if not using <rtmp_location>
 ///  <use_cuda>            set to true to use CUDA (if available)
+///  <adaptive_bitrate>    adapt the basic pipeline to RTCP feedback
 ///  <image_topic>         the camera image topic
 ///  <enable_topic>        the topic to enable / disable video streaming
+///  <resolution_topic>    the topic to request a lower output resolution
+///  <output_width>        initial output width, defaults to camera width
+///  <output_height>       initial output height, defaults to camera height
 ///
 /// Start streaming
 ///   assumes: <enable_topic>/camera/enable_streaming<enable_topic>
@@ -58,6 +66,74 @@ namespace systems {
 ///       ! rtph264depay ! avdec_h264 ! videoconvert
 ///       ! autovideosink sync=false
 ///
+/// Simulcast
+///
+///   Each <stream> in a <simulcast> block is a branch with its own scaled
+///   size, encoder bitrate (kbit/s) and RTP/UDP sink. The camera image is
+///   converted to I420 once, and the branches scale the I420 planes.
+///   <udp_host> and <udp_port> default to the plugin values, with the port
+///   incremented for each stream. A zero width or height keeps the input
+///   size.
+///
+///   <simulcast>
+///     <stream><width>320</width><height>240</height>
+///       <bitrate>200</bitrate><udp_port>5600</udp_port></stream>
+///     <stream><bitrate>4000</bitrate><udp_port>5601</udp_port></stream>
+///   </simulcast>
+///
+/// Adaptive bitrate
+///
+///   With <use_basic_pipeline> an <adaptive_bitrate> block routes the RTP
+///   stream through an rtpbin, sends RTCP sender reports to <rtcp_port>
+///   (default <udp_port> + 1) and listens for receiver reports on
+///   <rtcp_listen_port> (default <udp_port> + 5). Packet loss and a rising
+///   round trip time reduce the encoder bitrate (kbit/s), a clean link
+///   raises it again. Keyframes are forced more often while losses are
+///   reported. tests/abr_loopback.sh is a receiver that returns reports
+///   over a rate limited, lossy link.
+///
+///   <adaptive_bitrate>
+///     <min_bitrate>200</min_bitrate>
+///     <max_bitrate>4000</max_bitrate>
+///     <start_bitrate>800</start_bitrate>
+///   </adaptive_bitrate>
+///
+/// Mosaic
+///
+///   When attached to a world with a <mosaic> block the plugin subscribes
+///   to several camera image topics, tiles them into one frame and streams
+///   it with a single pipeline and encoder. The first <image_topic> paces
+///   the stream. The enable and resolution topics default to
+///   /world/<world>/mosaic/enable_streaming and .../output_resolution.
+///
+///   <mosaic>
+///     <columns>2</columns>
+///     <tile_width>640</tile_width>
+///     <tile_height>360</tile_height>
+///     <image_topic>/world/.../camera/image</image_topic>
+///     <image_topic>/world/.../fpv_camera/image</image_topic>
+///   </mosaic>
+///
+/// Custom pipelines
+///
+///   The <pipeline> description is instantiated after an I420 appsrc and
+///   takes priority over the built-in pipelines. The placeholders {host},
+///   {port}, {width}, {height} and {fps} are substituted from the plugin
+///   parameters and image size. The description is parsed and checked
+///   against the appsrc caps at load time, and the negotiated caps are
+///   reported when streaming starts. Avoid hard-coding {width} and {height}
+///   in a capsfilter if the output resolution is changed at runtime.
+///
+///   <pipeline>x264enc bitrate=800 tune=zerolatency ! rtph264pay
+///       ! udpsink host={host} port={port}</pipeline>
+///
+/// Change the output resolution while streaming (0 0 restores the camera
+/// resolution). The caps are renegotiated without restarting the stream:
+///   assumes: <resolution_topic>/camera/output_resolution<resolution_topic>
+///
+///   gz topic -t "/camera/output_resolution" -m gz.msgs.Vector2d
+///       -p "x: 320, y: 240"
+///
 class GstCameraPlugin :
     public System,
     public ISystemConfigure,
@@ -0,0 +1,132 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOINTSTATEFILTERBANK_HH_
+#define JOINTSTATEFILTERBANK_HH_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// \brief A bank of filters, one per control channel, run in one pass.
+///
+/// Every filter is a biquad in transposed direct form II. A one-pole low
+/// pass and an unfiltered channel are biquads with some coefficients
+/// zero, so all channels share one code path. Coefficients and state are
+/// held as structures of arrays padded to a multiple of four channels,
+/// and a step filters four channels at a time using AVX or SSE2 on x86,
+/// NEON on aarch64 and a scalar loop otherwise.
+class JointStateFilterBank
+{
+public:
+    /// \brief Filter types.
+    enum class Type
+    {
+        /// \brief Pass the input through.
+        NONE,
+
+        /// \brief First-order low pass.
+        ONE_POLE,
+
+        /// \brief Second-order low pass.
+        BIQUAD,
+
+        /// \brief Second-order notch.
+        NOTCH
+    };
+
+    /// \brief Parse a filter type name.
+    /// \param[in] _name none, one_pole, biquad or notch.
+    /// \param[out] _type The type.
+    /// \return False if the name is not recognised.
+    static bool ParseType(const std::string &_name, Type &_type);
+
+    /// \brief Set the number of channels, all unfiltered.
+    void Resize(size_t _size);
+
+    /// \brief Number of channels.
+    size_t Size() const;
+
+    /// \brief True if any channel is filtered.
+    bool Enabled() const;
+
+    /// \brief Configure a channel.
+    /// \param[in] _channel Channel index.
+    /// \param[in] _type Filter type.
+    /// \param[in] _frequency Cutoff or notch frequency (Hz).
+    /// \param[in] _q Quality factor of the biquad and notch.
+    /// \param[in] _sampleRate Sample rate (Hz), 0 to follow the step rate.
+    void Configure(size_t _channel, Type _type, double _frequency,
+                   double _q, double _sampleRate);
+
+    /// \brief Move the cutoff or notch frequency of a channel, keeping
+    /// its state.
+    void SetFrequency(size_t _channel, double _frequency);
+
+    /// \brief Set the step rate used by channels without a sample rate.
+    void SetStepRate(double _rate);
+
+    /// \brief Filter one sample of every channel.
+    /// \param[in] _in Size() inputs.
+    /// \param[out] _out Size() outputs.
+    ///
+    /// The first sample of a channel sets its state to the steady state
+    /// for that input, so filtering does not start from zero.
+    void Process(const double *_in, double *_out);
+
+private:
+    /// \brief Channel settings.
+    struct Channel
+    {
+        Type type{Type::NONE};
+        double frequency{0.0};
+        double q{0.7071};
+        double sampleRate{0.0};
+        bool primed{false};
+    };
+
+    /// \brief Compute the coefficients of a channel.
+    void Design(size_t _channel);
+
+    /// \brief Set the state of a channel to the steady state for _value.
+    void Prime(size_t _channel, double _value);
+
+    std::vector<Channel> channels;
+
+    /// \brief Step rate (Hz).
+    double stepRate{0.0};
+
+    /// \brief Padded channel count.
+    size_t stride{0};
+
+    /// \brief Coefficients, with a0 normalised to one.
+    std::vector<double> b0;
+    std::vector<double> b1;
+    std::vector<double> b2;
+    std::vector<double> a1;
+    std::vector<double> a2;
+
+    /// \brief State.
+    std::vector<double> z1;
+    std::vector<double> z2;
+
+    /// \brief Padded input and output.
+    std::vector<double> input;
+    std::vector<double> output;
+};
+
+#endif  // JOINTSTATEFILTERBANK_HH_
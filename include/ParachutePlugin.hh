@@ -33,18 +33,52 @@ namespace systems {
 ///   `<parent_link>` The link in the target model to attach the parachute.
 ///   Required.
 ///
+///   `<mode>` Either `model` or `drag`. In `model` mode the parachute model
+///   is spawned and attached with a detachable joint. In `drag` mode the
+///   parachute is modelled as an aerodynamic drag force on the parent link
+///   and no bodies or joints are created.
+///   The default value is: `model`.
+///
 ///   `<child_model>` The name of the parachute model.
-///   Required.
+///   Required in `model` mode.
 ///
 ///   `<child_link>` The base link of the parachute model (bridle point).
-///   Required.
+///   Required in `model` mode.
 ///
 ///   `<child_pose>` The relative pose of parent link to the child link.
+///   In `drag` mode the position is the point where the drag is applied.
 ///   The default value is: `0, 0, 0, 0, 0, 0`.
 ///
 ///   `<cmd_topic>` The topic to receive  the parachute release command.
 ///   The default value is: `/model/<model_name>/parachute/cmd_release`.
 ///
+/// ## Drag mode parameters:
+///
+///   The drag force is `F = -0.5 rho Cd A(t) |v| v` where `v` is the
+///   velocity of the parent link relative to the air. The canopy area
+///   inflates from zero to `<area>` over `<inflation_time>` following
+///   `A(t) = area * (t / inflation_time)^inflation_exponent`.
+///
+///   `<drag_coefficient>` The canopy drag coefficient.
+///   The default value is: `1.5`.
+///
+///   `<area>` The reference area of the inflated canopy (m^2).
+///   The default value is: `1.0`.
+///
+///   `<inflation_time>` Time from release to full inflation (s).
+///   The default value is: `1.0`.
+///
+///   `<inflation_exponent>` The exponent of the area growth.
+///   The default value is: `2.0`.
+///
+///   `<air_density>` The air density (kg/m^3).
+///   The default value is: `1.225`.
+///
+///   `<canopy_visual>` Add a visual-only canopy to the parent link when
+///   released. The canopy trails the link along the airflow at
+///   `<riser_length>` (m), default `2.0`.
+///   The default value is: `true`.
+///
 class ParachutePlugin :
     public System,
     public ISystemPreUpdate,
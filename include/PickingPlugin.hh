@@ -0,0 +1,93 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PICKINGPLUGIN_HH_
+#define PICKINGPLUGIN_HH_
+
+#include <memory>
+
+#include <gz/sim/System.hh>
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+/// \brief World system answering "what is at this pixel or along this
+/// ray" queries on the CPU.
+///
+/// The world collisions are held in the bounding volume hierarchy of
+/// the RangefinderPlugin (see CollisionScene.hh), maintained as entities
+/// are created, removed and moved. Queries are served from the transport
+/// thread against the scene of the last step, so no selection pass is
+/// rendered and many queries may be answered per frame.
+///
+/// ## Services
+///
+///   `/world/<world>/pick/ray` gz.msgs.Double_V -> gz.msgs.Pose_V.
+///   Six values per ray: the origin and direction in the world frame.
+///
+///   `/world/<world>/pick/pixel` gz.msgs.Double_V -> gz.msgs.Pose_V.
+///   Two values per query: image coordinates (u, v) with (0, 0) at the
+///   top left corner of the image, so pixel centres are at half pixels.
+///   The scoped name of the camera sensor is given in the request header
+///   with the key `camera`. Rays are cast from the pose and the current
+///   horizontal field of view of the camera, between its clip planes,
+///   and do not hit the model carrying the camera.
+///
+/// The response holds one pose per query: the position is the hit point
+/// in the world frame, the id the collision entity and the name its
+/// scoped name. Queries that hit nothing have id 0 and an empty name.
+///
+/// ## System Parameters:
+///
+///   `<max_range>` Maximum range (m) of ray queries.
+///   The default value is: `1000`.
+///
+class PickingPlugin :
+    public System,
+    public ISystemConfigure,
+    public ISystemPreUpdate
+{
+  /// \brief Destructor
+  public: virtual ~PickingPlugin();
+
+  /// \brief Constructor
+  public: PickingPlugin();
+
+  // Documentation inherited
+  public: void Configure(const Entity &_entity,
+                         const std::shared_ptr<const sdf::Element> &_sdf,
+                         EntityComponentManager &_ecm,
+                         EventManager &) final;
+
+  // Documentation inherited
+  public: void PreUpdate(const gz::sim::UpdateInfo &_info,
+                         gz::sim::EntityComponentManager &_ecm) final;
+
+  /// \internal
+  /// \brief Private implementation
+  private: class Impl;
+  private: std::unique_ptr<Impl> impl;
+};
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+#endif  // PICKINGPLUGIN_HH_
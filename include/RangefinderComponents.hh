@@ -0,0 +1,76 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANGEFINDERCOMPONENTS_HH_
+#define RANGEFINDERCOMPONENTS_HH_
+
+#include <istream>
+#include <limits>
+#include <ostream>
+
+#include <gz/sim/components/Component.hh>
+#include <gz/sim/components/Factory.hh>
+#include <gz/sim/config.hh>
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace components {
+
+/// \brief A single ray rangefinder evaluated by the RangefinderPlugin.
+struct RaycastRangefinderData
+{
+  /// \brief Minimum range (m), closer surfaces are not detected.
+  double minRange{0.2};
+
+  /// \brief Maximum range (m).
+  double maxRange{40.0};
+
+  /// \brief Distance (m) to the first surface in range, infinity if
+  /// there is no return. Set by the RangefinderPlugin.
+  double range{std::numeric_limits<double>::infinity()};
+};
+
+inline std::ostream &operator<<(std::ostream &_out,
+    const RaycastRangefinderData &_data)
+{
+  _out << _data.minRange << " " << _data.maxRange << " " << _data.range;
+  return _out;
+}
+
+inline std::istream &operator>>(std::istream &_in,
+    RaycastRangefinderData &_data)
+{
+  _in >> _data.minRange >> _data.maxRange >> _data.range;
+  return _in;
+}
+
+/// \brief Rangefinder ray along the x axis of the entity.
+///
+/// The entity also needs Pose and ParentEntity components placing it
+/// relative to a link. The ray does not hit the model it belongs to.
+using RaycastRangefinder =
+    Component<RaycastRangefinderData, class RaycastRangefinderTag>;
+GZ_SIM_REGISTER_COMPONENT("ardupilot_gazebo.components.RaycastRangefinder",
+    RaycastRangefinder)
+
+}  // namespace components
+}
+}  // namespace sim
+}  // namespace gz
+
+#endif  // RANGEFINDERCOMPONENTS_HH_
@@ -0,0 +1,84 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANGEFINDERPLUGIN_HH_
+#define RANGEFINDERPLUGIN_HH_
+
+#include <memory>
+
+#include <gz/sim/System.hh>
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+/// \brief World system casting rangefinder rays on the CPU.
+///
+/// The collision geometry of the world is held in a bounding volume
+/// hierarchy (see RayCastScene.hh) that is built once and refit when
+/// non-static models move. Every step the rays of all entities with a
+/// `RaycastRangefinder` component (see RangefinderComponents.hh) are cast
+/// in one batch and the ranges written back to the components, so no
+/// render engine is needed.
+///
+/// The ArduPilotPlugin creates these entities for range sensors of type
+/// `raycast` and sends the ranges in the `rng_N` fields.
+///
+/// Boxes, spheres, cylinders, planes and meshes are supported. Capsules
+/// and ellipsoids are approximated by their bounding cylinder and box,
+/// heightmaps are not supported.
+///
+/// ## System Parameters:
+///
+///   `<update_rate>` Rate (Hz) at which the rays are cast, 0 for every
+///   step.
+///   The default value is: `0`.
+///
+class RangefinderPlugin :
+    public System,
+    public ISystemConfigure,
+    public ISystemPreUpdate
+{
+  /// \brief Destructor
+  public: virtual ~RangefinderPlugin();
+
+  /// \brief Constructor
+  public: RangefinderPlugin();
+
+  // Documentation inherited
+  public: void Configure(const Entity &_entity,
+                         const std::shared_ptr<const sdf::Element> &_sdf,
+                         EntityComponentManager &_ecm,
+                         EventManager &) final;
+
+  // Documentation inherited
+  public: void PreUpdate(const gz::sim::UpdateInfo &_info,
+                         gz::sim::EntityComponentManager &_ecm) final;
+
+  /// \internal
+  /// \brief Private implementation
+  private: class Impl;
+  private: std::unique_ptr<Impl> impl;
+};
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+#endif  // RANGEFINDERPLUGIN_HH_
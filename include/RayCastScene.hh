@@ -0,0 +1,321 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RAYCASTSCENE_HH_
+#define RAYCASTSCENE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <gz/math/Pose3.hh>
+#include <gz/math/Vector3.hh>
+
+/// \brief Bounding volume hierarchy over axis aligned boxes.
+///
+/// Nodes are stored depth first so a child always follows its parent,
+/// which lets the bounds be refit in a single reverse pass.
+class RayCastBvh
+{
+public:
+    /// \brief A node, a leaf if count > 0.
+    struct Node
+    {
+        double min[3];
+        double max[3];
+        /// \brief First item of a leaf, or the right child of an interior
+        /// node (the left child is the next node).
+        uint32_t index;
+        /// \brief Number of items in a leaf, 0 for an interior node.
+        uint32_t count;
+    };
+
+    /// \brief Build the hierarchy.
+    /// \param[in] _min Lower bound of each item, three values per item.
+    /// \param[in] _max Upper bound of each item, three values per item.
+    void Build(const std::vector<double> &_min,
+               const std::vector<double> &_max);
+
+    /// \brief Refit the node bounds to changed item bounds, keeping the
+    /// topology.
+    void Refit(const std::vector<double> &_min,
+               const std::vector<double> &_max);
+
+    /// \brief Visit the items whose bounds intersect a ray, nearest node
+    /// first.
+    ///
+    /// \param[in] _origin Ray origin.
+    /// \param[in] _invDir Component-wise inverse of the ray direction.
+    /// \param[in] _tMin Start of the ray interval.
+    /// \param[in,out] _tMax End of the ray interval, reduced by the
+    /// visitor when it finds a hit.
+    /// \param[in] _visit Called as `_visit(item, _tMax)`.
+    template <typename Visitor>
+    void Traverse(const double _origin[3], const double _invDir[3],
+                  double _tMin, double &_tMax, Visitor &&_visit) const;
+
+    /// \brief Items in leaf order.
+    const std::vector<uint32_t> &Items() const { return items; }
+
+    /// \brief True if the hierarchy has no items.
+    bool Empty() const { return nodes.empty(); }
+
+private:
+    /// \brief Build the subtree of items [_begin, _end).
+    void BuildNode(uint32_t _begin, uint32_t _end,
+                   const std::vector<double> &_min,
+                   const std::vector<double> &_max,
+                   const std::vector<double> &_centre);
+
+    /// \brief Nodes, the root first.
+    std::vector<Node> nodes;
+
+    /// \brief Item indices referenced by the leaves.
+    std::vector<uint32_t> items;
+};
+
+/// \brief CPU ray casting against collision shapes.
+///
+/// Objects are primitive shapes or triangle meshes placed with a pose.
+/// A top level hierarchy over the world bounds of the objects is built
+/// once and refit when objects move; each mesh has its own hierarchy in
+/// its local frame that is built once when the mesh is added.
+///
+/// The scene only depends on gz-math so it may be used outside a
+/// simulation.
+class RayCastScene
+{
+public:
+    /// \brief Shape of an object.
+    enum class ShapeType
+    {
+        /// \brief Box centred on the origin, size is the box size. A plane
+        /// is a box with zero height.
+        BOX,
+        /// \brief Sphere, size.X() is the radius.
+        SPHERE,
+        /// \brief Cylinder along z, size.X() is the radius and size.Z()
+        /// the length.
+        CYLINDER,
+        /// \brief Triangle mesh added with AddMesh.
+        MESH
+    };
+
+    /// \brief Shape description.
+    struct Shape
+    {
+        ShapeType type{ShapeType::BOX};
+        gz::math::Vector3d size;
+        /// \brief Mesh index for ShapeType::MESH.
+        uint32_t mesh{0};
+    };
+
+    /// \brief A ray, the direction must be a unit vector.
+    struct Ray
+    {
+        gz::math::Vector3d origin;
+        gz::math::Vector3d direction{1, 0, 0};
+        double minRange{0.0};
+        double maxRange{std::numeric_limits<double>::infinity()};
+        /// \brief Objects in this group are not hit, 0 for none.
+        uint64_t ignoreGroup{0};
+    };
+
+    /// \brief Result of a ray cast.
+    struct Hit
+    {
+        /// \brief Distance along the ray, infinity if nothing was hit.
+        double distance{std::numeric_limits<double>::infinity()};
+        /// \brief Object hit, valid if distance is finite.
+        uint32_t object{0};
+    };
+
+    /// \brief Add a triangle mesh.
+    /// \param[in] _vertices Vertices in the mesh frame, scaled.
+    /// \param[in] _indices Three vertex indices per triangle.
+    /// \return Mesh index for Shape::mesh.
+    uint32_t AddMesh(const std::vector<gz::math::Vector3d> &_vertices,
+                     const std::vector<uint32_t> &_indices);
+
+    /// \brief Add an object.
+    /// \param[in] _shape The object shape.
+    /// \param[in] _pose The object pose in the world frame.
+    /// \param[in] _group Group of the object, e.g. its model.
+    /// \return Object index.
+    uint32_t AddObject(const Shape &_shape, const gz::math::Pose3d &_pose,
+                       uint64_t _group);
+
+    /// \brief Number of objects.
+    size_t ObjectCount() const;
+
+    /// \brief Group of an object.
+    uint64_t ObjectGroup(uint32_t _object) const;
+
+    /// \brief Move an object, the hierarchy is refit on Update.
+    void SetPose(uint32_t _object, const gz::math::Pose3d &_pose);
+
+    /// \brief Remove an object, it is no longer hit. The indices of the
+    /// other objects are unchanged.
+    void RemoveObject(uint32_t _object);
+
+    /// \brief Build the hierarchy if objects were added, otherwise refit
+    /// it if objects moved.
+    void Update();
+
+    /// \brief Cast a batch of rays.
+    /// \param[in] _rays Rays to cast.
+    /// \param[out] _hits One result per ray.
+    /// \param[in] _count Number of rays.
+    void Cast(const Ray *_rays, Hit *_hits, size_t _count) const;
+
+private:
+    /// \brief A triangle mesh with its hierarchy.
+    struct Mesh
+    {
+        std::vector<gz::math::Vector3d> vertices;
+        std::vector<uint32_t> indices;
+        RayCastBvh bvh;
+    };
+
+    /// \brief Distance to an object along a ray in the object frame,
+    /// infinity if no hit in [_tMin, _tMax].
+    double Intersect(uint32_t _object, const gz::math::Vector3d &_origin,
+                     const gz::math::Vector3d &_dir, double _tMin,
+                     double _tMax) const;
+
+    /// \brief Update the world bounds of an object.
+    void UpdateBounds(uint32_t _object);
+
+    /// \brief Object shapes.
+    std::vector<Shape> shapes;
+
+    /// \brief Object poses in the world frame.
+    std::vector<gz::math::Pose3d> poses;
+
+    /// \brief Object groups.
+    std::vector<uint64_t> groups;
+
+    /// \brief Set for removed objects.
+    std::vector<bool> removed;
+
+    /// \brief Object bounds in the world frame, three values per object.
+    std::vector<double> boundsMin, boundsMax;
+
+    /// \brief Meshes referenced by the objects.
+    std::vector<Mesh> meshes;
+
+    /// \brief Top level hierarchy over the objects.
+    RayCastBvh bvh;
+
+    /// \brief Set when objects were added.
+    bool rebuild{false};
+
+    /// \brief Set when objects moved.
+    bool refit{false};
+};
+
+//////////////////////////////////////////////////
+template <typename Visitor>
+void RayCastBvh::Traverse(const double _origin[3], const double _invDir[3],
+                          double _tMin, double &_tMax,
+                          Visitor &&_visit) const
+{
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    // slab test, returns the entry distance or infinity
+    auto enter = [&](const Node &_node) -> double
+    {
+        double t0 = _tMin;
+        double t1 = _tMax;
+        for (int k = 0; k < 3; ++k)
+        {
+            double a = (_node.min[k] - _origin[k]) * _invDir[k];
+            double b = (_node.max[k] - _origin[k]) * _invDir[k];
+            // 0 * inf is nan for a ray in the slab plane, treat as inside
+            if (a != a) a = -std::numeric_limits<double>::infinity();
+            if (b != b) b = std::numeric_limits<double>::infinity();
+            if (a > b) std::swap(a, b);
+            t0 = a > t0 ? a : t0;
+            t1 = b < t1 ? b : t1;
+        }
+        return t0 <= t1 ? t0 : std::numeric_limits<double>::infinity();
+    };
+
+    // stack of nodes with their entry distance
+    std::pair<uint32_t, double> stack[64];
+    int top = 0;
+    const double tRoot = enter(nodes[0]);
+    if (tRoot == std::numeric_limits<double>::infinity())
+    {
+        return;
+    }
+    stack[top++] = {0, tRoot};
+    while (top > 0)
+    {
+        const auto entry = stack[--top];
+        if (entry.second > _tMax)
+        {
+            // a closer hit was found since the node was pushed
+            continue;
+        }
+        const Node &node = nodes[entry.first];
+        if (node.count > 0)
+        {
+            for (uint32_t i = 0; i < node.count; ++i)
+            {
+                _visit(items[node.index + i], _tMax);
+            }
+            continue;
+        }
+
+        // push the far child first so the near child is visited first
+        const uint32_t left = entry.first + 1;
+        const uint32_t right = node.index;
+        const double tl = enter(nodes[left]);
+        const double tr = enter(nodes[right]);
+        const bool hitLeft = tl != std::numeric_limits<double>::infinity();
+        const bool hitRight = tr != std::numeric_limits<double>::infinity();
+        if (hitLeft && hitRight)
+        {
+            if (tl <= tr)
+            {
+                stack[top++] = {right, tr};
+                stack[top++] = {left, tl};
+            }
+            else
+            {
+                stack[top++] = {left, tl};
+                stack[top++] = {right, tr};
+            }
+        }
+        else if (hitLeft)
+        {
+            stack[top++] = {left, tl};
+        }
+        else if (hitRight)
+        {
+            stack[top++] = {right, tr};
+        }
+    }
+}
+
+#endif  // RAYCASTSCENE_HH_
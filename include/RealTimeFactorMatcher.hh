@@ -0,0 +1,137 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIMEFACTORMATCHER_HH_
+#define REALTIMEFACTORMATCHER_HH_
+
+#include <cstdint>
+
+/// \brief Matches the simulation real time factor target to the speed
+/// the ArduPilot controller achieves.
+///
+/// Over each window of wall time the matcher measures:
+///
+///   - the real time factor the simulation achieved,
+///   - the controller's factor, the frames received times their period
+///     1 / frame_rate per second of wall time,
+///   - the fraction of wall time spent waiting for a servo packet.
+///
+/// In lock-step the two sides advance together and the slower one sets
+/// the pace. If the simulation waits on the controller for more than
+/// `waitFraction` of the window the controller is the limit, and the
+/// target follows its factor. If the simulation reaches its target
+/// without waiting it is being held back by the target, so the target is
+/// raised by `stepUp` to probe for more. Otherwise the simulation itself
+/// is the limit and the target follows what it achieves. Without
+/// lock-step the target follows the controller's factor.
+///
+/// The target is kept within [minFactor, maxFactor], with `headroom` so
+/// the target is never the limit, and a new target is only reported if
+/// it differs from the current one by more than `deadband`.
+class RealTimeFactorMatcher
+{
+public:
+    /// \brief Matcher parameters.
+    struct Params
+    {
+        /// \brief Lowest target.
+        double minFactor{0.1};
+
+        /// \brief Highest target.
+        double maxFactor{100.0};
+
+        /// \brief Window of wall time (s) between adjustments.
+        double period{1.0};
+
+        /// \brief Fraction of the window spent waiting on the controller
+        /// above which the controller is the limit.
+        double waitFraction{0.2};
+
+        /// \brief Factor the target is raised by when it is the limit.
+        double stepUp{1.25};
+
+        /// \brief Margin above a measured factor for the target.
+        double headroom{0.1};
+
+        /// \brief Relative change below which the target is kept.
+        double deadband{0.05};
+
+        /// \brief True if the controller runs in lock-step.
+        bool lockStep{true};
+    };
+
+    /// \brief Constructor.
+    explicit RealTimeFactorMatcher(const Params &_params);
+
+    /// \brief Set the current target and restart the window.
+    /// \param[in] _target Target factor, 0 or less if unlimited.
+    /// \param[in] _wallTime Wall time (s).
+    /// \param[in] _simTime Simulation time (s).
+    void Reset(double _target, double _wallTime, double _simTime);
+
+    /// \brief Report time spent waiting for a servo packet.
+    /// \param[in] _seconds Wall time (s).
+    void AddWait(double _seconds);
+
+    /// \brief Report a received servo frame.
+    /// \param[in] _frameRate Frame rate advertised by the controller (Hz).
+    void AddFrame(uint16_t _frameRate);
+
+    /// \brief Close the window if it has elapsed and adjust the target.
+    /// \param[in] _wallTime Wall time (s).
+    /// \param[in] _simTime Simulation time (s).
+    /// \param[out] _target The new target, if there is one.
+    /// \return True if the target changed.
+    bool Update(double _wallTime, double _simTime, double &_target);
+
+    /// \brief The current target, 0 or less if unlimited.
+    double Target() const;
+
+    /// \brief Real time factor achieved in the last window.
+    double AchievedFactor() const;
+
+    /// \brief Controller factor in the last window.
+    double ControllerFactor() const;
+
+    /// \brief Fraction of the last window spent waiting.
+    double WaitFraction() const;
+
+    /// \brief The parameters.
+    const Params &Parameters() const;
+
+private:
+    Params params;
+
+    /// \brief Current target, 0 or less if unlimited.
+    double target{1.0};
+
+    /// \brief Start of the window.
+    double windowWall{0.0};
+    double windowSim{0.0};
+
+    /// \brief Accumulated over the window.
+    double waitSum{0.0};
+    double controllerSum{0.0};
+    uint32_t frames{0};
+
+    /// \brief Measured over the last window.
+    double achieved{0.0};
+    double controller{0.0};
+    double wait{0.0};
+};
+
+#endif  // REALTIMEFACTORMATCHER_HH_
@@ -1,81 +1,331 @@
-/*
-   Copyright (C) 2024 ardupilot.org
-
-   This program is free software: you can redistribute it and/or modify
-   it under the terms of the GNU Lesser General Public License as published by
-   the Free Software Foundation, either version 3 of the License, or
-   (at your option) any later version.
-
-   This program is distributed in the hope that it will be useful,
-   but WITHOUT ANY WARRANTY; without even the implied warranty of
-   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-   GNU General Public License for more details.
-
-   You should have received a copy of the GNU Lesser General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.
- */
-
-#ifndef SOCKETUDP_HH_
-#define SOCKETUDP_HH_
-
-#include <fcntl.h>
-#include <unistd.h>
-
-#ifdef _WIN32
-#include <winsock2.h>
-#include <Ws2tcpip.h>
-#else
-
-#include <sys/ioctl.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <netinet/tcp.h>
-#include <arpa/inet.h>
-#include <sys/select.h>
-
-#endif
-
-/// \brief Simple UDP socket handling class.
-class SocketUDP {
-public:
-    /// \brief Constructor.
-    SocketUDP(bool reuseaddress, bool blocking);
-
-    /// \brief Destructor.
-    ~SocketUDP();
-
-    /// \brief Bind socket to address and port.
-    bool bind(const char *address, uint16_t port);
-
-    /// \brief Set reuse address option.
-    bool set_reuseaddress();
-
-    /// \brief Set blocking state.
-    bool set_blocking(bool blocking);
-
-    /// \brief Send data to address and port.
-    ssize_t
-    sendto(const void *buf, size_t size, const char *address, uint16_t port);
-
-    /// \brief Receive data.
-    ssize_t recv(void *pkt, size_t size, uint32_t timeout_ms);
-
-    /// \brief Get last client address and port
-    void get_client_address(const char *&ip_addr, uint16_t &port);
-
-private:
-    /// \brief File descriptor.
-    struct sockaddr_in in_addr{};
-
-    /// \brief File descriptor.
-    int fd = -1;
-
-    /// \brief Poll for incoming data with timeout.
-    bool pollin(uint32_t timeout_ms);
-
-    /// \brief Make a sockaddr_in struct from address and port.
-    void make_sockaddr(const char *address, uint16_t port,
-                       struct sockaddr_in &sockaddr);
-};
-
-#endif  // SOCKETUDP_HH_
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOCKETUDP_HH_
+#define SOCKETUDP_HH_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <Ws2tcpip.h>
+#else
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+
+#endif
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+/// \brief Network impairment applied to datagrams sent and received by
+/// a SocketUDP, for testing the tolerance of a link to latency and loss.
+///
+/// Decisions are drawn from a generator seeded with `seed`, so a given
+/// sequence of datagrams is impaired the same way on every run. Delays
+/// are measured on the steady clock.
+struct UDPImpairment {
+    /// \brief Delay distribution about the mean delay.
+    enum class Distribution {
+        CONSTANT,
+        UNIFORM,
+        NORMAL,
+        PARETO
+    };
+
+    /// \brief Seed for the impairment random generator.
+    uint32_t seed = 0;
+
+    /// \brief Mean one-way delay (ms).
+    double delay_ms = 0.0;
+
+    /// \brief Jitter (ms). Half-width for UNIFORM, standard deviation for
+    /// NORMAL and scale of the tail for PARETO.
+    double jitter_ms = 0.0;
+
+    /// \brief Distribution of the jitter.
+    Distribution distribution = Distribution::CONSTANT;
+
+    /// \brief Probability a datagram is dropped.
+    double loss = 0.0;
+
+    /// \brief Probability a datagram skips the delay and overtakes
+    /// datagrams already in flight.
+    double reorder = 0.0;
+
+    /// \brief Probability a datagram is delivered twice.
+    double duplicate = 0.0;
+
+    /// \brief Impair datagrams sent by the socket.
+    bool impair_send = true;
+
+    /// \brief Impair datagrams received by the socket.
+    bool impair_recv = true;
+
+    /// \brief True if any impairment is configured.
+    bool enabled() const;
+};
+
+/// \brief Counters for one direction of an impaired socket.
+struct UDPImpairmentStats {
+    /// \brief Datagrams delivered.
+    uint64_t delivered = 0;
+
+    /// \brief Datagrams dropped.
+    uint64_t dropped = 0;
+
+    /// \brief Extra copies delivered.
+    uint64_t duplicated = 0;
+
+    /// \brief Datagrams that overtook earlier datagrams.
+    uint64_t reordered = 0;
+
+    /// \brief Sum of the added delay of delivered datagrams (ms).
+    double delay_sum_ms = 0.0;
+
+    /// \brief Largest added delay of a delivered datagram (ms).
+    double delay_max_ms = 0.0;
+};
+
+/// \brief Low-latency socket options.
+///
+/// Zero or negative values leave the system default. SO_BUSY_POLL,
+/// SO_PRIORITY, receive timestamps and CPU pinning are Linux only.
+struct UDPLowLatency {
+    /// \brief Receive buffer size (bytes), SO_RCVBUF.
+    int rcvbuf = 0;
+
+    /// \brief Send buffer size (bytes), SO_SNDBUF.
+    int sndbuf = 0;
+
+    /// \brief Busy poll time (us) for blocking receives, SO_BUSY_POLL.
+    int busy_poll_us = 0;
+
+    /// \brief Socket priority, SO_PRIORITY. Negative to leave unset.
+    int priority = -1;
+
+    /// \brief Receive on a dedicated thread that spins on the socket
+    /// instead of waiting in select.
+    bool spin = false;
+
+    /// \brief CPU to pin the spinning receiver to, negative for any.
+    int spin_cpu = -1;
+};
+
+/// \brief Latency from the kernel receive timestamp of a datagram to
+/// its delivery to the caller of SocketUDP::recv.
+struct UDPWakeupStats {
+    /// \brief Datagrams with a receive timestamp.
+    uint64_t count = 0;
+
+    /// \brief Sum of the latency (us).
+    double sum_us = 0.0;
+
+    /// \brief Largest latency (us).
+    double max_us = 0.0;
+};
+
+/// \brief Simple UDP socket handling class.
+class SocketUDP {
+public:
+    /// \brief Constructor.
+    SocketUDP(bool reuseaddress, bool blocking);
+
+    /// \brief Destructor.
+    ~SocketUDP();
+
+    /// \brief Bind socket to address and port.
+    bool bind(const char *address, uint16_t port);
+
+    /// \brief Set reuse address option.
+    bool set_reuseaddress();
+
+    /// \brief Set blocking state.
+    bool set_blocking(bool blocking);
+
+    /// \brief Send data to address and port.
+    ssize_t
+    sendto(const void *buf, size_t size, const char *address, uint16_t port);
+
+    /// \brief Receive data.
+    ssize_t recv(void *pkt, size_t size, uint32_t timeout_ms);
+
+    /// \brief Get last client address and port
+    void get_client_address(const char *&ip_addr, uint16_t &port);
+
+    /// \brief Enable an impairment stage on send and receive.
+    void set_impairment(const UDPImpairment &impairment);
+
+    /// \brief True if an impairment stage is active.
+    bool impaired() const { return impairment.enabled(); }
+
+    /// \brief Impairment counters for sent datagrams.
+    const UDPImpairmentStats &send_stats() const { return tx_stats; }
+
+    /// \brief Impairment counters for received datagrams.
+    const UDPImpairmentStats &recv_stats() const { return rx_stats; }
+
+    /// \brief Apply low-latency socket options and optionally start a
+    /// spinning receiver. Returns false if an option could not be set.
+    bool set_low_latency(const UDPLowLatency &options);
+
+    /// \brief True if low-latency options are active.
+    bool low_latency() const { return low_latency_enabled; }
+
+    /// \brief Receive wakeup latency since the last reset.
+    const UDPWakeupStats &wakeup_stats() const { return wakeup; }
+
+    /// \brief Reset the receive wakeup latency.
+    void reset_wakeup_stats() { wakeup = UDPWakeupStats(); }
+
+private:
+    /// \brief A datagram held by the impairment stage or spinning
+    /// receiver.
+    struct Datagram {
+        std::vector<uint8_t> data;
+        struct sockaddr_in addr{};
+        int64_t enqueued_us = 0;
+        int64_t due_us = 0;
+        int64_t rx_ns = -1;
+    };
+
+    /// \brief Dedicated receiver thread state.
+    struct SpinReceiver;
+
+    /// \brief Timing wheel of delayed datagrams with 1 ms slots.
+    ///
+    /// Datagrams due beyond one revolution stay in their slot until a
+    /// later pass. Due datagrams move to a FIFO in due time order.
+    class TimingWheel {
+    public:
+        TimingWheel();
+
+        /// \brief Insert a datagram.
+        void insert(Datagram &&dgram);
+
+        /// \brief Move datagrams due by now_us to the ready FIFO.
+        void advance(int64_t now_us);
+
+        /// \brief Due time of the next datagram, -1 if empty.
+        int64_t next_due() const;
+
+        /// \brief Datagrams ready for delivery.
+        std::deque<Datagram> ready;
+
+    private:
+        static constexpr size_t kSlots = 1024;
+        static constexpr int64_t kSlotUs = 1000;
+
+        std::vector<std::vector<Datagram>> slots;
+        int64_t cursor_us = -1;
+        size_t pending = 0;
+    };
+
+    /// \brief Apply loss, duplication, reordering and delay to a datagram.
+    void impair(Datagram &&dgram, TimingWheel &wheel,
+                UDPImpairmentStats &stats);
+
+    /// \brief Sample the delay of a datagram (us).
+    int64_t sample_delay_us();
+
+    /// \brief Send delayed datagrams that are due.
+    void flush_send(int64_t now_us);
+
+    /// \brief Move datagrams waiting in the socket into the impairment.
+    void drain_recv(int64_t now_us);
+
+    /// \brief Wait until a datagram can be read.
+    bool wait_readable(uint32_t timeout_ms);
+
+    /// \brief Read one datagram without waiting, -1 if none.
+    ssize_t read_datagram(void *buf, size_t size, struct sockaddr_in &addr);
+
+    /// \brief Read one datagram from the socket with its kernel receive
+    /// timestamp (ns, CLOCK_REALTIME), -1 if unavailable.
+    ssize_t recv_datagram(void *buf, size_t size, struct sockaddr_in &addr,
+                          int64_t &rx_ns);
+
+    /// \brief Spinning receiver loop.
+    void spin_receive();
+
+    /// \brief Stop the spinning receiver.
+    void stop_spin_receiver();
+
+    /// \brief Receive through the impairment stage.
+    ssize_t recv_impaired(void *buf, size_t size, uint32_t timeout_ms);
+
+    /// \brief Record a delivered datagram.
+    static void record(UDPImpairmentStats &stats, const Datagram &dgram,
+                       int64_t now_us);
+
+    /// \brief Steady clock time (us).
+    static int64_t now_us();
+
+    /// \brief Impairment configuration.
+    UDPImpairment impairment;
+
+    /// \brief Impairment random generator.
+    std::mt19937 rng;
+
+    /// \brief Delayed datagrams to send.
+    TimingWheel tx_wheel;
+
+    /// \brief Delayed datagrams received.
+    TimingWheel rx_wheel;
+
+    /// \brief Counters for sent datagrams.
+    UDPImpairmentStats tx_stats;
+
+    /// \brief Counters for received datagrams.
+    UDPImpairmentStats rx_stats;
+
+    /// \brief True if low-latency options are active.
+    bool low_latency_enabled = false;
+
+    /// \brief True if the socket reports receive timestamps.
+    bool timestamps = false;
+
+    /// \brief Receive wakeup latency.
+    UDPWakeupStats wakeup;
+
+    /// \brief Spinning receiver, null unless enabled.
+    std::unique_ptr<SpinReceiver> spinner;
+
+    /// \brief File descriptor.
+    struct sockaddr_in in_addr{};
+
+    /// \brief File descriptor.
+    int fd = -1;
+
+    /// \brief Poll for incoming data with timeout.
+    bool pollin(uint32_t timeout_ms);
+
+    /// \brief Make a sockaddr_in struct from address and port.
+    void make_sockaddr(const char *address, uint16_t port,
+                       struct sockaddr_in &sockaddr);
+};
+
+#endif  // SOCKETUDP_HH_
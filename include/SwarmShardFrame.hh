@@ -0,0 +1,105 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWARMSHARDFRAME_HH_
+#define SWARMSHARDFRAME_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// \brief Vehicle states exchanged between the shards of a swarm.
+///
+/// Each shard sends one datagram per sync step to every other shard: a
+/// header followed by `count` vehicle records. The layout is fixed and
+/// little-endian, with no padding:
+///
+///   sim_time    simulation time of the step (ns)
+///   instance    vehicle instance, the number in its model name
+///   position    world position (m)
+///   quaternion  world orientation w, x, y, z
+///
+/// Single precision keeps a record to 32 bytes and is accurate to well
+/// under a millimetre within a few kilometres of the origin.
+struct swarm_shard_header_v1 {
+    uint16_t magic;             // 24613 expected magic value
+    uint8_t version;            // 1
+    uint8_t shard;              // index of the sending shard
+    uint16_t count;             // vehicle records following the header
+    uint16_t reserved;
+    uint64_t sim_time;
+};
+
+static_assert(sizeof(swarm_shard_header_v1) == 16,
+              "swarm_shard_header_v1 layout must not change");
+
+struct swarm_shard_vehicle_v1 {
+    uint32_t instance;
+    float position[3];
+    float quaternion[4];
+};
+
+static_assert(sizeof(swarm_shard_vehicle_v1) == 32,
+              "swarm_shard_vehicle_v1 layout must not change");
+
+/// \brief Magic value identifying a shard frame.
+constexpr uint16_t kSwarmShardMagic = 24613;
+
+/// \brief Version of the shard frame.
+constexpr uint8_t kSwarmShardVersion = 1;
+
+/// \brief Most vehicle records in one datagram.
+constexpr uint16_t kSwarmShardMaxVehicles = 2000;
+
+/// \brief Size of a frame with _count vehicles in bytes.
+inline size_t swarm_shard_frame_size(size_t _count)
+{
+    return sizeof(swarm_shard_header_v1) +
+           _count * sizeof(swarm_shard_vehicle_v1);
+}
+
+/// \brief Decode the header of a shard frame.
+///
+/// \param[in] _buf Received datagram.
+/// \param[in] _size Size of the datagram in bytes.
+/// \param[out] _header Decoded header.
+/// \return True if the datagram is a complete shard frame of a supported
+/// version.
+inline bool decode_swarm_shard_header(const void *_buf, size_t _size,
+                                      swarm_shard_header_v1 &_header)
+{
+    if (_size < sizeof(swarm_shard_header_v1)) {
+        return false;
+    }
+    std::memcpy(&_header, _buf, sizeof(_header));
+    return _header.magic == kSwarmShardMagic &&
+           _header.version == kSwarmShardVersion &&
+           _header.count <= kSwarmShardMaxVehicles &&
+           swarm_shard_frame_size(_header.count) <= _size;
+}
+
+/// \brief Decode vehicle record _index of a shard frame.
+inline void decode_swarm_shard_vehicle(const void *_buf, size_t _index,
+                                       swarm_shard_vehicle_v1 &_vehicle)
+{
+    std::memcpy(&_vehicle,
+                static_cast<const uint8_t *>(_buf) +
+                    swarm_shard_frame_size(_index),
+                sizeof(_vehicle));
+}
+
+#endif  // SWARMSHARDFRAME_HH_
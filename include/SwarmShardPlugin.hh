@@ -0,0 +1,117 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWARMSHARDPLUGIN_HH_
+#define SWARMSHARDPLUGIN_HH_
+
+#include <memory>
+
+#include <gz/sim/System.hh>
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+/// \brief World system joining one shard of a swarm split across several
+/// Gazebo servers.
+///
+/// Each server simulates some of the vehicles, and every `<sync_period>`
+/// of simulation time the shards exchange the poses of their vehicles
+/// over local UDP (see SwarmShardFrame.hh). The vehicles of the other
+/// shards appear as ghosts: kinematic boxes named `ghost_<name>`, moved
+/// to the received pose at each sync, so they are seen by sensors and
+/// local vehicles collide with them without pushing them. A ghost is
+/// removed once its vehicle is not received for `<ghost_timeout>`.
+///
+/// The exchange is a barrier. After sending the state of a sync step a
+/// shard waits for the same step from every other shard, so no shard
+/// runs ahead of the others by more than one sync period. A shard that
+/// does not answer within `<sync_timeout>` is skipped until it is heard
+/// from again, so shards may be started in any order. All shards must
+/// use the same physics step size.
+///
+/// Vehicles are the top level models named `<vehicle_prefix>N`, and the
+/// instance number N identifies a vehicle across shards, as it does for
+/// the ArduPilotPlugin `<instance>auto</instance>` port.
+///
+/// ## System Parameters:
+///
+///   `<shard>` Index of this shard, from 0.
+///
+///   `<shards>` Number of shards.
+///
+///   `<bus_address>` Address of the shard bus.
+///   The default value is: `127.0.0.1`.
+///
+///   `<bus_port>` Shard N listens on bus_port + N.
+///   The default value is: `9700`.
+///
+///   `<sync_period>` Simulation time between exchanges (s).
+///   The default value is: `0.01`.
+///
+///   `<sync_timeout>` Wall time (s) to wait for a shard before skipping it.
+///   The default value is: `2`.
+///
+///   `<vehicle_prefix>` Name prefix of the vehicle models.
+///   The default value is: `iris_`.
+///
+///   `<ghost_size>` Size of the ghost box (m).
+///   The default value is: `0.6 0.6 0.25`.
+///
+///   `<ghost_timeout>` Simulation time (s) after which the ghost of a
+///   vehicle that is no longer received is removed.
+///   The default value is: `2`.
+///
+class SwarmShardPlugin :
+    public System,
+    public ISystemConfigure,
+    public ISystemPreUpdate,
+    public ISystemPostUpdate
+{
+  /// \brief Destructor
+  public: virtual ~SwarmShardPlugin();
+
+  /// \brief Constructor
+  public: SwarmShardPlugin();
+
+  // Documentation inherited
+  public: void Configure(const Entity &_entity,
+                         const std::shared_ptr<const sdf::Element> &_sdf,
+                         EntityComponentManager &_ecm,
+                         EventManager &_eventMgr) final;
+
+  // Documentation inherited
+  public: void PreUpdate(const gz::sim::UpdateInfo &_info,
+                         gz::sim::EntityComponentManager &_ecm) final;
+
+  // Documentation inherited
+  public: void PostUpdate(const gz::sim::UpdateInfo &_info,
+                          const gz::sim::EntityComponentManager &_ecm) final;
+
+  /// \internal
+  /// \brief Private implementation
+  private: class Impl;
+  private: std::unique_ptr<Impl> impl;
+};
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+#endif  // SWARMSHARDPLUGIN_HH_
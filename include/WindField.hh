@@ -0,0 +1,146 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDFIELD_HH_
+#define WINDFIELD_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/// \brief Wind field evaluated for a batch of points in one pass.
+///
+/// The wind at each point is the sum of:
+///
+///   - a mean wind with a power law shear profile,
+///     `U(z) = U_ref (z / z_ref)^shear_exponent` applied to the
+///     horizontal components,
+///   - a discrete `1 - cos` gust, optionally repeated, common to all
+///     points,
+///   - Dryden turbulence using the MIL-F-8785C low altitude intensities
+///     and length scales, realised as first-order filtered noise along
+///     the mean wind (u), across it (v) and vertically (w). The filter
+///     time constant is `L / V` with `V` the speed of the point relative
+///     to the mean wind, so each point carries its own turbulence state.
+///
+/// Points are stored as a structure of arrays so the per-point loop has
+/// no branches and may be vectorised by the compiler. Positions use the
+/// Gazebo world frame (ENU, z up) and velocities are in m/s.
+///
+/// The class has no dependency on Gazebo so it may be driven by
+/// recorded or synthetic trajectories.
+class WindField
+{
+public:
+    /// \brief Wind field parameters.
+    struct Params
+    {
+        /// \brief Mean wind velocity at the reference height (m/s).
+        double meanVelocity[3]{0.0, 0.0, 0.0};
+
+        /// \brief Reference height of the mean wind (m).
+        double referenceHeight{10.0};
+
+        /// \brief Power law shear exponent, 0 for a uniform wind.
+        double shearExponent{0.143};
+
+        /// \brief Height below which the shear profile is held (m).
+        double minHeight{0.1};
+
+        /// \brief Peak gust velocity (m/s).
+        double gustVelocity[3]{0.0, 0.0, 0.0};
+
+        /// \brief Time of the first gust (s).
+        double gustStart{0.0};
+
+        /// \brief Duration of a gust (s), 0 disables gusts.
+        double gustDuration{0.0};
+
+        /// \brief Interval between gust starts (s), 0 for a single gust.
+        double gustPeriod{0.0};
+
+        /// \brief Vertical turbulence intensity sigma_w (m/s),
+        /// 0 disables turbulence.
+        double turbulenceIntensity{0.0};
+
+        /// \brief Seed of the turbulence noise.
+        uint32_t seed{0};
+    };
+
+    /// \brief Points at which the wind is evaluated.
+    struct Batch
+    {
+        /// \brief Positions (m).
+        std::vector<double> x, y, z;
+
+        /// \brief Velocities of the points (m/s).
+        std::vector<double> vx, vy, vz;
+
+        /// \brief Wind velocity at the points (m/s), set by Update.
+        std::vector<double> wx, wy, wz;
+    };
+
+    /// \brief Constructor.
+    explicit WindField(const Params &_params);
+
+    /// \brief Resize the batch, keeping the state of retained points.
+    /// \param[in] _from For each new point the index of the point it
+    /// continues, or -1 for a new point with no turbulence state.
+    void Remap(const std::vector<int> &_from);
+
+    /// \brief Number of points.
+    size_t Size() const;
+
+    /// \brief Points, positions and velocities are set by the caller.
+    Batch &Points();
+
+    /// \brief Evaluate the wind at all points.
+    /// \param[in] _time Simulation time (s).
+    /// \param[in] _dt Time since the previous update (s).
+    void Update(double _time, double _dt);
+
+    /// \brief Mean wind and gust at the reference height, excluding
+    /// turbulence.
+    /// \param[in] _time Simulation time (s).
+    /// \param[out] _wind Wind velocity (m/s).
+    void ReferenceWind(double _time, double _wind[3]) const;
+
+private:
+    /// \brief Gust factor in [0, 1] at a time.
+    double GustFactor(double _time) const;
+
+    /// \brief Wind field parameters.
+    Params params;
+
+    /// \brief Points and results.
+    Batch batch;
+
+    /// \brief Turbulence state along, across and normal to the wind.
+    std::vector<double> tu, tv, tw;
+
+    /// \brief Unit noise samples for the current update.
+    std::vector<double> nu, nv, nw;
+
+    /// \brief Turbulence noise source.
+    std::mt19937 rng;
+
+    /// \brief Unit normal distribution.
+    std::normal_distribution<double> normal{0.0, 1.0};
+};
+
+#endif  // WINDFIELD_HH_
@@ -0,0 +1,48 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDFIELDCOMPONENTS_HH_
+#define WINDFIELDCOMPONENTS_HH_
+
+#include <gz/math/Vector3.hh>
+#include <gz/sim/components/Component.hh>
+#include <gz/sim/components/Factory.hh>
+#include <gz/sim/config.hh>
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace components {
+
+/// \brief Wind velocity in the world frame (m/s) from the WindFieldPlugin.
+///
+/// Systems that need the local wind create this component on an entity
+/// with a pose (a link or a sensor) and the WindFieldPlugin updates it
+/// every step. The plugin sets the component on the world entity to the
+/// wind at the reference height, so its presence there indicates that a
+/// wind field is running.
+using WindFieldVelocity =
+    Component<math::Vector3d, class WindFieldVelocityTag>;
+GZ_SIM_REGISTER_COMPONENT("ardupilot_gazebo.components.WindFieldVelocity",
+    WindFieldVelocity)
+
+}  // namespace components
+}
+}  // namespace sim
+}  // namespace gz
+
+#endif  // WINDFIELDCOMPONENTS_HH_
@@ -0,0 +1,96 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDFIELDPLUGIN_HH_
+#define WINDFIELDPLUGIN_HH_
+
+#include <memory>
+
+#include <gz/sim/System.hh>
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+/// \brief World system evaluating a shared wind field for all vehicles.
+///
+/// The wind is evaluated in one batch per step at every entity with a
+/// `WindFieldVelocity` component (see WindFieldComponents.hh). The
+/// ArduPilotPlugin creates it on its anemometer and the ParachutePlugin
+/// on its parent link in drag mode, so they read the local wind from the
+/// component instead of the global wind.
+///
+/// ## System Parameters:
+///
+///   `<mean_velocity>` Mean wind velocity (m/s) in the world frame at the
+///   reference height.
+///   The default value is: `0 0 0`.
+///
+///   `<reference_height>` Height of the mean wind (m).
+///   The default value is: `10`.
+///
+///   `<shear_exponent>` Power law shear exponent for the horizontal mean
+///   wind, 0 for a uniform wind.
+///   The default value is: `0.143`.
+///
+///   `<gust>` A `1 - cos` gust common to all entities, with elements
+///   `<velocity>` peak velocity (m/s), `<start>` time of the first gust
+///   (s), `<duration>` (s) and `<period>` between gust starts (s), 0 for
+///   a single gust.
+///
+///   `<turbulence>` Dryden turbulence, with elements `<intensity>` the
+///   vertical intensity sigma_w (m/s), 0 to disable, and `<seed>` the
+///   noise seed.
+///
+///   `<update_global_wind>` Also set the world wind velocity to the wind
+///   at the reference height, for systems using the global wind.
+///   The default value is: `false`.
+///
+class WindFieldPlugin :
+    public System,
+    public ISystemConfigure,
+    public ISystemPreUpdate
+{
+  /// \brief Destructor
+  public: virtual ~WindFieldPlugin();
+
+  /// \brief Constructor
+  public: WindFieldPlugin();
+
+  // Documentation inherited
+  public: void Configure(const Entity &_entity,
+                         const std::shared_ptr<const sdf::Element> &_sdf,
+                         EntityComponentManager &_ecm,
+                         EventManager &) final;
+
+  // Documentation inherited
+  public: void PreUpdate(const gz::sim::UpdateInfo &_info,
+                         gz::sim::EntityComponentManager &_ecm) final;
+
+  /// \internal
+  /// \brief Private implementation
+  private: class Impl;
+  private: std::unique_ptr<Impl> impl;
+};
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+#endif  // WINDFIELDPLUGIN_HH_
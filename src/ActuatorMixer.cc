@@ -0,0 +1,112 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ActuatorMixer.hh"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+/// \brief Dot product of two arrays of _n doubles, _n a multiple of 4.
+double dot(const double *_a, const double *_b, size_t _n)
+{
+#if defined(__AVX__)
+    __m256d sum = _mm256_setzero_pd();
+    for (size_t i = 0; i < _n; i += 4) {
+        sum = _mm256_add_pd(sum,
+            _mm256_mul_pd(_mm256_loadu_pd(_a + i), _mm256_loadu_pd(_b + i)));
+    }
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum),
+                                    _mm256_extractf128_pd(sum, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+#elif defined(__SSE2__)
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    for (size_t i = 0; i < _n; i += 4) {
+        sum0 = _mm_add_pd(sum0,
+            _mm_mul_pd(_mm_loadu_pd(_a + i), _mm_loadu_pd(_b + i)));
+        sum1 = _mm_add_pd(sum1,
+            _mm_mul_pd(_mm_loadu_pd(_a + i + 2), _mm_loadu_pd(_b + i + 2)));
+    }
+    const __m128d sum = _mm_add_pd(sum0, sum1);
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+#elif defined(__aarch64__)
+    float64x2_t sum0 = vdupq_n_f64(0.0);
+    float64x2_t sum1 = vdupq_n_f64(0.0);
+    for (size_t i = 0; i < _n; i += 4) {
+        sum0 = vfmaq_f64(sum0, vld1q_f64(_a + i), vld1q_f64(_b + i));
+        sum1 = vfmaq_f64(sum1, vld1q_f64(_a + i + 2), vld1q_f64(_b + i + 2));
+    }
+    return vaddvq_f64(vaddq_f64(sum0, sum1));
+#else
+    double sum[4] = {0.0, 0.0, 0.0, 0.0};
+    for (size_t i = 0; i < _n; i += 4) {
+        sum[0] += _a[i] * _b[i];
+        sum[1] += _a[i + 1] * _b[i + 1];
+        sum[2] += _a[i + 2] * _b[i + 2];
+        sum[3] += _a[i + 3] * _b[i + 3];
+    }
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+#endif
+}
+}  // namespace
+
+void ActuatorMixer::SetMatrix(size_t _rows, size_t _cols,
+                              const std::vector<double> &_matrix)
+{
+    rows = _rows;
+    cols = _cols;
+    stride = (_cols + 3) & ~static_cast<size_t>(3);
+    matrix.assign(rows * stride, 0.0);
+    input.assign(stride, 0.0);
+    for (size_t r = 0; r < rows; ++r) {
+        std::copy(_matrix.begin() + r * cols,
+                  _matrix.begin() + (r + 1) * cols,
+                  matrix.begin() + r * stride);
+    }
+}
+
+size_t ActuatorMixer::Rows() const
+{
+    return rows;
+}
+
+size_t ActuatorMixer::Cols() const
+{
+    return cols;
+}
+
+bool ActuatorMixer::Empty() const
+{
+    return rows == 0 || cols == 0;
+}
+
+void ActuatorMixer::Mix(const double *_in, double *_out)
+{
+    std::copy(_in, _in + cols, input.begin());
+    for (size_t r = 0; r < rows; ++r) {
+        _out[r] = dot(matrix.data() + r * stride, input.data(), stride);
+    }
+}
@@ -0,0 +1,93 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AdaptiveBitrate.hh"
+
+#include <algorithm>
+#include <cmath>
+
+AdaptiveBitrateController::AdaptiveBitrateController(const Params &_params)
+    : params(_params),
+      bitrate(_params.startKbps),
+      keyInterval(_params.maxKeyInterval)
+{
+    params.minKbps = std::max<uint32_t>(1, params.minKbps);
+    params.maxKbps = std::max(params.minKbps, params.maxKbps);
+    bitrate = std::min<double>(std::max<double>(bitrate, params.minKbps),
+                               params.maxKbps);
+}
+
+bool AdaptiveBitrateController::Update(double _time, double _fractionLost,
+                                       double _rttMs)
+{
+    const uint32_t prevKbps = BitrateKbps();
+    const uint32_t prevKeyInterval = keyInterval;
+
+    // elapsed time since the previous report, bounded so a long gap in
+    // feedback does not produce a large step
+    double dt = lastTime < 0.0 ? 1.0 : _time - lastTime;
+    dt = std::min(std::max(dt, 0.0), 2.0);
+    lastTime = _time;
+
+    // track the base round trip time to estimate queuing delay
+    bool delayCongested = false;
+    if (_rttMs >= 0.0)
+    {
+        minRttMs = minRttMs < 0.0 ? _rttMs : std::min(minRttMs, _rttMs);
+        delayCongested = _rttMs - minRttMs > params.delayThresholdMs;
+    }
+
+    const double loss = std::min(std::max(_fractionLost, 0.0), 1.0);
+    if (loss > params.lossHigh)
+    {
+        bitrate *= 1.0 - 0.5 * loss;
+        keyInterval = params.minKeyInterval;
+        keyframeRequested = true;
+    }
+    else if (delayCongested)
+    {
+        bitrate *= params.delayBackoff;
+    }
+    else if (loss < params.lossLow)
+    {
+        bitrate *= std::pow(1.0 + params.increaseRate, dt);
+        keyInterval = params.maxKeyInterval;
+    }
+    // between lossLow and lossHigh hold the current rate
+
+    bitrate = std::min<double>(std::max<double>(bitrate, params.minKbps),
+                               params.maxKbps);
+
+    return BitrateKbps() != prevKbps || keyInterval != prevKeyInterval;
+}
+
+uint32_t AdaptiveBitrateController::BitrateKbps() const
+{
+    return static_cast<uint32_t>(std::lround(bitrate));
+}
+
+uint32_t AdaptiveBitrateController::KeyframeInterval() const
+{
+    return keyInterval;
+}
+
+bool AdaptiveBitrateController::TakeKeyframeRequest()
+{
+    const bool requested = keyframeRequested;
+    keyframeRequested = false;
+    return requested;
+}
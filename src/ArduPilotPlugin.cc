@@ -19,48 +19,73 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include <gz/msgs/boolean.pb.h>
 #include <gz/msgs/imu.pb.h>
 #include <gz/msgs/laserscan.pb.h>
+#include <gz/msgs/physics.pb.h>
+#include <gz/msgs/stringmsg.pb.h>
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include <gz/common/SignalHandler.hh>
 #include <gz/msgs/Utility.hh>
+#include <gz/sim/components/ChildLinkName.hh>
 #include <gz/sim/components/CustomSensor.hh>
 #include <gz/sim/components/Imu.hh>
 #include <gz/sim/components/Joint.hh>
+#include <gz/sim/components/JointAxis.hh>
 #include <gz/sim/components/JointForceCmd.hh>
 #include <gz/sim/components/JointPosition.hh>
+#include <gz/sim/components/JointPositionReset.hh>
 #include <gz/sim/components/JointVelocity.hh>
 #include <gz/sim/components/JointVelocityCmd.hh>
+#include <gz/sim/components/JointVelocityReset.hh>
 #include <gz/sim/components/LinearVelocity.hh>
 #include <gz/sim/components/Link.hh>
 #include <gz/sim/components/Name.hh>
+#include <gz/sim/components/ParentEntity.hh>
+#include <gz/sim/components/ParentLinkName.hh>
+#include <gz/sim/components/Physics.hh>
 #include <gz/sim/components/Pose.hh>
 #include <gz/sim/components/Sensor.hh>
 #include <gz/sim/components/World.hh>
+#include <gz/sim/Link.hh>
 #include <gz/sim/Model.hh>
 #include <gz/sim/World.hh>
 #include <gz/sim/Util.hh>
-#include <gz/math/Filter.hh>
 #include <gz/math/Helpers.hh>
 #include <gz/math/Pose3.hh>
 #include <gz/math/PID.hh>
+#include <gz/math/Rand.hh>
+#include <gz/math/Vector2.hh>
 #include <gz/math/Vector3.hh>
 #include <gz/plugin/Register.hh>
 #include <gz/transport/Node.hh>
 
 #include <sdf/sdf.hh>
 
+#include "ActuatorMixer.hh"
+#include "ArduPilotStateFrame.hh"
+#include "ConnectionHealthMonitor.hh"
+#include "JointStateFilterBank.hh"
+#include "RealTimeFactorMatcher.hh"
+#include "RangefinderComponents.hh"
 #include "SocketUDP.hh"
 #include "Util.hh"
+#include "WindFieldComponents.hh"
 
 #define DEBUG_JSON_IO 0
 
@@ -68,6 +93,46 @@
 // can be defined in the <plugin>.
 #define MAX_MOTORS 255
 
+namespace
+{
+/// \brief The vehicle matching the real time factor of each world, by
+/// world name. The real time factor is world-wide, so only one vehicle
+/// may drive it.
+std::mutex rtfOwnersMutex;
+std::map<std::string, std::pair<gz::sim::Entity, std::string>> rtfOwners;
+
+/// \brief Make a vehicle the one matching the real time factor of a
+/// world, unless another vehicle already is.
+/// \param[in] _world World name.
+/// \param[in] _model Model entity of the vehicle.
+/// \param[in,out] _name Name of the vehicle, set to the name of the
+/// current owner if there is one.
+/// \return True if the vehicle now owns the real time factor.
+bool ClaimRealTimeFactor(const std::string &_world, gz::sim::Entity _model,
+    std::string &_name)
+{
+  std::lock_guard<std::mutex> lock(rtfOwnersMutex);
+  auto result = rtfOwners.emplace(_world, std::make_pair(_model, _name));
+  if (!result.second && result.first->second.first != _model)
+  {
+    _name = result.first->second.second;
+    return false;
+  }
+  return true;
+}
+
+/// \brief Release a world real time factor owned by a vehicle.
+void ReleaseRealTimeFactor(const std::string &_world, gz::sim::Entity _model)
+{
+  std::lock_guard<std::mutex> lock(rtfOwnersMutex);
+  auto it = rtfOwners.find(_world);
+  if (it != rtfOwners.end() && it->second.first == _model)
+  {
+    rtfOwners.erase(it);
+  }
+}
+}  // namespace
+
 // Register plugin
 GZ_ADD_PLUGIN(gz::sim::systems::ArduPilotPlugin,
               gz::sim::System,
@@ -85,7 +150,6 @@ class Control
   /// \brief Constructor
   public: Control()
   {
-    // most of these coefficients are not used yet.
     this->rotorVelocitySlowdownSim = this->kDefaultRotorVelocitySlowdownSim;
     this->frequencyCutoff = this->kDefaultFrequencyCutoff;
     this->samplingRate = this->kDefaultSamplingRate;
@@ -98,6 +162,10 @@ class Control
   /// \brief The PWM channel used to command this control
   public: int channel = 0;
 
+  /// \brief Set true if the command is an output of the <mixer>, in
+  /// which case channel is not used.
+  public: bool mixed = false;
+
   /// \brief Next command to be applied to the joint
   public: double cmd = 0;
 
@@ -114,8 +182,78 @@ class Control
   public: std::string type;
 
   /// \brief Use force controller
+  ///
+  /// A POSITION control without force is kinematic: the joint position
+  /// is reset each step towards the command, limited by maxRate and
+  /// maxAccel.
   public: bool useForce = true;
 
+  /// \brief Rate limit for kinematic position control (rad/s or m/s).
+  ///
+  /// Zero or negative for no limit.
+  public: double maxRate = 0.0;
+
+  /// \brief Acceleration limit for kinematic position control.
+  ///
+  /// Zero or negative for no limit.
+  public: double maxAccel = 0.0;
+
+  /// \brief Lower joint limit, used to clamp kinematic position commands.
+  public: double lowerLimit = -std::numeric_limits<double>::infinity();
+
+  /// \brief Upper joint limit, used to clamp kinematic position commands.
+  public: double upperLimit = std::numeric_limits<double>::infinity();
+
+  /// \brief Kinematic joint position.
+  public: double kinematicPos = 0.0;
+
+  /// \brief Kinematic joint velocity.
+  public: double kinematicVel = 0.0;
+
+  /// \brief True once the kinematic state is set from the joint.
+  public: bool kinematicInit = false;
+
+  /// \brief The joint controller for VELOCITY and POSITION controls.
+  ///
+  /// Valid controllers are:
+  ///   pid          force from the PID on the joint error (default)
+  ///   motor_model  first-order response with time constant timeConstant,
+  ///                applied through the joint velocity command
+  ///   rotor        first-order rotor speed with thrust and torque applied
+  ///                to the body link, the joint is spun kinematically
+  public: std::string controller = "pid";
+
+  /// \brief Rotor thrust coefficient, thrust = k * w^2 (N s^2/rad^2).
+  public: double rotorThrustCoefficient = 0.0;
+
+  /// \brief Rotor drag torque coefficient, torque = k * w^2 (N m s^2/rad^2).
+  public: double rotorTorqueCoefficient = 0.0;
+
+  /// \brief Visual spin of the rotor joint is the rotor speed divided by
+  /// this, zero to hold the joint.
+  public: double rotorVisualSlowdown = 10.0;
+
+  /// \brief Link the rotor wrench is applied to.
+  public: gz::sim::Entity rotorBodyLink{gz::sim::kNullEntity};
+
+  /// \brief Link spun by the rotor joint.
+  public: gz::sim::Entity rotorLink{gz::sim::kNullEntity};
+
+  /// \brief Rotor axis in the rotor link frame.
+  public: gz::math::Vector3d rotorAxis{0, 0, 1};
+
+  /// \brief Modelled rotor speed (rad/s).
+  public: double rotorVel = 0.0;
+
+  /// \brief Visual rotor angle (rad).
+  public: double rotorAngle = 0.0;
+
+  /// \brief Time constant of the first-order motor model (s).
+  public: double timeConstant = 0.05;
+
+  /// \brief Joint velocity of the motor model when not measured.
+  public: double modelVel = 0.0;
+
   /// \brief The name of the joint being controlled
   public: std::string jointName;
 
@@ -141,14 +279,119 @@ class Control
   /// The upper limit of PWM input should match SERVOX_MAX for this channel.
   public: double servo_max = 2000.0;
 
+  /// \brief Deadband at the low end of the normalised input in [0, 1).
+  public: double curveDeadband = 0.0;
+
+  /// \brief Exponent applied to the normalised input, 1 is linear.
+  public: double curveExponent = 1.0;
+
+  /// \brief Piecewise linear curve of (input, output) points on the
+  /// normalised input, sorted by input. Replaces the exponent if set.
+  public: std::vector<std::pair<double, double>> curveTable;
+
+  /// \brief Command for each PWM value between servo_min and servo_max.
+  public: std::vector<double> cmdTable;
+
+  /// \brief PWM value of the first entry in cmdTable.
+  public: int cmdTableOffset = 0;
+
+  /// \brief Compile the PWM to command mapping into cmdTable.
+  ///
+  /// The PWM is normalised to [0, 1] over [servo_min, servo_max], shaped
+  /// by the deadband and then the table or exponent, and finally mapped
+  /// to multiplier * (value + offset). A channel with servo_min above
+  /// servo_max is reversed.
+  public: void BuildCommandTable()
+  {
+    const int pwmMin = static_cast<int>(std::lround(
+        std::min(this->servo_min, this->servo_max)));
+    const int pwmMax = static_cast<int>(std::lround(
+        std::max(this->servo_min, this->servo_max)));
+    const double range = this->servo_max - this->servo_min;
+
+    this->cmdTableOffset = pwmMin;
+    this->cmdTable.resize(pwmMax - pwmMin + 1);
+    for (size_t k = 0; k < this->cmdTable.size(); ++k)
+    {
+      double raw = range != 0.0 ?
+          (pwmMin + static_cast<int>(k) - this->servo_min) / range : 0.0;
+      raw = gz::math::clamp(raw, 0.0, 1.0);
+
+      if (raw <= this->curveDeadband)
+      {
+        raw = 0.0;
+      }
+      else
+      {
+        raw = (raw - this->curveDeadband) / (1.0 - this->curveDeadband);
+      }
+
+      if (!this->curveTable.empty())
+      {
+        raw = this->Interpolate(raw);
+      }
+      else if (this->curveExponent != 1.0)
+      {
+        raw = std::pow(raw, this->curveExponent);
+      }
+
+      this->cmdTable[k] = this->multiplier * (raw + this->offset);
+    }
+  }
+
+  /// \brief Command for a PWM value, clamped to the servo range.
+  public: double Command(uint16_t _pwm) const
+  {
+    const int last = static_cast<int>(this->cmdTable.size()) - 1;
+    const int k = std::min(std::max(
+        static_cast<int>(_pwm) - this->cmdTableOffset, 0), last);
+    return this->cmdTable[k];
+  }
+
+  /// \brief Linear interpolation in curveTable, constant beyond the ends.
+  private: double Interpolate(double _x) const
+  {
+    if (_x <= this->curveTable.front().first)
+    {
+      return this->curveTable.front().second;
+    }
+    for (size_t j = 1; j < this->curveTable.size(); ++j)
+    {
+      const auto &p0 = this->curveTable[j - 1];
+      const auto &p1 = this->curveTable[j];
+      if (_x <= p1.first)
+      {
+        const double dx = p1.first - p0.first;
+        const double t = dx > 0.0 ? (_x - p0.first) / dx : 1.0;
+        return p0.second + t * (p1.second - p0.second);
+      }
+    }
+    return this->curveTable.back().second;
+  }
+
   /// \brief Publisher for sending commands
   public: gz::transport::Node::Publisher pub;
 
-  /// \brief unused coefficients
+  /// \brief Joint velocity slowdown of VELOCITY controls.
   public: double rotorVelocitySlowdownSim;
+
+  /// \brief Joint state feedback filter, see JointStateFilterBank.
+  public: JointStateFilterBank::Type filterType =
+      JointStateFilterBank::Type::NONE;
+
+  /// \brief Filter cutoff, or the notch frequency (Hz).
   public: double frequencyCutoff;
+
+  /// \brief Filter sample rate (Hz), zero for the physics rate.
   public: double samplingRate;
-  public: gz::math::OnePole<double> filter;
+
+  /// \brief Quality factor of the biquad and notch filters.
+  public: double filterQ = 0.7071;
+
+  /// \brief Number of blades, if positive the notch follows the blade
+  /// pass frequency of the velocity target, with frequencyCutoff as its
+  /// lower bound.
+  public: int notchBlades = 0;
 
   public: static double kDefaultRotorVelocitySlowdownSim;
   public: static double kDefaultFrequencyCutoff;
@@ -157,7 +400,7 @@ class Control
 
 double Control::kDefaultRotorVelocitySlowdownSim = 10.0;
 double Control::kDefaultFrequencyCutoff = 5.0;
-double Control::kDefaultSamplingRate = 0.2;
+double Control::kDefaultSamplingRate = 0.0;
 
 /////////////////////////////////////////////////
 // Wrapper class to store callback functions
@@ -211,6 +454,30 @@ class gz::sim::systems::ArduPilotPluginPrivate
   /// \brief Array of controllers
   public: std::vector<Control> controls;
 
+  /// \brief Mixing matrix from normalised channels to mixed controls.
+  public: ActuatorMixer mixer;
+
+  /// \brief PWM channel of each mixer input.
+  public: std::vector<int> mixerChannels;
+
+  /// \brief PWM range of each mixer input, normalised to [-1, 1].
+  public: std::vector<double> mixerServoMin;
+  public: std::vector<double> mixerServoMax;
+
+  /// \brief Control index of each mixer output.
+  public: std::vector<size_t> mixerControls;
+
+  /// \brief Mixer inputs and outputs of the current frame.
+  public: std::vector<double> mixerIn;
+  public: std::vector<double> mixerOut;
+
+  /// \brief Joint state filter of each control.
+  public: JointStateFilterBank filterBank;
+
+  /// \brief Raw and filtered joint state of each control.
+  public: std::vector<double> filterIn;
+  public: std::vector<double> filterOut;
+
   /// \brief keep track of controller update sim-time.
   public: std::chrono::steady_clock::duration lastControllerUpdateTime{0};
 
@@ -221,7 +488,7 @@ class gz::sim::systems::ArduPilotPluginPrivate
   public: std::mutex mutex;
 
   /// \brief Socket manager
-  public: SocketUDP sock = SocketUDP(true, true);
+  public: SocketUDP sock{true, true};
 
   /// \brief The address for the flight dynamics model (i.e. this plugin)
   public: std::string fdm_address{"127.0.0.1"};
@@ -232,6 +499,12 @@ class gz::sim::systems::ArduPilotPluginPrivate
   /// \brief The port for the flight dynamics model
   public: uint16_t fdm_port_in{9002};
 
+  /// \brief Vehicle instance, offsetting fdm_port_in
+  public: uint32_t instance{0};
+
+  /// \brief Port spacing of vehicle instances
+  public: uint32_t instancePortStride{10};
+
   /// \brief The port for the SITL flight controller - auto detected
   public: uint16_t fcu_port_out;
 
@@ -241,9 +514,20 @@ class gz::sim::systems::ArduPilotPluginPrivate
   /// \brief Set true to enforce lock-step simulation
   public: bool isLockStep{false};
 
-  /// \brief Set true if have 32 servo channels
+  /// \brief Set true if have 32 servo channels.
+  ///
+  /// A hint only, the format is detected from each servo packet.
   public: bool have32Channels{false};
 
+  /// \brief Number of PWM channels in the last servo packet.
+  public: uint16_t servoChannels{0};
+
+  /// \brief Set true once a mismatch with have32Channels is reported.
+  public: bool servoHintWarned{false};
+
+  /// \brief Receive buffer for servo packets of any supported format.
+  public: alignas(8) uint8_t servoBuffer[kServoBufferSize];
+
   /// \brief Have we initialized subscription to the IMU data yet?
   public: bool imuInitialized{false};
 
@@ -276,6 +560,155 @@ class gz::sim::systems::ArduPilotPluginPrivate
   /// \brief A copy of the most recently received range data
   public: std::vector<double> ranges;
 
+  /// \brief A range sensor cast by the RangefinderPlugin.
+  public: struct RaycastRange
+  {
+    /// \brief Index into ranges.
+    size_t index;
+
+    /// \brief Entity with the RaycastRangefinder component.
+    gz::sim::Entity entity;
+
+    /// \brief Maximum range (m).
+    double maxRange;
+  };
+
+  /// \brief Range sensors cast by the RangefinderPlugin.
+  public: std::vector<RaycastRange> raycastRanges;
+
+  /// \brief Create an entity for the RangefinderPlugin to cast a ray
+  /// along the x axis of the pose relative to the link.
+  public: gz::sim::Entity CreateRaycastRangefinder(
+      gz::sim::EntityComponentManager &_ecm,
+      gz::sim::Entity _link,
+      const std::string &_name,
+      const gz::math::Pose3d &_pose,
+      double _minRange,
+      double _maxRange)
+  {
+    gz::sim::components::RaycastRangefinderData data;
+    data.minRange = _minRange;
+    data.maxRange = _maxRange;
+
+    gz::sim::Entity entity = _ecm.CreateEntity();
+    _ecm.CreateComponent(entity, gz::sim::components::Name(_name));
+    _ecm.CreateComponent(entity, gz::sim::components::ParentEntity(_link));
+    _ecm.CreateComponent(entity, gz::sim::components::Pose(_pose));
+    _ecm.CreateComponent(entity,
+        gz::sim::components::RaycastRangefinder(data));
+    return entity;
+  }
+
+  /// \brief Synthetic optical flow sensor.
+  ///
+  /// Flow is derived from the body velocity and angular rate and the
+  /// ground distance, as seen by a downward facing sensor aligned with
+  /// the body axes.
+  public: struct OpticalFlow
+  {
+    /// \brief Set true if the sensor is configured.
+    bool enabled{false};
+
+    /// \brief Update period (s), zero for every state.
+    double period{0.0};
+
+    /// \brief Simulation time of the last update (s).
+    double lastUpdateTime{-1.0};
+
+    /// \brief Standard deviation of the flow rate noise (rad/s).
+    double noiseStdDev{0.0};
+
+    /// \brief Minimum and maximum ground distance (m).
+    double minRange{0.05};
+    double maxRange{40.0};
+
+    /// \brief Ground distance ray, null to assume flat ground at z = 0.
+    gz::sim::Entity entity{gz::sim::kNullEntity};
+
+    /// \brief Latest sample.
+    fdm_state_flow_v1 sample{};
+  };
+
+  /// \brief Synthetic optical flow sensor.
+  public: OpticalFlow opticalFlow;
+
+  /// \brief Update the optical flow sample if it is due.
+  /// \param[in] _simTime Simulation time (s).
+  /// \param[in] _ecm The entity component manager.
+  /// \param[in] _wldAToBdyA Vehicle pose, NED to FRD.
+  /// \param[in] _velWldA Vehicle velocity, NED.
+  /// \param[in] _gyro Body angular velocity, FRD.
+  public: void UpdateOpticalFlow(
+      double _simTime,
+      const gz::sim::EntityComponentManager &_ecm,
+      const gz::math::Pose3d &_wldAToBdyA,
+      const gz::math::Vector3d &_velWldA,
+      const gz::math::Vector3d &_gyro)
+  {
+    OpticalFlow &flow = this->opticalFlow;
+    if (flow.lastUpdateTime >= 0.0 &&
+        _simTime - flow.lastUpdateTime < flow.period)
+    {
+      return;
+    }
+    flow.lastUpdateTime = _simTime;
+
+    // ground distance along the body z axis, from the ray if there is
+    // one, otherwise above flat ground
+    double distance = std::numeric_limits<double>::infinity();
+    if (flow.entity != gz::sim::kNullEntity)
+    {
+      const auto *comp =
+          _ecm.Component<gz::sim::components::RaycastRangefinder>(
+              flow.entity);
+      if (comp != nullptr)
+      {
+        distance = comp->Data().range;
+      }
+    }
+    else
+    {
+      const double cosTilt =
+          _wldAToBdyA.Rot().RotateVector(gz::math::Vector3d::UnitZ).Z();
+      const double height = -_wldAToBdyA.Pos().Z();
+      if (cosTilt > 0.0 && height > 0.0)
+      {
+        distance = height / cosTilt;
+      }
+    }
+
+    const gz::math::Vector3d velBdyA =
+        _wldAToBdyA.Rot().RotateVectorReverse(_velWldA);
+
+    fdm_state_flow_v1 &sample = flow.sample;
+    sample.body_rate[0] = _gyro.X();
+    sample.body_rate[1] = _gyro.Y();
+    if (distance >= flow.minRange && distance <= flow.maxRange)
+    {
+      // a sensor measures the flow of the ground image, which includes
+      // the rotation of the body, with the sign convention of the
+      // ArduPilot SITL flow sensor
+      sample.flow_rate[0] = -velBdyA.Y() / distance + _gyro.X();
+      sample.flow_rate[1] = velBdyA.X() / distance + _gyro.Y();
+      if (flow.noiseStdDev > 0.0)
+      {
+        sample.flow_rate[0] +=
+            gz::math::Rand::DblNormal(0.0, flow.noiseStdDev);
+        sample.flow_rate[1] +=
+            gz::math::Rand::DblNormal(0.0, flow.noiseStdDev);
+      }
+      sample.distance = distance;
+      sample.quality = 255;
+    }
+    else
+    {
+      sample.flow_rate[0] = 0.0;
+      sample.flow_rate[1] = 0.0;
+      sample.distance = std::isinf(distance) ? 2.0 * flow.maxRange : distance;
+      sample.quality = 0;
+    }
+  }
+
   /// \brief Callbacks for each range sensor
   public: std::vector<RangeOnMessageWrapperPtr> rangeCbs;
 
@@ -337,22 +770,99 @@ class gz::sim::systems::ArduPilotPluginPrivate
   ///
   /// Set to false when Gazebo starts to prevent blocking, true when
   /// the ArduPilot controller is detected and online, and false if the
-  /// connection to the ArduPilot controller times out.
+  /// health monitor reports the connection lost.
   public: bool arduPilotOnline{false};
 
-  /// \brief Number of consecutive missed ArduPilot controller messages
-  public: int connectionTimeoutCount{0};
+  /// \brief Set once Configure() completes. A plugin that failed to
+  /// configure, e.g. on a port in use, stays idle.
+  public: bool validConfig{false};
 
   /// \brief Max number of consecutive missed ArduPilot controller
-  ///        messages before timeout
+  ///        messages before timeout, sets the default lost timeout
   public: int connectionTimeoutMaxCount;
 
+  /// \brief Publisher of connection health changes.
+  public: gz::transport::Node::Publisher healthPub;
+
+  /// \brief Connection health monitor, runs on its own thread.
+  public: std::unique_ptr<ConnectionHealthMonitor> health;
+
+  /// \brief Optional matching of the world real time factor to the
+  /// controller speed.
+  public: std::unique_ptr<RealTimeFactorMatcher> rtfMatcher;
+
+  /// \brief World physics step size, sent with each real time factor.
+  public: double physicsStepSize{0.001};
+
+  /// \brief Wall time of the last real time factor update.
+  public: std::chrono::steady_clock::time_point rtfUpdateTime;
+
+  /// \brief Set the world real time factor through the physics service.
+  public: void SetRealTimeFactor(double _factor)
+  {
+    gz::msgs::Physics msg;
+    msg.set_max_step_size(this->physicsStepSize);
+    msg.set_real_time_factor(_factor);
+
+    std::function<void(const gz::msgs::Boolean &, const bool)> cb =
+        [this, _factor](const gz::msgs::Boolean &_rep, const bool _result)
+    {
+      if (!_result || !_rep.data())
+      {
+        gzwarn << "[" << this->modelName << "] "
+               << "failed to set the real time factor to " << _factor
+               << ", is the UserCommands system loaded?\n";
+      }
+    };
+    this->node.Request(
+        "/world/" + this->worldName + "/set_physics", msg, cb);
+  }
+
+  /// \brief Current connection health.
+  public: ConnectionHealthMonitor::State HealthState() const
+  {
+    return this->health ? this->health->CurrentState() :
+        ConnectionHealthMonitor::State::CONNECTING;
+  }
+
+  /// \brief Called on the monitor thread when the health changes.
+  public: void OnHealthChange(ConnectionHealthMonitor::State _from,
+                              ConnectionHealthMonitor::State _to)
+  {
+    using State = ConnectionHealthMonitor::State;
+    const char *name = ConnectionHealthMonitor::StateName(_to);
+    if (_to == State::DEGRADED || _to == State::LOST)
+    {
+      gzwarn << "[" << this->modelName << "] ArduPilot connection "
+             << name << ", observed frame rate "
+             << this->health->ObservedRate() << " Hz\n";
+    }
+    else
+    {
+      gzmsg << "[" << this->modelName << "] ArduPilot connection "
+            << ConnectionHealthMonitor::StateName(_from) << " -> "
+            << name << "\n";
+    }
+
+    gz::msgs::StringMsg msg;
+    msg.set_data(name);
+    this->healthPub.Publish(msg);
+  }
+
   /// \brief Transform from model orientation to x-forward and z-up
   public: gz::math::Pose3d modelXYZToAirplaneXForwardZDown;
 
   /// \brief Transform from world frame to NED frame
   public: gz::math::Pose3d gazeboXYZToNED;
 
+  /// \brief Transform from the Aircraft world frame to the Gazebo world
+  /// frame, precomputed from gazeboXYZToNED.
+  public: gz::math::Pose3d wldAToWldG;
+
+  /// \brief Transform from the Gazebo body frame to the Aircraft body
+  /// frame, precomputed from modelXYZToAirplaneXForwardZDown.
+  public: gz::math::Pose3d bdyGToBdyA;
+
   /// \brief Last received frame rate from the ArduPilot controller
   public: uint16_t fcu_frame_rate;
 
@@ -362,6 +872,36 @@ class gz::sim::systems::ArduPilotPluginPrivate
   /// \brief Last sent JSON string, so we can resend if needed.
   public: std::string json_str;
 
+  /// \brief State format: json, binary or auto.
+  ///
+  /// In auto mode the binary state is sent when the last servo packet
+  /// was an extended packet advertising SERVO_EXT_FLAG_BINARY_STATE.
+  public: std::string stateFormat{"json"};
+
+  /// \brief Set true if the controller accepts the binary state.
+  public: bool peerBinaryState{false};
+
+  /// \brief Set true if the last state was created in binary.
+  public: bool stateIsBinary{false};
+
+  /// \brief Last binary state, so we can resend if needed.
+  public: fdm_state_binary_frame stateBinary{};
+
+  /// \brief Wall time the last state was sent.
+  public: std::chrono::steady_clock::time_point stateSendTime;
+
+  /// \brief Sum of the state to servo packet latency (ms).
+  public: double linkLatencySumMs{0.0};
+
+  /// \brief Largest state to servo packet latency (ms).
+  public: double linkLatencyMaxMs{0.0};
+
+  /// \brief Number of latency samples.
+  public: uint64_t linkLatencyCount{0};
+
+  /// \brief Wall time of the last link latency report.
+  public: std::chrono::steady_clock::time_point linkReportTime;
+
   /// \brief A copy of the most recently received signal.
   public: int signal{0};
 
@@ -385,12 +925,29 @@ gz::sim::systems::ArduPilotPlugin::ArduPilotPlugin()
 /////////////////////////////////////////////////
 gz::sim::systems::ArduPilotPlugin::~ArduPilotPlugin()
 {
+  // stop the health monitor before its callback target goes
+  if (this->dataPtr->health)
+  {
+    this->dataPtr->health->Stop();
+  }
+
+  // let another vehicle match the real time factor
+  if (this->dataPtr->rtfMatcher)
+  {
+    ReleaseRealTimeFactor(this->dataPtr->worldName,
+        this->dataPtr->model.Entity());
+  }
 }
 
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::Reset(const UpdateInfo &_info,
                                               EntityComponentManager &_ecm)
 {
+  if (!this->dataPtr->validConfig)
+  {
+    return;
+  }
+
   if (!_ecm.EntityHasComponentType(this->dataPtr->imuLink,
       components::WorldPose::typeId))
   {
@@ -407,26 +964,40 @@ void gz::sim::systems::ArduPilotPlugin::Reset(const UpdateInfo &_info,
   // update velocity PID for controls and apply force to joint
   for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
   {
-    gz::sim::components::JointForceCmd* jfcComp = nullptr;
-    gz::sim::components::JointVelocityCmd* jvcComp = nullptr;
+    // kinematic controls restart from the reset joint position
+    this->dataPtr->controls[i].kinematicInit = false;
+
+    // the motor model and rotor restart from rest, so no thrust is
+    // carried over the reset
+    this->dataPtr->controls[i].modelVel = 0.0;
+    this->dataPtr->controls[i].rotorVel = 0.0;
+    this->dataPtr->controls[i].rotorAngle = 0.0;
+
+    // the motor_model and rotor controllers write their own joint
+    // command, a joint force command here would override it in physics
+    if ((this->dataPtr->controls[i].controller == "motor_model" &&
+        this->dataPtr->controls[i].type != "EFFORT") ||
+        this->dataPtr->controls[i].controller == "rotor")
+    {
+      continue;
+    }
+
     if (this->dataPtr->controls[i].useForce ||
         this->dataPtr->controls[i].type == "EFFORT")
     {
-      jfcComp = _ecm.Component<gz::sim::components::JointForceCmd>(
-          this->dataPtr->controls[i].joint);
-      if (jfcComp == nullptr)
+      if (_ecm.Component<gz::sim::components::JointForceCmd>(
+          this->dataPtr->controls[i].joint) == nullptr)
       {
-        jfcComp = _ecm.CreateComponent(this->dataPtr->controls[i].joint,
+        _ecm.CreateComponent(this->dataPtr->controls[i].joint,
             gz::sim::components::JointForceCmd({0}));
       }
     }
     else if (this->dataPtr->controls[i].type == "VELOCITY")
     {
-      jvcComp = _ecm.Component<gz::sim::components::JointVelocityCmd>(
-          this->dataPtr->controls[i].joint);
-      if (jvcComp == nullptr)
+      if (_ecm.Component<gz::sim::components::JointVelocityCmd>(
+          this->dataPtr->controls[i].joint) == nullptr)
       {
-        jvcComp = _ecm.CreateComponent(this->dataPtr->controls[i].joint,
+        _ecm.CreateComponent(this->dataPtr->controls[i].joint,
             gz::sim::components::JointVelocityCmd({0}));
       }
     }
@@ -484,22 +1055,39 @@ void gz::sim::systems::ArduPilotPlugin::Configure(
         sdfClone->Get<gz::math::Pose3d>("gazeboXYZToNED");
   }
 
+  // the frame conventions are constant, precompute the transforms used
+  // to build the state
+  //
+  /// \todo(srmainwaring) check for error.
+  /// The inverse may be incorrect. The error is not evident when using
+  /// the transform from the original plugin:
+  ///   <gazeboXYZToNED>0 0 0 GZ_PI 0 0</gazeboXYZToNED>
+  /// but is when using the correct transform which is
+  ///   <gazeboXYZToNED>0 0 0 GZ_PI 0 GZ_PI/2</gazeboXYZToNED>
+  ///
+  this->dataPtr->wldAToWldG = this->dataPtr->gazeboXYZToNED.Inverse();
+  this->dataPtr->bdyGToBdyA =
+      this->dataPtr->modelXYZToAirplaneXForwardZDown;
+
   // Load control channel params
   this->LoadControlChannels(sdfClone, _ecm);
+  this->LoadMixer(sdfClone);
 
   // Load sensor params
   this->LoadImuSensors(sdfClone, _ecm);
   this->LoadGpsSensors(sdfClone, _ecm);
   this->LoadRangeSensors(sdfClone, _ecm);
   this->LoadWindSensors(sdfClone, _ecm);
+  this->LoadOpticalFlow(sdfClone, _ecm);
 
   // Initialise sockets
-  if (!InitSockets(sdfClone))
+  if (!this->LoadInstance(sdfClone, _ecm) || !InitSockets(sdfClone))
   {
     return;
   }
 
-  // Missed update count before we declare arduPilotOnline status false
+  // Missed update count before we declare arduPilotOnline status false,
+  // taken as 10 ms per update for the default lost timeout
   this->dataPtr->connectionTimeoutMaxCount =
     sdfClone->Get("connectionTimeoutMaxCount", 10).first;
 
@@ -510,6 +1098,107 @@ void gz::sim::systems::ArduPilotPlugin::Configure(
   this->dataPtr->have32Channels =
     sdfClone->Get("have_32_channels", false).first;
 
+  // state frame format, JSON unless binary is requested or negotiated
+  this->dataPtr->stateFormat =
+    sdfClone->Get("state_format", this->dataPtr->stateFormat).first;
+  if (this->dataPtr->stateFormat != "json" &&
+      this->dataPtr->stateFormat != "binary" &&
+      this->dataPtr->stateFormat != "auto")
+  {
+    gzwarn << "[" << this->dataPtr->modelName << "] "
+           << "State format [" << this->dataPtr->stateFormat
+           << "] not recognized, must be one of json, binary, auto."
+           << " default to json.\n";
+    this->dataPtr->stateFormat = "json";
+  }
+
+  // connection health, checked against wall time deadlines off the
+  // simulation thread
+  ConnectionHealthMonitor::Params healthParams;
+  healthParams.lostTimeout =
+      std::max(0.01 * this->dataPtr->connectionTimeoutMaxCount, 0.01);
+  healthParams.degradedTimeout =
+      std::min(healthParams.degradedTimeout, 0.5 * healthParams.lostTimeout);
+  if (sdfClone->HasElement("connection_health"))
+  {
+    auto healthSdf = sdfClone->GetElement("connection_health");
+    healthParams.lostTimeout = healthSdf->Get<double>(
+        "lost_timeout", healthParams.lostTimeout).first;
+    healthParams.degradedTimeout = healthSdf->Get<double>(
+        "degraded_timeout", healthParams.degradedTimeout).first;
+    healthParams.degradedRateFraction = healthSdf->Get<double>(
+        "degraded_rate_fraction", healthParams.degradedRateFraction).first;
+  }
+
+  const std::string healthTopic = "/world/" + this->dataPtr->worldName
+      + "/model/" + this->dataPtr->modelName + "/ardupilot/connection";
+  this->dataPtr->healthPub =
+      this->dataPtr->node.Advertise<gz::msgs::StringMsg>(healthTopic);
+  this->dataPtr->health =
+      std::make_unique<ConnectionHealthMonitor>(healthParams);
+  this->dataPtr->health->Start(std::bind(
+      &gz::sim::systems::ArduPilotPluginPrivate::OnHealthChange,
+      this->dataPtr.get(),
+      std::placeholders::_1,
+      std::placeholders::_2));
+
+  gzdbg << "[" << this->dataPtr->modelName << "] "
+        << "connection health on [" << healthTopic << "], degraded after "
+        << healthParams.degradedTimeout << " s, lost after "
+        << healthParams.lostTimeout << " s\n";
+
+  // real time factor matching, the world physics gives the step size and
+  // the starting target
+  if (sdfClone->HasElement("rtf_matching"))
+  {
+    auto rtfSdf = sdfClone->GetElement("rtf_matching");
+    RealTimeFactorMatcher::Params rtfParams;
+    rtfParams.lockStep = this->dataPtr->isLockStep;
+    rtfParams.minFactor = rtfSdf->Get<double>(
+        "min_factor", rtfParams.minFactor).first;
+    rtfParams.maxFactor = rtfSdf->Get<double>(
+        "max_factor", rtfParams.maxFactor).first;
+    rtfParams.period = rtfSdf->Get<double>(
+        "period", rtfParams.period).first;
+    rtfParams.waitFraction = rtfSdf->Get<double>(
+        "wait_fraction", rtfParams.waitFraction).first;
+    rtfParams.stepUp = rtfSdf->Get<double>(
+        "step_up", rtfParams.stepUp).first;
+    rtfParams.headroom = rtfSdf->Get<double>(
+        "headroom", rtfParams.headroom).first;
+    rtfParams.deadband = rtfSdf->Get<double>(
+        "deadband", rtfParams.deadband).first;
+
+    // one matcher per world, the first vehicle loaded drives the target
+    std::string owner = this->dataPtr->modelName;
+    if (!ClaimRealTimeFactor(this->dataPtr->worldName,
+        this->dataPtr->model.Entity(), owner))
+    {
+      gzwarn << "[" << this->dataPtr->modelName << "] "
+             << "the real time factor of world ["
+             << this->dataPtr->worldName << "] is already matched by ["
+             << owner << "], <rtf_matching> ignored.\n";
+    }
+    else
+    {
+      double factor = 1.0;
+      if (auto physicsComp = _ecm.Component<gz::sim::components::Physics>(
+          this->dataPtr->world.Entity()))
+      {
+        this->dataPtr->physicsStepSize = physicsComp->Data().MaxStepSize();
+        factor = physicsComp->Data().RealTimeFactor();
+      }
+      this->dataPtr->rtfMatcher =
+          std::make_unique<RealTimeFactorMatcher>(rtfParams);
+      this->dataPtr->rtfMatcher->Reset(factor, 0.0, 0.0);
+      this->dataPtr->rtfUpdateTime = std::chrono::steady_clock::time_point();
+
+      gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "matching the real time factor to the controller between "
+            << rtfParams.minFactor << " and " << rtfParams.maxFactor << "\n";
+    }
+  }
+
   // Add the signal handler
   this->dataPtr->sigHandler.AddCallback(
       std::bind(
@@ -517,6 +1206,8 @@ void gz::sim::systems::ArduPilotPlugin::Configure(
         this->dataPtr.get(),
         std::placeholders::_1));
 
+  this->dataPtr->validConfig = true;
+
   gzlog << "[" << this->dataPtr->modelName << "] "
         << "ArduPilot ready to fly. The force will be with you" << "\n";
 }
@@ -593,6 +1284,40 @@ void gz::sim::systems::ArduPilotPlugin::LoadControlChannels(
       control.useForce = controlSDF->Get<bool>("useForce");
     }
 
+    control.maxRate = controlSDF->Get("max_rate", control.maxRate).first;
+    control.maxAccel = controlSDF->Get("max_accel", control.maxAccel).first;
+
+    if (controlSDF->HasElement("controller"))
+    {
+      control.controller = controlSDF->Get<std::string>("controller");
+      if (control.controller != "pid" &&
+          control.controller != "motor_model" &&
+          control.controller != "rotor")
+      {
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+               << "Controller [" << control.controller
+               << "] not recognized, must be one of"
+               << " pid, motor_model, rotor. default to pid.\n";
+        control.controller = "pid";
+      }
+      if (control.controller == "rotor" && control.type != "VELOCITY")
+      {
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+               << "Controller [rotor] requires a VELOCITY control."
+               << " default to pid.\n";
+        control.controller = "pid";
+      }
+    }
+    control.timeConstant =
+        controlSDF->Get("time_constant", control.timeConstant).first;
+    if (control.timeConstant <= 0.0)
+    {
+      gzwarn << "[" << this->dataPtr->modelName << "] "
+             << "channel[" << control.channel
+             << "]: <time_constant> must be positive, default to 0.05\n";
+      control.timeConstant = 0.05;
+    }
+
     if (controlSDF->HasElement("jointName"))
     {
       control.jointName = controlSDF->Get<std::string>("jointName");
@@ -615,6 +1340,21 @@ void gz::sim::systems::ArduPilotPlugin::LoadControlChannels(
       return;
     }
 
+    // rotor wrench applied to the body link, by default the joint parent
+    if (control.controller == "rotor")
+    {
+      this->LoadRotor(controlSDF, control, _ecm);
+    }
+
+    // joint limits bound kinematic position commands, since a position
+    // reset bypasses the physics engine's limits
+    if (auto axisComp = _ecm.Component<gz::sim::components::JointAxis>(
+        control.joint))
+    {
+      control.lowerLimit = axisComp->Data().Lower();
+      control.upperLimit = axisComp->Data().Upper();
+    }
+
     // set up publisher if relaying the command
     if (control.type == "COMMAND")
     {
@@ -713,6 +1453,36 @@ void gz::sim::systems::ArduPilotPlugin::LoadControlChannels(
             << control.servo_max << "\n";
     }
 
+    // optional nonlinear PWM to command curve
+    if (controlSDF->HasElement("curve"))
+    {
+      auto curveSDF = controlSDF->GetElement("curve");
+      control.curveDeadband = gz::math::clamp(
+          curveSDF->Get("deadband", control.curveDeadband).first,
+          0.0, 0.999);
+      control.curveExponent =
+          curveSDF->Get("exponent", control.curveExponent).first;
+
+      if (curveSDF->HasElement("table"))
+      {
+        auto pointSDF = curveSDF->GetElement("table")->GetElement("point");
+        while (pointSDF)
+        {
+          const auto point = pointSDF->Get<gz::math::Vector2d>();
+          control.curveTable.emplace_back(point.X(), point.Y());
+          pointSDF = pointSDF->GetNextElement("point");
+        }
+        std::sort(control.curveTable.begin(), control.curveTable.end());
+      }
+
+      gzdbg << "[" << this->dataPtr->modelName << "] "
+            << "channel[" << control.channel
+            << "]: curve deadband [" << control.curveDeadband
+            << "] exponent [" << control.curveExponent
+            << "] table points [" << control.curveTable.size() << "]\n";
+    }
+    control.BuildCommandTable();
+
     control.rotorVelocitySlowdownSim =
         controlSDF->Get("rotorVelocitySlowdownSim", 1).first;
 
@@ -725,19 +1495,25 @@ void gz::sim::systems::ArduPilotPlugin::LoadControlChannels(
       control.rotorVelocitySlowdownSim = 1.0;
     }
 
+    // joint state feedback filter
+    if (controlSDF->HasElement("filter"))
+    {
+      const std::string filterName = controlSDF->Get<std::string>("filter");
+      if (!JointStateFilterBank::ParseType(filterName, control.filterType))
+      {
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+               << "Filter [" << filterName
+               << "] not recognized, must be one of"
+               << " none, one_pole, biquad, notch. default to none.\n";
+      }
+    }
     control.frequencyCutoff =
           controlSDF->Get("frequencyCutoff", control.frequencyCutoff).first;
     control.samplingRate =
           controlSDF->Get("samplingRate", control.samplingRate).first;
-
-    // use gazebo::math::Filter
-    control.filter.Fc(control.frequencyCutoff, control.samplingRate);
-
-    // initialize filter to zero value
-    control.filter.Set(0.0);
-
-    // note to use this filter, do
-    // stateFiltered = filter.Process(stateRaw);
+    control.filterQ = controlSDF->Get("filter_q", control.filterQ).first;
+    control.notchBlades =
+          controlSDF->Get("notch_blades", control.notchBlades).first;
 
     // Overload the PID parameters if they are available.
     double param;
@@ -791,6 +1567,18 @@ void gz::sim::systems::ArduPilotPlugin::LoadControlChannels(
     this->dataPtr->controls.push_back(control);
     controlSDF = controlSDF->GetNextElement("control");
   }
+
+  // one filter per control, run together on the joint states
+  auto &bank = this->dataPtr->filterBank;
+  bank.Resize(this->dataPtr->controls.size());
+  for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
+  {
+    const Control &control = this->dataPtr->controls[i];
+    bank.Configure(i, control.filterType, control.frequencyCutoff,
+        control.filterQ, control.samplingRate);
+  }
+  this->dataPtr->filterIn.assign(bank.Size(), 0.0);
+  this->dataPtr->filterOut.assign(bank.Size(), 0.0);
 }
 
 /////////////////////////////////////////////////
@@ -878,13 +1666,17 @@ void gz::sim::systems::ArduPilotPlugin::LoadGpsSensors(
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::LoadRangeSensors(
     sdf::ElementPtr _sdf,
-    gz::sim::EntityComponentManager &/*_ecm*/)
+    gz::sim::EntityComponentManager &_ecm)
 {
     struct SensorIdentifier
     {
         std::string type;
         int index;
         std::string topic;
+        std::string link;
+        gz::math::Pose3d pose;
+        double minRange{0.2};
+        double maxRange{40.0};
     };
     std::vector<SensorIdentifier> sensorIds;
 
@@ -921,8 +1713,23 @@ void gz::sim::systems::ArduPilotPlugin::LoadRangeSensors(
                 << "sensor element 'index' not specified, skipping.\n";
         }
 
-        // <topic> is required
-        if (sensorSdf->HasElement("topic"))
+        // <link> is required for a raycast sensor, <topic> otherwise
+        if (sensorId.type == "raycast")
+        {
+            sensorId.link = sensorSdf->Get<std::string>("link", "").first;
+            sensorId.pose = sensorSdf->Get<gz::math::Pose3d>(
+                "pose", sensorId.pose).first;
+            sensorId.minRange = sensorSdf->Get<double>(
+                "min_range", sensorId.minRange).first;
+            sensorId.maxRange = sensorSdf->Get<double>(
+                "max_range", sensorId.maxRange).first;
+            if (sensorId.link.empty())
+            {
+                gzwarn << "[" << this->dataPtr->modelName << "] "
+                    << "sensor element 'link' not specified, skipping.\n";
+            }
+        }
+        else if (sensorSdf->HasElement("topic"))
         {
             sensorId.topic = sensorSdf->Get<std::string>("topic");
         }
@@ -955,11 +1762,43 @@ void gz::sim::systems::ArduPilotPlugin::LoadRangeSensors(
     // subscriptions
     for (auto &&sensorId : sensorIds)
     {
-        /// \todo(anyone) see comment above re. topics
-        /// fully qualified topic name
-        /// std::string topicName = topicPrefix;
-        /// topicName.append("/").append(sensorId.topic);
-        std::string topicName = sensorId.topic;
+        // raycast sensors are entities on the link, cast by the
+        // RangefinderPlugin world system
+        if (sensorId.type == "raycast")
+        {
+            /// \todo(anyone) initalise ranges properly
+            /// (AP convention for ignored value?)
+            this->dataPtr->ranges.push_back(-1.0);
+
+            gz::sim::Entity link =
+                this->dataPtr->model.LinkByName(_ecm, sensorId.link);
+            if (link == gz::sim::kNullEntity)
+            {
+                gzwarn << "[" << this->dataPtr->modelName << "] "
+                    << "range sensor link [" << sensorId.link
+                    << "] not found.\n";
+                continue;
+            }
+
+            gz::sim::Entity entity =
+                this->dataPtr->CreateRaycastRangefinder(_ecm, link,
+                    "rangefinder_" + std::to_string(sensorId.index),
+                    sensorId.pose, sensorId.minRange, sensorId.maxRange);
+
+            this->dataPtr->raycastRanges.push_back({
+                static_cast<size_t>(sensorId.index - 1), entity,
+                sensorId.maxRange});
+
+            gzmsg << "[" << this->dataPtr->modelName << "] raycast "
+                  << "range sensor on link [" << sensorId.link << "]\n";
+            continue;
+        }
+
+        /// \todo(anyone) see comment above re. topics
+        /// fully qualified topic name
+        /// std::string topicName = topicPrefix;
+        /// topicName.append("/").append(sensorId.topic);
+        std::string topicName = sensorId.topic;
 
         // Bind the sensor index to the callback function
         // (adjust from unit to zero offset)
@@ -991,6 +1830,237 @@ void gz::sim::systems::ArduPilotPlugin::LoadRangeSensors(
     }
 }
 
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::LoadRotor(
+    sdf::ElementPtr _sdf,
+    Control &_control,
+    gz::sim::EntityComponentManager &_ecm)
+{
+  sdf::ElementPtr rotorSdf =
+      _sdf->HasElement("rotor") ? _sdf->GetElement("rotor") : nullptr;
+  if (rotorSdf)
+  {
+    _control.rotorThrustCoefficient = rotorSdf->Get<double>(
+        "thrust_coefficient", _control.rotorThrustCoefficient).first;
+    _control.rotorTorqueCoefficient = rotorSdf->Get<double>(
+        "torque_coefficient", _control.rotorTorqueCoefficient).first;
+    _control.rotorVisualSlowdown = rotorSdf->Get<double>(
+        "visual_slowdown", _control.rotorVisualSlowdown).first;
+  }
+
+  // the links either side of the joint, named within its model
+  const gz::sim::Entity jointModel =
+      _ecm.Component<gz::sim::components::ParentEntity>(
+          _control.joint)->Data();
+  auto linkInModel = [&](const std::string &_name)
+  {
+    return _ecm.EntityByComponents(
+        gz::sim::components::Link(),
+        gz::sim::components::ParentEntity(jointModel),
+        gz::sim::components::Name(_name));
+  };
+  _control.rotorLink = linkInModel(
+      _ecm.Component<gz::sim::components::ChildLinkName>(
+          _control.joint)->Data());
+  _control.rotorBodyLink = linkInModel(
+      _ecm.Component<gz::sim::components::ParentLinkName>(
+          _control.joint)->Data());
+
+  if (rotorSdf && rotorSdf->HasElement("link"))
+  {
+    const std::string linkName = rotorSdf->Get<std::string>("link");
+    auto entities = EntitiesFromUnscopedName(
+        linkName, _ecm, this->dataPtr->model.Entity());
+    _control.rotorBodyLink = entities.empty() ?
+        gz::sim::kNullEntity : *entities.begin();
+  }
+
+  if (_control.rotorLink == gz::sim::kNullEntity ||
+      _control.rotorBodyLink == gz::sim::kNullEntity)
+  {
+    gzerr << "[" << this->dataPtr->modelName << "] "
+          << "rotor joint [" << _control.jointName
+          << "] links not found, default to pid.\n";
+    _control.controller = "pid";
+    return;
+  }
+
+  // the axis in the rotor link frame
+  if (auto axisComp = _ecm.Component<gz::sim::components::JointAxis>(
+      _control.joint))
+  {
+    _control.rotorAxis = axisComp->Data().Xyz();
+    if (auto poseComp = _ecm.Component<gz::sim::components::Pose>(
+        _control.joint))
+    {
+      _control.rotorAxis =
+          poseComp->Data().Rot().RotateVector(_control.rotorAxis);
+    }
+    _control.rotorAxis.Normalize();
+  }
+
+  enableComponent<components::WorldPose>(_ecm, _control.rotorLink, true);
+  enableComponent<components::WorldPose>(_ecm, _control.rotorBodyLink, true);
+
+  gzdbg << "[" << this->dataPtr->modelName << "] "
+        << "channel[" << _control.channel
+        << "]: rotor thrust coefficient ["
+        << _control.rotorThrustCoefficient << "] torque coefficient ["
+        << _control.rotorTorqueCoefficient << "]\n";
+}
+
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::LoadMixer(sdf::ElementPtr _sdf)
+{
+    if (!_sdf->HasElement("mixer"))
+    {
+        return;
+    }
+    sdf::ElementPtr mixerSdf = _sdf->GetElement("mixer");
+
+    // inputs, each a PWM channel normalised to [-1, 1]
+    std::vector<int> channels;
+    std::vector<double> servoMin;
+    std::vector<double> servoMax;
+    for (auto inputSdf = mixerSdf->FindElement("input"); inputSdf;
+        inputSdf = inputSdf->GetNextElement("input"))
+    {
+        if (!inputSdf->HasAttribute("channel"))
+        {
+            gzerr << "[" << this->dataPtr->modelName << "] "
+                  << "mixer <input> requires a channel attribute, "
+                  << "mixer disabled.\n";
+            return;
+        }
+        const int channel =
+          atoi(inputSdf->GetAttribute("channel")->GetAsString().c_str());
+        if (channel < 0 || channel >= 32)
+        {
+            gzerr << "[" << this->dataPtr->modelName << "] "
+                  << "mixer <input> channel [" << channel
+                  << "] must be in [0, 31], mixer disabled.\n";
+            return;
+        }
+        channels.push_back(channel);
+        servoMin.push_back(inputSdf->Get<double>("servo_min", 1000.0).first);
+        servoMax.push_back(inputSdf->Get<double>("servo_max", 2000.0).first);
+    }
+
+    // outputs, one row of coefficients per mixed control
+    std::vector<double> matrix;
+    std::vector<size_t> controls;
+    for (auto outputSdf = mixerSdf->FindElement("output"); outputSdf;
+        outputSdf = outputSdf->GetNextElement("output"))
+    {
+        const std::string jointName = outputSdf->HasAttribute("joint") ?
+            outputSdf->GetAttribute("joint")->GetAsString() : "";
+        auto control = std::find_if(
+            this->dataPtr->controls.begin(), this->dataPtr->controls.end(),
+            [&](const Control &_control)
+            {
+              return _control.jointName == jointName;
+            });
+        if (control == this->dataPtr->controls.end())
+        {
+            gzerr << "[" << this->dataPtr->modelName << "] "
+                  << "mixer <output> joint [" << jointName
+                  << "] has no <control>, mixer disabled.\n";
+            return;
+        }
+
+        std::istringstream iss(outputSdf->Get<std::string>());
+        std::vector<double> row{std::istream_iterator<double>(iss),
+            std::istream_iterator<double>()};
+        if (row.size() != channels.size())
+        {
+            gzerr << "[" << this->dataPtr->modelName << "] "
+                  << "mixer <output> joint [" << jointName << "] has "
+                  << row.size() << " coefficients, expected "
+                  << channels.size() << ", mixer disabled.\n";
+            return;
+        }
+        matrix.insert(matrix.end(), row.begin(), row.end());
+        controls.push_back(static_cast<size_t>(
+            control - this->dataPtr->controls.begin()));
+    }
+
+    if (channels.empty() || controls.empty())
+    {
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+               << "mixer has no inputs or outputs, ignored.\n";
+        return;
+    }
+
+    for (size_t index : controls)
+    {
+        this->dataPtr->controls[index].mixed = true;
+    }
+    this->dataPtr->mixerChannels = channels;
+    this->dataPtr->mixerServoMin = servoMin;
+    this->dataPtr->mixerServoMax = servoMax;
+    this->dataPtr->mixerControls = controls;
+    this->dataPtr->mixerIn.assign(channels.size(), 0.0);
+    this->dataPtr->mixerOut.assign(controls.size(), 0.0);
+    this->dataPtr->mixer.SetMatrix(controls.size(), channels.size(), matrix);
+
+    gzmsg << "[" << this->dataPtr->modelName << "] mixer "
+          << controls.size() << " x " << channels.size() << "\n";
+}
+
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::LoadOpticalFlow(
+    sdf::ElementPtr _sdf,
+    gz::sim::EntityComponentManager &_ecm)
+{
+    if (!_sdf->HasElement("optical_flow"))
+    {
+        return;
+    }
+
+    sdf::ElementPtr flowSdf = _sdf->GetElement("optical_flow");
+    auto &flow = this->dataPtr->opticalFlow;
+
+    const double rate = flowSdf->Get<double>("update_rate", 20.0).first;
+    flow.period = rate > 0.0 ? 1.0 / rate : 0.0;
+    flow.noiseStdDev = flowSdf->Get<double>(
+        "noise_stddev", flow.noiseStdDev).first;
+    flow.minRange = flowSdf->Get<double>(
+        "min_range", flow.minRange).first;
+    flow.maxRange = flowSdf->Get<double>(
+        "max_range", flow.maxRange).first;
+
+    // ground distance from a ray on the link if given, otherwise the
+    // height above flat ground
+    const std::string linkName =
+        flowSdf->Get<std::string>("link", "").first;
+    if (!linkName.empty())
+    {
+        gz::sim::Entity link =
+            this->dataPtr->model.LinkByName(_ecm, linkName);
+        if (link == gz::sim::kNullEntity)
+        {
+            gzerr << "[" << this->dataPtr->modelName << "] "
+                << "optical flow link [" << linkName << "] not found, "
+                << "sensor disabled.\n";
+            return;
+        }
+
+        // by default the ray points down the link z axis
+        const gz::math::Pose3d pose = flowSdf->Get<gz::math::Pose3d>(
+            "pose", gz::math::Pose3d(0, 0, 0, 0, GZ_PI / 2.0, 0)).first;
+        flow.entity = this->dataPtr->CreateRaycastRangefinder(_ecm, link,
+            "optical_flow", pose, flow.minRange, flow.maxRange);
+    }
+
+    flow.enabled = true;
+
+    gzmsg << "[" << this->dataPtr->modelName << "] optical flow "
+          << "rate: " << rate
+          << ", ground distance: "
+          << (linkName.empty() ? "flat ground" : "raycast on " + linkName)
+          << "\n";
+}
+
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::LoadWindSensors(
     sdf::ElementPtr _sdf,
@@ -1005,6 +2075,11 @@ void gz::sim::systems::ArduPilotPlugin::PreUpdate(
     const gz::sim::UpdateInfo &_info,
     gz::sim::EntityComponentManager &_ecm)
 {
+    if (!this->dataPtr->validConfig)
+    {
+        return;
+    }
+
     static bool calledInitAnemometerOnce{false};
     if (!this->dataPtr->anemometerName.empty() &&
         !this->dataPtr->anemometerInitialized &&
@@ -1089,6 +2164,10 @@ void gz::sim::systems::ArduPilotPlugin::PreUpdate(
         enableComponent<components::WorldLinearVelocity>(
             _ecm, this->dataPtr->anemometerEntity, true);
 
+        // Request the local wind from a WindFieldPlugin, if present.
+        enableComponent<components::WindFieldVelocity>(
+            _ecm, this->dataPtr->anemometerEntity, true);
+
         this->dataPtr->anemometerInitialized = true;
     }
 
@@ -1187,10 +2266,14 @@ void gz::sim::systems::ArduPilotPlugin::PreUpdate(
     }
     else
     {
+        // the health deadlines are held while paused
+        this->dataPtr->health->SetActive(!_info.paused);
+
         // Update the control surfaces.
         if (!_info.paused && _info.simTime >
             this->dataPtr->lastControllerUpdateTime)
         {
+            const auto recvStart = std::chrono::steady_clock::now();
             if (this->dataPtr->isLockStep)
             {
                 while (!this->ReceiveServoPacket() &&
@@ -1209,6 +2292,11 @@ void gz::sim::systems::ArduPilotPlugin::PreUpdate(
                 this->dataPtr->lastServoPacketRecvTime = _info.simTime;
             }
 
+            if (this->dataPtr->rtfMatcher)
+            {
+                this->UpdateRealTimeFactor(_info, recvStart);
+            }
+
             if (this->dataPtr->arduPilotOnline)
             {
                 double dt =
@@ -1221,11 +2309,52 @@ void gz::sim::systems::ArduPilotPlugin::PreUpdate(
     }
 }
 
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::UpdateRealTimeFactor(
+    const gz::sim::UpdateInfo &_info,
+    const std::chrono::steady_clock::time_point &_recvStart)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double wallTime =
+        std::chrono::duration<double>(now.time_since_epoch()).count();
+    const double simTime =
+        std::chrono::duration<double>(_info.simTime).count();
+    auto &matcher = *this->dataPtr->rtfMatcher;
+
+    // restart the window on the first update and after a pause
+    const double sinceUpdate = std::chrono::duration<double>(
+        now - this->dataPtr->rtfUpdateTime).count();
+    this->dataPtr->rtfUpdateTime = now;
+    if (sinceUpdate > matcher.Parameters().period)
+    {
+        matcher.Reset(matcher.Target(), wallTime, simTime);
+        return;
+    }
+
+    matcher.AddWait(std::chrono::duration<double>(now - _recvStart).count());
+
+    double factor;
+    if (matcher.Update(wallTime, simTime, factor))
+    {
+        gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "real time factor " << factor << " (achieved "
+            << matcher.AchievedFactor() << ", controller "
+            << matcher.ControllerFactor() << ", waiting "
+            << 100.0 * matcher.WaitFraction() << "%)\n";
+        this->dataPtr->SetRealTimeFactor(factor);
+    }
+}
+
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::PostUpdate(
     const gz::sim::UpdateInfo &_info,
     const gz::sim::EntityComponentManager &_ecm)
 {
+    if (!this->dataPtr->validConfig)
+    {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(this->dataPtr->mutex);
 
     // Publish the new state.
@@ -1235,7 +2364,7 @@ void gz::sim::systems::ArduPilotPlugin::PostUpdate(
         double t =
             std::chrono::duration_cast<std::chrono::duration<double>>(
                 _info.simTime).count();
-        this->CreateStateJSON(t, _ecm);
+        this->CreateState(t, _ecm);
         this->SendState();
         this->dataPtr->lastControllerUpdateTime = _info.simTime;
     }
@@ -1252,6 +2381,62 @@ void gz::sim::systems::ArduPilotPlugin::ResetPIDs()
   }
 }
 
+/////////////////////////////////////////////////
+bool gz::sim::systems::ArduPilotPlugin::LoadInstance(
+    sdf::ElementPtr _sdf,
+    const gz::sim::EntityComponentManager &_ecm)
+{
+  if (!_sdf->HasElement("instance"))
+  {
+    return true;
+  }
+
+  this->dataPtr->instancePortStride = _sdf->Get<uint32_t>(
+      "instance_port_stride", this->dataPtr->instancePortStride).first;
+
+  const std::string value = _sdf->Get<std::string>("instance");
+  std::string digits;
+  if (value == "auto")
+  {
+    // trailing digits of the top level model name, which is unique in
+    // the world, so one model file serves every vehicle of a swarm
+    const gz::sim::Entity topModel =
+        gz::sim::topLevelModel(this->dataPtr->model.Entity(), _ecm);
+    std::string name;
+    if (auto nameComp = _ecm.Component<gz::sim::components::Name>(topModel))
+    {
+      name = nameComp->Data();
+    }
+    const size_t pos = name.find_last_not_of("0123456789");
+    digits = name.substr(pos == std::string::npos ? 0 : pos + 1);
+    if (digits.empty())
+    {
+      gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "model name [" << name << "] has no instance number,"
+            << " using instance 0.\n";
+      digits = "0";
+    }
+  }
+  else
+  {
+    digits = value;
+  }
+
+  if (digits.empty() || digits.size() > 5 ||
+      digits.find_first_not_of("0123456789") != std::string::npos)
+  {
+    gzerr << "[" << this->dataPtr->modelName << "] "
+          << "<instance> [" << value << "] must be a non-negative integer"
+          << " or auto, aborting plugin.\n";
+    return false;
+  }
+  this->dataPtr->instance = static_cast<uint32_t>(std::stoul(digits));
+
+  gzmsg << "[" << this->dataPtr->modelName << "] "
+        << "instance [" << this->dataPtr->instance << "]\n";
+  return true;
+}
+
 /////////////////////////////////////////////////
 bool gz::sim::systems::ArduPilotPlugin::InitSockets(sdf::ElementPtr _sdf) const
 {
@@ -1259,8 +2444,18 @@ bool gz::sim::systems::ArduPilotPlugin::InitSockets(sdf::ElementPtr _sdf) const
     this->dataPtr->fdm_address =
         _sdf->Get("fdm_addr", static_cast<std::string>("127.0.0.1")).first;
 
-    this->dataPtr->fdm_port_in =
-        _sdf->Get("fdm_port_in", static_cast<uint32_t>(9002)).first;
+    const uint32_t port =
+        _sdf->Get("fdm_port_in", static_cast<uint32_t>(9002)).first +
+        this->dataPtr->instance * this->dataPtr->instancePortStride;
+    if (port > std::numeric_limits<uint16_t>::max())
+    {
+        gzerr << "[" << this->dataPtr->modelName << "] "
+            << "fdm port [" << port << "] of instance ["
+            << this->dataPtr->instance << "] is out of range,"
+            << " aborting plugin.\n";
+        return false;
+    }
+    this->dataPtr->fdm_port_in = static_cast<uint16_t>(port);
 
     // output port configuration is automatic
     if (_sdf->HasElement("listen_addr")) {
@@ -1286,14 +2481,408 @@ bool gz::sim::systems::ArduPilotPlugin::InitSockets(sdf::ElementPtr _sdf) const
         << "flight dynamics model @ "
         << this->dataPtr->fdm_address << ":" << this->dataPtr->fdm_port_in
         << "\n";
+
+    // optional network impairment for latency and loss testing
+    if (_sdf->HasElement("impairment"))
+    {
+        auto impairmentSdf = _sdf->GetElement("impairment");
+        UDPImpairment impairment;
+        impairment.seed = impairmentSdf->Get<uint32_t>(
+            "seed", impairment.seed).first;
+        impairment.delay_ms = impairmentSdf->Get<double>(
+            "delay", impairment.delay_ms).first;
+        impairment.jitter_ms = impairmentSdf->Get<double>(
+            "jitter", impairment.jitter_ms).first;
+        impairment.loss = impairmentSdf->Get<double>(
+            "loss", impairment.loss).first;
+        impairment.reorder = impairmentSdf->Get<double>(
+            "reorder", impairment.reorder).first;
+        impairment.duplicate = impairmentSdf->Get<double>(
+            "duplicate", impairment.duplicate).first;
+
+        const std::string distribution = impairmentSdf->Get<std::string>(
+            "distribution", "constant").first;
+        if (distribution == "uniform")
+        {
+            impairment.distribution = UDPImpairment::Distribution::UNIFORM;
+        }
+        else if (distribution == "normal")
+        {
+            impairment.distribution = UDPImpairment::Distribution::NORMAL;
+        }
+        else if (distribution == "pareto")
+        {
+            impairment.distribution = UDPImpairment::Distribution::PARETO;
+        }
+        else if (distribution != "constant")
+        {
+            gzwarn << "[" << this->dataPtr->modelName << "] "
+                << "impairment distribution [" << distribution
+                << "] not recognized, must be one of constant, uniform,"
+                << " normal, pareto. default to constant.\n";
+        }
+
+        const std::string direction = impairmentSdf->Get<std::string>(
+            "direction", "both").first;
+        impairment.impair_send = direction != "recv";
+        impairment.impair_recv = direction != "send";
+
+        this->dataPtr->sock.set_impairment(impairment);
+        gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "impairing " << direction << " with delay "
+            << impairment.delay_ms << " ms, jitter " << impairment.jitter_ms
+            << " ms (" << distribution << "), loss " << impairment.loss
+            << ", reorder " << impairment.reorder
+            << ", duplicate " << impairment.duplicate
+            << ", seed " << impairment.seed << "\n";
+    }
+
+    // optional low-latency socket profile for dedicated rigs
+    if (_sdf->HasElement("low_latency"))
+    {
+        auto lowLatencySdf = _sdf->GetElement("low_latency");
+        UDPLowLatency options;
+        options.rcvbuf = lowLatencySdf->Get<int>(
+            "rcvbuf", options.rcvbuf).first;
+        options.sndbuf = lowLatencySdf->Get<int>(
+            "sndbuf", options.sndbuf).first;
+        options.busy_poll_us = lowLatencySdf->Get<int>(
+            "busy_poll", options.busy_poll_us).first;
+        options.priority = lowLatencySdf->Get<int>(
+            "priority", options.priority).first;
+        options.spin = lowLatencySdf->Get<bool>(
+            "spin", options.spin).first;
+        options.spin_cpu = lowLatencySdf->Get<int>(
+            "spin_cpu", options.spin_cpu).first;
+
+        if (!this->dataPtr->sock.set_low_latency(options))
+        {
+            gzwarn << "[" << this->dataPtr->modelName << "] "
+                << "some low latency socket options could not be set,"
+                << " check the process has CAP_NET_ADMIN for priority"
+                << " and busy polling.\n";
+        }
+        gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "low latency socket: rcvbuf " << options.rcvbuf
+            << ", sndbuf " << options.sndbuf
+            << ", busy_poll " << options.busy_poll_us << " us"
+            << ", priority " << options.priority
+            << ", spin " << options.spin << " on cpu " << options.spin_cpu
+            << "\n";
+    }
+
+    this->dataPtr->linkReportTime = std::chrono::steady_clock::now();
     return true;
 }
 
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::ReportLinkLatency()
+{
+    // latency from sending a state to receiving the next servo packet
+    const auto now = std::chrono::steady_clock::now();
+    const double latencyMs = std::chrono::duration<double, std::milli>(
+        now - this->dataPtr->stateSendTime).count();
+    this->dataPtr->linkLatencySumMs += latencyMs;
+    this->dataPtr->linkLatencyMaxMs =
+        std::max(this->dataPtr->linkLatencyMaxMs, latencyMs);
+    this->dataPtr->linkLatencyCount++;
+
+    if (now - this->dataPtr->linkReportTime < std::chrono::seconds(5))
+    {
+        return;
+    }
+    this->dataPtr->linkReportTime = now;
+
+    gzmsg << "[" << this->dataPtr->modelName << "] "
+        << "link latency mean "
+        << this->dataPtr->linkLatencySumMs / this->dataPtr->linkLatencyCount
+        << " ms, max " << this->dataPtr->linkLatencyMaxMs << " ms\n";
+
+    if (this->dataPtr->sock.impaired())
+    {
+        const auto &tx = this->dataPtr->sock.send_stats();
+        const auto &rx = this->dataPtr->sock.recv_stats();
+        gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "impairment send delivered " << tx.delivered
+            << ", dropped " << tx.dropped
+            << ", duplicated " << tx.duplicated
+            << ", reordered " << tx.reordered
+            << " | recv delivered " << rx.delivered
+            << ", dropped " << rx.dropped
+            << ", duplicated " << rx.duplicated
+            << ", reordered " << rx.reordered << "\n";
+    }
+
+    const auto &wakeup = this->dataPtr->sock.wakeup_stats();
+    if (wakeup.count > 0)
+    {
+        gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "receive wakeup latency mean "
+            << wakeup.sum_us / wakeup.count << " us, max "
+            << wakeup.max_us << " us\n";
+        this->dataPtr->sock.reset_wakeup_stats();
+    }
+
+    this->dataPtr->linkLatencySumMs = 0.0;
+    this->dataPtr->linkLatencyMaxMs = 0.0;
+    this->dataPtr->linkLatencyCount = 0;
+}
+
+/////////////////////////////////////////////////
+namespace
+{
+/// \brief Move a kinematic position control towards its command.
+///
+/// The velocity follows a braking curve so the joint decelerates into
+/// the target without overshoot, and is bounded by the rate and
+/// acceleration limits of the control.
+void updateKinematicPosition(
+  Control &_control,
+  const double _dt,
+  gz::sim::EntityComponentManager &_ecm)
+{
+    if (!_control.kinematicInit)
+    {
+        auto pComp = _ecm.Component<gz::sim::components::JointPosition>(
+            _control.joint);
+        if (pComp == nullptr)
+        {
+            // populated by physics from the next step
+            _ecm.CreateComponent(_control.joint,
+                gz::sim::components::JointPosition());
+            return;
+        }
+        if (pComp->Data().empty())
+        {
+            return;
+        }
+        _control.kinematicPos = pComp->Data()[0];
+        _control.kinematicVel = 0.0;
+        _control.kinematicInit = true;
+    }
+
+    if (_dt <= 0.0)
+    {
+        return;
+    }
+
+    const double target = gz::math::clamp(
+        _control.cmd, _control.lowerLimit, _control.upperLimit);
+    const double error = target - _control.kinematicPos;
+    const double dir = error < 0.0 ? -1.0 : 1.0;
+
+    // speed that reaches the target this step, bounded by the rate limit
+    // and by the speed that can still be stopped within the distance left
+    double speed = std::abs(error) / _dt;
+    if (_control.maxRate > 0.0)
+    {
+        speed = std::min(speed, _control.maxRate);
+    }
+    if (_control.maxAccel > 0.0)
+    {
+        speed = std::min(speed,
+            std::sqrt(2.0 * _control.maxAccel * std::abs(error)));
+    }
+
+    double vel = dir * speed;
+    if (_control.maxAccel > 0.0)
+    {
+        const double dv = _control.maxAccel * _dt;
+        vel = gz::math::clamp(vel,
+            _control.kinematicVel - dv, _control.kinematicVel + dv);
+    }
+
+    double pos = _control.kinematicPos + vel * _dt;
+    if ((target - pos) * dir <= 0.0 && vel * dir >= 0.0)
+    {
+        pos = target;
+        vel = 0.0;
+    }
+    _control.kinematicPos = pos;
+    _control.kinematicVel = vel;
+
+    _ecm.SetComponentData<gz::sim::components::JointPositionReset>(
+        _control.joint, {pos});
+    _ecm.SetComponentData<gz::sim::components::JointVelocityReset>(
+        _control.joint, {vel});
+}
+
+/// \brief Apply the thrust and drag torque of a rotor to its body link.
+///
+/// The rotor speed follows the command with the first-order response of
+/// the motor model. Thrust along the rotor axis and the drag torque
+/// against the spin are applied to the body link at the rotor hub, and
+/// the rotor joint is reset to a slowed visual spin, so no fast joint
+/// is left for the physics engine to integrate.
+void updateRotor(
+  Control &_control,
+  const double _dt,
+  gz::sim::EntityComponentManager &_ecm)
+{
+    if (_dt <= 0.0)
+    {
+        return;
+    }
+    const double decay = std::exp(-_dt / _control.timeConstant);
+    _control.rotorVel = _control.cmd + (_control.rotorVel - _control.cmd) *
+        decay;
+    const double w = _control.rotorVel;
+
+    auto bodyPose = _ecm.Component<gz::sim::components::WorldPose>(
+        _control.rotorBodyLink);
+    auto rotorPose = _ecm.Component<gz::sim::components::WorldPose>(
+        _control.rotorLink);
+    if (bodyPose == nullptr || rotorPose == nullptr)
+    {
+        return;
+    }
+
+    // wrench about the body link origin
+    const gz::math::Vector3d axis =
+        rotorPose->Data().Rot().RotateVector(_control.rotorAxis);
+    const gz::math::Vector3d force =
+        _control.rotorThrustCoefficient * w * w * axis;
+    const gz::math::Vector3d torque =
+        (rotorPose->Data().Pos() - bodyPose->Data().Pos()).Cross(force) -
+        _control.rotorTorqueCoefficient * w * std::abs(w) * axis;
+    gz::sim::Link(_control.rotorBodyLink).AddWorldWrench(_ecm, force, torque);
+
+    // visual spin
+    double visualVel = 0.0;
+    if (_control.rotorVisualSlowdown > 0.0)
+    {
+        visualVel = w / _control.rotorVisualSlowdown;
+        _control.rotorAngle = std::fmod(
+            _control.rotorAngle + visualVel * _dt, 2.0 * GZ_PI);
+    }
+    _ecm.SetComponentData<gz::sim::components::JointPositionReset>(
+        _control.joint, {_control.rotorAngle});
+    _ecm.SetComponentData<gz::sim::components::JointVelocityReset>(
+        _control.joint, {visualVel});
+}
+
+/// \brief Drive a joint with a first-order motor model.
+///
+/// The joint responds to its target x* as dx/dt = (x* - x) / tau. The
+/// exact discrete-time solution over a step of length dt is
+///
+///   x[k+1] = x* + (x[k] - x*) exp(-dt / tau)
+///
+/// which is stable and free of overshoot for any step size. The next
+/// state is applied as a joint velocity command, for a POSITION control
+/// the velocity that moves the joint to x[k+1] within the step.
+void updateMotorModel(
+  Control &_control,
+  const double _dt,
+  gz::sim::EntityComponentManager &_ecm)
+{
+    if (_dt <= 0.0)
+    {
+        return;
+    }
+    const double decay = std::exp(-_dt / _control.timeConstant);
+
+    double velCmd = 0.0;
+    if (_control.type == "VELOCITY")
+    {
+        const double velTarget =
+            _control.cmd / _control.rotorVelocitySlowdownSim;
+
+        // advance from the measured joint velocity when available
+        auto vComp = _ecm.Component<gz::sim::components::JointVelocity>(
+            _control.joint);
+        if (vComp && !vComp->Data().empty())
+        {
+            _control.modelVel = vComp->Data()[0];
+        }
+        _control.modelVel = velTarget + (_control.modelVel - velTarget) * decay;
+        velCmd = _control.modelVel;
+    }
+    else
+    {
+        auto pComp = _ecm.Component<gz::sim::components::JointPosition>(
+            _control.joint);
+        if (pComp == nullptr)
+        {
+            // populated by physics from the next step
+            _ecm.CreateComponent(_control.joint,
+                gz::sim::components::JointPosition());
+            return;
+        }
+        if (pComp->Data().empty())
+        {
+            return;
+        }
+        const double pos = pComp->Data()[0];
+        const double posTarget = gz::math::clamp(
+            _control.cmd, _control.lowerLimit, _control.upperLimit);
+        velCmd = (posTarget - pos) * (1.0 - decay) / _dt;
+    }
+
+    _ecm.SetComponentData<gz::sim::components::JointVelocityCmd>(
+        _control.joint, {velCmd});
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::UpdateJointStateFilters(
+    const double _dt,
+    const gz::sim::EntityComponentManager &_ecm)
+{
+  auto &bank = this->dataPtr->filterBank;
+  bank.SetStepRate(1.0 / _dt);
+
+  for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
+  {
+    const Control &control = this->dataPtr->controls[i];
+    double state = 0.0;
+    if (control.type == "VELOCITY")
+    {
+      auto vComp = _ecm.Component<gz::sim::components::JointVelocity>(
+          control.joint);
+      if (vComp && !vComp->Data().empty())
+      {
+        state = vComp->Data()[0];
+      }
+
+      // a notch following the blade pass frequency of the target
+      if (control.filterType == JointStateFilterBank::Type::NOTCH &&
+          control.notchBlades > 0)
+      {
+        const double bladePass = control.notchBlades *
+            std::abs(control.cmd / control.rotorVelocitySlowdownSim) /
+            (2.0 * GZ_PI);
+        bank.SetFrequency(i, std::max(bladePass, control.frequencyCutoff));
+      }
+    }
+    else if (control.type == "POSITION")
+    {
+      auto pComp = _ecm.Component<gz::sim::components::JointPosition>(
+          control.joint);
+      if (pComp && !pComp->Data().empty())
+      {
+        state = pComp->Data()[0];
+      }
+    }
+    this->dataPtr->filterIn[i] = state;
+  }
+
+  bank.Process(this->dataPtr->filterIn.data(),
+      this->dataPtr->filterOut.data());
+}
+
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::ApplyMotorForces(
     const double _dt,
     gz::sim::EntityComponentManager &_ecm)
 {
+  // filter the joint state fed back to the PIDs, all controls in one pass
+  const bool filtered = this->dataPtr->filterBank.Enabled() && _dt > 0.0;
+  if (filtered)
+  {
+    this->UpdateJointStateFilters(_dt, _ecm);
+  }
+
   // update velocity PID for controls and apply force to joint
   for (size_t i = 0; i < this->dataPtr->controls.size(); ++i)
   {
@@ -1306,6 +2895,19 @@ void gz::sim::systems::ArduPilotPlugin::ApplyMotorForces(
       continue;
     }
 
+    if (this->dataPtr->controls[i].controller == "motor_model" &&
+        this->dataPtr->controls[i].type != "EFFORT")
+    {
+      updateMotorModel(this->dataPtr->controls[i], _dt, _ecm);
+      continue;
+    }
+
+    if (this->dataPtr->controls[i].controller == "rotor")
+    {
+      updateRotor(this->dataPtr->controls[i], _dt, _ecm);
+      continue;
+    }
+
     gz::sim::components::JointForceCmd* jfcComp = nullptr;
     gz::sim::components::JointVelocityCmd* jvcComp = nullptr;
     if (this->dataPtr->controls[i].useForce ||
@@ -1341,7 +2943,8 @@ void gz::sim::systems::ArduPilotPlugin::ApplyMotorForces(
               this->dataPtr->controls[i].joint);
         if (vComp && !vComp->Data().empty())
         {
-            const double vel = vComp->Data()[0];
+            const double vel = filtered ?
+                this->dataPtr->filterOut[i] : vComp->Data()[0];
             const double error = vel - velTarget;
             const double force = this->dataPtr->controls[i].pid.Update(
                 error, std::chrono::duration<double>(_dt));
@@ -1356,7 +2959,8 @@ void gz::sim::systems::ArduPilotPlugin::ApplyMotorForces(
               this->dataPtr->controls[i].joint);
         if (pComp && !pComp->Data().empty())
         {
-            const double pos = pComp->Data()[0];
+            const double pos = filtered ?
+                this->dataPtr->filterOut[i] : pComp->Data()[0];
             const double error = pos - posTarget;
             const double force = this->dataPtr->controls[i].pid.Update(
                 error, std::chrono::duration<double>(_dt));
@@ -1381,10 +2985,7 @@ void gz::sim::systems::ArduPilotPlugin::ApplyMotorForces(
       }
       else if (this->dataPtr->controls[i].type == "POSITION")
       {
-        /// \todo(anyone) figure out whether position control matters,
-        /// and if so, how to use it.
-        gzwarn << "Failed to do position control on joint " << i <<
-            " because there's no JointPositionCmd component (yet?)" << "/n";
+        updateKinematicPosition(this->dataPtr->controls[i], _dt, _ecm);
       }
       else if (this->dataPtr->controls[i].type == "EFFORT")
       {
@@ -1402,33 +3003,46 @@ void gz::sim::systems::ArduPilotPlugin::ApplyMotorForces(
 /////////////////////////////////////////////////
 namespace
 {
-/// \brief Get a servo packet. Templated for 16 or 32 channel packets.
-template<typename TServoPacket>
+/// \brief A view of the most recent frame in a servo packet.
+struct ServoFrame
+{
+  uint16_t magic{0};
+  uint16_t frameRate{0};
+  uint32_t frameCount{0};
+  uint8_t flags{SERVO_EXT_FLAG_NONE};
+  uint16_t channels{0};
+  const uint16_t *pwm{nullptr};
+};
+
+/// \brief Receive the latest servo packet into a max-size buffer.
+///
+/// Any packets queued behind the first are drained into the same buffer
+/// so the most recent one is kept.
 ssize_t getServoPacket(
   SocketUDP &_sock,
   const char *&_fcu_address,
   uint16_t &_fcu_port_out,
   uint32_t _waitMs,
   const std::string &_modelName,
-  TServoPacket &_pkt
+  uint8_t *_buffer,
+  size_t _size
 )
 {
-    ssize_t recvSize = _sock.recv(&_pkt, sizeof(TServoPacket), _waitMs);
+    ssize_t recvSize = _sock.recv(_buffer, _size, _waitMs);
 
     _sock.get_client_address(_fcu_address, _fcu_port_out);
 
-    // drain the socket in the case we're backed up
+    // drain the socket in the case we're backed up, recv leaves the
+    // buffer untouched when there is nothing to read
     int counter = 0;
     while (true)
     {
-        TServoPacket last_pkt;
-        auto recvSize_last = _sock.recv(&last_pkt, sizeof(TServoPacket), 0ul);
+        auto recvSize_last = _sock.recv(_buffer, _size, 0ul);
         if (recvSize_last == -1)
         {
             break;
         }
         counter++;
-        _pkt = last_pkt;
         recvSize = recvSize_last;
     }
     if (counter > 0)
@@ -1438,22 +3052,84 @@ ssize_t getServoPacket(
     }
     return recvSize;
 }
+
+/// \brief Detect the servo packet format from its magic and size.
+///
+/// On success _frame views the PWM values of the most recent frame in
+/// the buffer, which must be aligned for uint16_t.
+bool parseServoPacket(
+  const uint8_t *_buffer,
+  size_t _size,
+  ServoFrame &_frame
+)
+{
+    if (_size < sizeof(uint16_t))
+    {
+        return false;
+    }
+    std::memcpy(&_frame.magic, _buffer, sizeof(_frame.magic));
+
+    if (_frame.magic == kServoMagic16 && _size >= sizeof(servo_packet_16))
+    {
+        auto pkt = reinterpret_cast<const servo_packet_16 *>(_buffer);
+        _frame.frameRate = pkt->frame_rate;
+        _frame.frameCount = pkt->frame_count;
+        _frame.channels = 16;
+        _frame.pwm = pkt->pwm;
+        return true;
+    }
+
+    if (_frame.magic == kServoMagic32 && _size >= sizeof(servo_packet_32))
+    {
+        auto pkt = reinterpret_cast<const servo_packet_32 *>(_buffer);
+        _frame.frameRate = pkt->frame_rate;
+        _frame.frameCount = pkt->frame_count;
+        _frame.channels = 32;
+        _frame.pwm = pkt->pwm;
+        return true;
+    }
+
+    if (_frame.magic == kServoMagicExt &&
+        _size >= sizeof(servo_packet_ext_header))
+    {
+        auto hdr = reinterpret_cast<const servo_packet_ext_header *>(_buffer);
+        const size_t frameSize = hdr->channels * sizeof(uint16_t);
+        if (hdr->version != kServoExtVersion ||
+            hdr->channels == 0 || hdr->channels > kMaxServoChannels ||
+            hdr->frames == 0 ||
+            _size < sizeof(servo_packet_ext_header) + hdr->frames * frameSize)
+        {
+            return false;
+        }
+        const uint8_t *last = _buffer + sizeof(servo_packet_ext_header) +
+            (hdr->frames - 1) * frameSize;
+        _frame.frameRate = hdr->frame_rate;
+        _frame.frameCount = hdr->frame_count + hdr->frames - 1;
+        _frame.flags = hdr->flags;
+        _frame.channels = hdr->channels;
+        _frame.pwm = reinterpret_cast<const uint16_t *>(last);
+        return true;
+    }
+
+    return false;
+}
 }  // namespace
 
 /////////////////////////////////////////////////
 bool gz::sim::systems::ArduPilotPlugin::ReceiveServoPacket()
 {
     // Added detection for whether ArduPilot is online or not.
-    // If ArduPilot is detected (receive of fdm packet from someone),
-    // then socket receive wait time is increased from 1ms to 1 sec
-    // to accomodate network jitter.
-    // If ArduPilot is not detected, receive call blocks for 1ms
-    // on each call.
-    // Once ArduPilot presence is detected, it takes this many
-    // missed receives before declaring the FCS offline.
+    // While the health monitor reports ArduPilot online the socket
+    // receive wait time is increased from 1ms to 10ms to accomodate
+    // network jitter. Otherwise the receive call blocks for 1ms on each
+    // call, so a late or lost controller does not hold up the update.
+    // The monitor declares the FCS lost against a wall time deadline.
 
     uint32_t waitMs;
-    if (this->dataPtr->arduPilotOnline)
+    const ConnectionHealthMonitor::State health =
+        this->dataPtr->HealthState();
+    if (this->dataPtr->arduPilotOnline &&
+        health == ConnectionHealthMonitor::State::ONLINE)
     {
         // Increase timeout for recv once we detect a packet from ArduPilot FCS.
         // If this value is too high then it will block the main Gazebo
@@ -1466,102 +3142,107 @@ bool gz::sim::systems::ArduPilotPlugin::ReceiveServoPacket()
         waitMs = 1;
     }
 
-    // 16 / 32 channel compatibility
-    uint16_t pkt_magic{0};
-    uint16_t pkt_frame_rate{0};
-    uint16_t pkt_frame_count{0};
-    std::array<uint16_t, 32> pkt_pwm;
-    ssize_t recvSize{-1};
-    if (this->dataPtr->have32Channels)
-    {
-      servo_packet_32 pkt;
-      recvSize = getServoPacket(
-          this->dataPtr->sock,
-          this->dataPtr->fcu_address,
-          this->dataPtr->fcu_port_out,
-          waitMs,
-          this->dataPtr->modelName,
-          pkt);
-      pkt_magic = pkt.magic;
-      pkt_frame_rate = pkt.frame_rate;
-      pkt_frame_count = pkt.frame_count;
-      std::copy(std::begin(pkt.pwm), std::end(pkt.pwm), std::begin(pkt_pwm));
-    }
-    else
-    {
-      servo_packet_16 pkt;
-      recvSize = getServoPacket(
-          this->dataPtr->sock,
-          this->dataPtr->fcu_address,
-          this->dataPtr->fcu_port_out,
-          waitMs,
-          this->dataPtr->modelName,
-          pkt);
-      pkt_magic = pkt.magic;
-      pkt_frame_rate = pkt.frame_rate;
-      pkt_frame_count = pkt.frame_count;
-      std::copy(std::begin(pkt.pwm), std::end(pkt.pwm), std::begin(pkt_pwm));
-    }
-
-    // didn't receive a packet, increment timeout count if online, then return
+    // 16 / 32 channel and extended packets share one max-size buffer
+    ssize_t recvSize = getServoPacket(
+        this->dataPtr->sock,
+        this->dataPtr->fcu_address,
+        this->dataPtr->fcu_port_out,
+        waitMs,
+        this->dataPtr->modelName,
+        this->dataPtr->servoBuffer,
+        sizeof(this->dataPtr->servoBuffer));
+
+    // didn't receive a packet, act on a lost connection if online, then
+    // return
     if (recvSize == -1)
     {
-        if (this->dataPtr->arduPilotOnline)
+        if (this->dataPtr->arduPilotOnline &&
+            health == ConnectionHealthMonitor::State::LOST)
         {
-            if (++this->dataPtr->connectionTimeoutCount >
-            this->dataPtr->connectionTimeoutMaxCount)
+            // for lock-step resend last state rather than time out, at
+            // most once per lost timeout
+            if (this->dataPtr->isLockStep)
             {
-                this->dataPtr->connectionTimeoutCount = 0;
-
-                // for lock-step resend last state rather than time out
-                if (this->dataPtr->isLockStep)
+                const double sinceSend = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() -
+                    this->dataPtr->stateSendTime).count();
+                if (sinceSend >
+                    this->dataPtr->health->Parameters().lostTimeout)
                 {
                     this->SendState();
                 }
-                else
-                {
-                    this->dataPtr->arduPilotOnline = false;
-                    gzwarn << "[" << this->dataPtr->modelName << "] "
-                        << "Broken ArduPilot connection,"
-                        << " resetting motor control.\n";
-                    this->ResetPIDs();
-                }
+            }
+            else
+            {
+                this->dataPtr->arduPilotOnline = false;
+                gzwarn << "[" << this->dataPtr->modelName << "] "
+                    << "Broken ArduPilot connection,"
+                    << " resetting motor control.\n";
+                this->ResetPIDs();
             }
         }
         return false;
     }
 
-#if DEBUG_JSON_IO
-    int max_servo_channels = this->dataPtr->have32Channels ? 32 : 16;
+    // detect the packet format, return if not recognised
+    ServoFrame frame;
+    if (!parseServoPacket(this->dataPtr->servoBuffer,
+        static_cast<size_t>(recvSize), frame))
+    {
+        gzwarn << "[" << this->dataPtr->modelName << "] "
+            << "Unrecognised servo packet: magic " << frame.magic
+            << ", size " << recvSize << " bytes. Expected magic "
+            << kServoMagic16 << " (16 channels), "
+            << kServoMagic32 << " (32 channels) or "
+            << kServoMagicExt << " (extended)\n";
+        return false;
+    }
+
+    // extended packets advertise whether the binary state is accepted
+    const bool peerBinaryState =
+        (frame.flags & SERVO_EXT_FLAG_BINARY_STATE) != 0;
+    if (peerBinaryState != this->dataPtr->peerBinaryState &&
+        this->dataPtr->stateFormat == "auto")
+    {
+        gzmsg << "[" << this->dataPtr->modelName << "] "
+            << "sending " << (peerBinaryState ? "binary" : "JSON")
+            << " state\n";
+    }
+    this->dataPtr->peerBinaryState = peerBinaryState;
+
+    // the SDF channel count is only a hint, report a mismatch once
+    if (frame.channels != this->dataPtr->servoChannels)
+    {
+        const uint16_t hint = this->dataPtr->have32Channels ? 32 : 16;
+        if (frame.channels != hint && !this->dataPtr->servoHintWarned)
+        {
+            gzwarn << "[" << this->dataPtr->modelName << "] "
+                << "<have_32_channels> is "
+                << (this->dataPtr->have32Channels ? "true" : "false")
+                << " but ArduPilot sends " << frame.channels
+                << " channels, using the received packet format\n";
+            this->dataPtr->servoHintWarned = true;
+        }
+        this->dataPtr->servoChannels = frame.channels;
+    }
 
+#if DEBUG_JSON_IO
     // debug: inspect sitl packet
     std::ostringstream oss;
     oss << "recv " << recvSize << " bytes from "
         << this->dataPtr->fcu_address << ":"
         << this->dataPtr->fcu_port_out << "\n";
-    // oss << "magic: " << pkt_magic << "\n";
-    // oss << "frame_rate: " << pkt_frame_rate << "\n";
-    oss << "frame_count: " << pkt_frame_count << "\n";
+    // oss << "magic: " << frame.magic << "\n";
+    // oss << "frame_rate: " << frame.frameRate << "\n";
+    oss << "frame_count: " << frame.frameCount << "\n";
     // oss << "pwm: [";
-    // for (auto i=0; i<max_servo_channels - 1; ++i) {
-    //     oss << pkt_pwm[i] << ", ";
+    // for (auto i=0; i<frame.channels - 1; ++i) {
+    //     oss << frame.pwm[i] << ", ";
     // }
-    // oss << pkt_pwm[max_servo_channels - 1] << "]\n";
+    // oss << frame.pwm[frame.channels - 1] << "]\n";
     gzdbg << "\n" << oss.str();
 #endif
 
-    // check magic, return if invalid
-    constexpr uint16_t magic_16 = 18458;
-    constexpr uint16_t magic_32 = 29569;
-    uint16_t magic = this->dataPtr->have32Channels ? magic_32 : magic_16;
-    if (magic != pkt_magic)
-    {
-        gzwarn << "Incorrect protocol magic "
-            << pkt_magic << " should be "
-            << magic << "\n";
-        return false;
-    }
-
     // the controller is online
     if (!this->dataPtr->arduPilotOnline)
     {
@@ -1574,17 +3255,17 @@ bool gz::sim::systems::ArduPilotPlugin::ReceiveServoPacket()
     }
 
     // update frame rate
-    this->dataPtr->fcu_frame_rate = pkt_frame_rate;
+    this->dataPtr->fcu_frame_rate = frame.frameRate;
 
     // check for controller reset
-    if (pkt_frame_count < this->dataPtr->fcu_frame_count)
+    if (frame.frameCount < this->dataPtr->fcu_frame_count)
     {
         /// \todo(anyone) implement re-initialisation
         gzwarn << "ArduPilot controller has reset\n";
     }
 
     // check for duplicate frame
-    else if (pkt_frame_count == this->dataPtr->fcu_frame_count)
+    else if (frame.frameCount == this->dataPtr->fcu_frame_count)
     {
         gzwarn << "Duplicate input frame\n";
 
@@ -1598,30 +3279,42 @@ bool gz::sim::systems::ArduPilotPlugin::ReceiveServoPacket()
     }
 
     // check for skipped frames
-    else if (pkt_frame_count != this->dataPtr->fcu_frame_count + 1
+    else if (frame.frameCount != this->dataPtr->fcu_frame_count + 1
         && this->dataPtr->arduPilotOnline)
     {
         gzwarn << "Missed "
-            << pkt_frame_count - this->dataPtr->fcu_frame_count
+            << frame.frameCount - this->dataPtr->fcu_frame_count
             << " input frames\n";
     }
 
     // update frame count
-    this->dataPtr->fcu_frame_count = pkt_frame_count;
+    this->dataPtr->fcu_frame_count = frame.frameCount;
+
+    // report the frame to the health monitor
+    this->dataPtr->health->OnFrame(
+        std::chrono::duration<double>(
+            this->dataPtr->lastControllerUpdateTime).count(),
+        frame.frameRate);
+    if (this->dataPtr->rtfMatcher)
+    {
+        this->dataPtr->rtfMatcher->AddFrame(frame.frameRate);
+    }
 
-    // reset the connection timeout so we don't accumulate
-    this->dataPtr->connectionTimeoutCount = 0;
+    if (this->dataPtr->sock.impaired() || this->dataPtr->sock.low_latency())
+    {
+        this->ReportLinkLatency();
+    }
 
-    this->UpdateMotorCommands(pkt_pwm);
+    this->UpdateMotorCommands(frame.pwm, frame.channels);
 
     return true;
 }
 
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::UpdateMotorCommands(
-    const std::array<uint16_t, 32> &_pwm)
+    const uint16_t *_pwm, size_t _channels)
 {
-    int max_servo_channels = this->dataPtr->have32Channels ? 32 : 16;
+    const int max_servo_channels = static_cast<int>(_channels);
 
     // compute command based on requested motorSpeed
     for (unsigned i = 0; i < this->dataPtr->controls.size(); ++i)
@@ -1629,21 +3322,18 @@ void gz::sim::systems::ArduPilotPlugin::UpdateMotorCommands(
         // enforce limit on the number of <control> elements
         if (i < MAX_MOTORS)
         {
-            if (this->dataPtr->controls[i].channel < max_servo_channels)
+            if (this->dataPtr->controls[i].mixed)
             {
-                // convert pwm to raw cmd: [servo_min, servo_max] => [0, 1],
-                // default is: [1000, 2000] => [0, 1]
-                const double pwm = _pwm[this->dataPtr->controls[i].channel];
-                const double pwm_min = this->dataPtr->controls[i].servo_min;
-                const double pwm_max = this->dataPtr->controls[i].servo_max;
-                const double multiplier = this->dataPtr->controls[i].multiplier;
-                const double offset = this->dataPtr->controls[i].offset;
-
-                // bound incoming cmd between 0 and 1
-                double raw_cmd = (pwm - pwm_min)/(pwm_max - pwm_min);
-                raw_cmd = gz::math::clamp(raw_cmd, 0.0, 1.0);
+                // commanded by the mixer below
+                continue;
+            }
+            else if (this->dataPtr->controls[i].channel < max_servo_channels)
+            {
+                // gather the command from the table compiled at load,
+                // default is: [1000, 2000] => multiplier * ([0, 1] + offset)
+                const uint16_t pwm = _pwm[this->dataPtr->controls[i].channel];
                 this->dataPtr->controls[i].cmd =
-                    multiplier * (raw_cmd + offset);
+                    this->dataPtr->controls[i].Command(pwm);
 
 #if 0
                 gzdbg << "apply input chan["
@@ -1652,7 +3342,6 @@ void gz::sim::systems::ArduPilotPlugin::UpdateMotorCommands(
                     << "] with joint name ["
                     << this->dataPtr->controls[i].jointName
                     << "] pwm [" << pwm
-                    << "] raw cmd [" << raw_cmd
                     << "] adjusted cmd [" << this->dataPtr->controls[i].cmd
                     << "].\n";
 #endif
@@ -1674,10 +3363,87 @@ void gz::sim::systems::ArduPilotPlugin::UpdateMotorCommands(
                 << " > " << MAX_MOTORS << "].\n";
         }
     }
+
+    // mixed controls, in one matrix-vector product of the normalised
+    // channels. Missing channels are neutral.
+    if (!this->dataPtr->mixer.Empty())
+    {
+        auto &in = this->dataPtr->mixerIn;
+        for (size_t k = 0; k < in.size(); ++k)
+        {
+            const int channel = this->dataPtr->mixerChannels[k];
+            const double range =
+                this->dataPtr->mixerServoMax[k] -
+                this->dataPtr->mixerServoMin[k];
+            in[k] = channel < max_servo_channels && range != 0.0 ?
+                gz::math::clamp(2.0 * (_pwm[channel] -
+                    this->dataPtr->mixerServoMin[k]) / range - 1.0,
+                    -1.0, 1.0) : 0.0;
+        }
+
+        auto &out = this->dataPtr->mixerOut;
+        this->dataPtr->mixer.Mix(in.data(), out.data());
+        for (size_t r = 0; r < out.size(); ++r)
+        {
+            Control &control =
+                this->dataPtr->controls[this->dataPtr->mixerControls[r]];
+            control.cmd = control.multiplier * (out[r] + control.offset);
+        }
+    }
 }
 
 /////////////////////////////////////////////////
-void gz::sim::systems::ArduPilotPlugin::CreateStateJSON(
+namespace
+{
+/// \brief Vehicle and wind state in Gazebo frames.
+struct StateInput
+{
+  gz::math::Pose3d wldGToBdyG;
+  gz::math::Vector3d velWldG;
+  gz::math::Pose3d wldGToSnsG;
+  gz::math::Vector3d windVelSnsG;
+};
+
+/// \brief Vehicle and wind state in ArduPilot frames.
+struct StateOutput
+{
+  gz::math::Pose3d wldAToBdyA;
+  gz::math::Vector3d velWldA;
+  double windSpd{0.0};
+  double windDir{0.0};
+};
+
+/// \brief Transform the state from Gazebo to ArduPilot frames.
+///
+/// The kernel has no branches: without an anemometer the wind inputs are
+/// zero and the wind outputs are ignored by the caller.
+void computeState(
+  const gz::math::Pose3d &_wldAToWldG,
+  const gz::math::Pose3d &_bdyGToBdyA,
+  const StateInput &_in,
+  StateOutput &_out)
+{
+    _out.wldAToBdyA = _wldAToWldG * _in.wldGToBdyG * _bdyGToBdyA;
+    _out.velWldA = _wldAToWldG.Rot() * _in.velWldG + _wldAToWldG.Pos();
+
+    // rotate the apparent wind from the sensor to AP body (FRD) frame
+    const gz::math::Pose3d bdyAToSnsG =
+        _out.wldAToBdyA.Inverse() * _wldAToWldG * _in.wldGToSnsG;
+    const gz::math::Vector3d windVelBdyA =
+        bdyAToSnsG.Rot().RotateVector(_in.windVelSnsG);
+
+    // speed and direction - consider only xy-components and switch sign
+    // of direction (Gazebo specifies where wind is going to,
+    // AruPilot expects where wind is from).
+    const double windX = 0.0 - windVelBdyA.X();
+    const double windY = 0.0 - windVelBdyA.Y();
+    _out.windSpd = std::sqrt(windX * windX + windY * windY);
+    _out.windDir = std::atan2(windY, windX);
+}
+}  // namespace
+
+/////////////////////////////////////////////////
+void gz::sim::systems::ArduPilotPlugin::CreateState(
     double _simTime,
     const gz::sim::EntityComponentManager &_ecm) const
 {
@@ -1792,91 +3558,153 @@ void gz::sim::systems::ArduPilotPlugin::CreateStateJSON(
       In C++ variables names this is:
 
         wldAToBdyA = wldAToWldG * wldGToBdyG * bdyAToBdyG.Inverse()
+
+      where the constant transforms wldAToWldG and bdyGToBdyA are
+      precomputed in Configure and the composition is done in
+      computeState().
     */
 
-    // get pose and velocity in Gazebo world frame
-    const gz::sim::components::WorldPose* worldPose =
-        _ecm.Component<gz::sim::components::WorldPose>(
-            this->dataPtr->imuLink);
-
-    const gz::sim::components::WorldLinearVelocity* worldLinearVel =
-        _ecm.Component<gz::sim::components::WorldLinearVelocity>(
-            this->dataPtr->imuLink);
-
-    // position and orientation transform (Aircraft world to Aircraft body)
-    gz::math::Pose3d bdyAToBdyG =
-        this->dataPtr->modelXYZToAirplaneXForwardZDown.Inverse();
-
-    /// \todo(srmainwaring) check for error.
-    /// The inverse may be incorrect. The error is not evident when using
-    /// the transform from the original plugin:
-    ///   <gazeboXYZToNED>0 0 0 GZ_PI 0 0</gazeboXYZToNED>
-    /// but is when using the correct transform which is
-    ///   <gazeboXYZToNED>0 0 0 GZ_PI 0 GZ_PI/2</gazeboXYZToNED>
-    ///
-    gz::math::Pose3d wldAToWldG = this->dataPtr->gazeboXYZToNED.Inverse();
-    // gz::math::Pose3d wldAToWldG = this->dataPtr->gazeboXYZToNED;
-
-    gz::math::Pose3d wldGToBdyG = worldPose->Data();
-    gz::math::Pose3d wldAToBdyA =
-        wldAToWldG * wldGToBdyG * bdyAToBdyG.Inverse();
-
-    // velocity transformation
-    gz::math::Vector3d velWldG = worldLinearVel->Data();
-    gz::math::Vector3d velWldA = wldAToWldG.Rot() * velWldG + wldAToWldG.Pos();
+    StateInput in;
 
-    // require the duration since sim start in seconds
-    double timestamp = _simTime;
+    // get pose and velocity in Gazebo world frame
+    in.wldGToBdyG = _ecm.Component<gz::sim::components::WorldPose>(
+        this->dataPtr->imuLink)->Data();
+    in.velWldG = _ecm.Component<gz::sim::components::WorldLinearVelocity>(
+        this->dataPtr->imuLink)->Data();
 
     // Anemometer
     // AP_WindVane_SITL use apparent wind speed and dir in body frame.
     // WNDVN_SPEED_TYPE 11
     // WNDVN_TYPE       11
-    double windSpdBdyA{0.0};
-    double windDirBdyA{0.0};
-
     if (this->dataPtr->anemometerInitialized)
     {
-        std::lock_guard<std::mutex> lock(this->dataPtr->anemometerMsgMutex);
-
-        // Anemometer sensors reports apparent wind velocity in sensor frame.
-        auto windVelSnsG = gz::msgs::Convert(this->dataPtr->anemometerMsg);
+        // sensor pose relative to the world frame, updated by physics
+        // since the component is enabled when the sensor is found
+        in.wldGToSnsG = _ecm.Component<gz::sim::components::WorldPose>(
+            this->dataPtr->anemometerEntity)->Data();
+
+        // With a WindFieldPlugin the apparent wind is computed from the
+        // local wind, otherwise the anemometer sensor reports apparent
+        // wind velocity in sensor frame.
+        const auto *windField =
+            _ecm.Component<gz::sim::components::WindFieldVelocity>(
+                this->dataPtr->world.Entity());
+        const auto *localWind =
+            _ecm.Component<gz::sim::components::WindFieldVelocity>(
+                this->dataPtr->anemometerEntity);
+        if (windField != nullptr && localWind != nullptr)
+        {
+            const auto *sensorVel =
+                _ecm.Component<gz::sim::components::WorldLinearVelocity>(
+                    this->dataPtr->anemometerEntity);
+            gz::math::Vector3d apparentWldG = localWind->Data();
+            if (sensorVel != nullptr)
+            {
+                apparentWldG -= sensorVel->Data();
+            }
+            in.windVelSnsG =
+                in.wldGToSnsG.Rot().RotateVectorReverse(apparentWldG);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(
+                this->dataPtr->anemometerMsgMutex);
+            in.windVelSnsG = gz::msgs::Convert(this->dataPtr->anemometerMsg);
+        }
+    }
 
-        // sensor pose relative to the world frame
-        auto wldGToSnsG = gz::sim::worldPose(
-            this->dataPtr->anemometerEntity, _ecm);
+    StateOutput out;
+    computeState(this->dataPtr->wldAToWldG, this->dataPtr->bdyGToBdyA,
+        in, out);
 
-        auto bdyAToWldA = wldAToBdyA.Inverse();
-        auto bdyAToSnsG = bdyAToWldA * wldAToWldG * wldGToSnsG;
+    const gz::math::Pose3d &wldAToBdyA = out.wldAToBdyA;
+    const gz::math::Vector3d &velWldA = out.velWldA;
+    const double windSpdBdyA = out.windSpd;
+    const double windDirBdyA = out.windDir;
 
-        // rotate to AP body (FRD) frame
-        auto windVelBdyA = bdyAToSnsG.Rot().RotateVector(windVelSnsG);
+    // require the duration since sim start in seconds
+    double timestamp = _simTime;
 
-        // speed and direction - consider only xy-components and switch sign
-        // of direction (Gazebo specifies where wind is going to,
-        // AruPilot expects where wind is from).
-        double windXBdyA = windVelBdyA.X() * -1.0;
-        double windYBdyA = windVelBdyA.Y() * -1.0;
-        windSpdBdyA = std::sqrt(windXBdyA * windXBdyA + windYBdyA * windYBdyA);
-        windDirBdyA = atan2(windYBdyA, windXBdyA);
+    // ranges cast by the RangefinderPlugin, no return is reported
+    // beyond the maximum range as for the LaserScan sensors
+    if (!this->dataPtr->raycastRanges.empty())
+    {
+        std::lock_guard<std::mutex> lock(this->dataPtr->rangeMsgMutex);
+        for (const auto &raycast : this->dataPtr->raycastRanges)
+        {
+            const auto *comp =
+                _ecm.Component<gz::sim::components::RaycastRangefinder>(
+                    raycast.entity);
+            if (comp != nullptr &&
+                raycast.index < this->dataPtr->ranges.size())
+            {
+                const double range = comp->Data().range;
+                this->dataPtr->ranges[raycast.index] =
+                    std::isinf(range) ? 2.0 * raycast.maxRange : range;
+            }
+        }
+    }
 
-        double windXSnsG = windVelSnsG.X();
-        double windYSnsG = windVelSnsG.Y();
-        auto windSpdSnsG = std::sqrt(
-            windXSnsG * windXSnsG + windYSnsG * windYSnsG);
-        auto windDirSnsG = atan2(windYSnsG, windXSnsG);
+    // synthetic optical flow
+    if (this->dataPtr->opticalFlow.enabled)
+    {
+        this->dataPtr->UpdateOpticalFlow(_simTime, _ecm, wldAToBdyA,
+            velWldA, angularVel);
+    }
 
-        // gzdbg << "\nEuler angles:\n"
-        //       << "bdyAToBdyG:  " << bdyAToBdyG.Rot().Euler() << "\n"
-        //       << "Wind velocity:\n"
-        //       << "windVelSnsG: " << windVelSnsG << "\n"
-        //       << "windVelBdyA: " << windVelBdyA << "\n"
-        //       << "Wind speed and direction:\n"
-        //       << "windSpdSnsG: " << windSpdSnsG << "\n"
-        //       << "windDirSnsG: " << windDirSnsG * 180 / GZ_PI <<  "\n"
-        //       << "windSpdBdyA: " << windSpdBdyA << "\n"
-        //       << "windDirBdyA: " << windDirBdyA * 180 / GZ_PI <<  "\n"
-        //       << "\n";
+    // binary state when requested or negotiated with the controller
+    this->dataPtr->stateIsBinary =
+        this->dataPtr->stateFormat == "binary" ||
+        (this->dataPtr->stateFormat == "auto" &&
+         this->dataPtr->peerBinaryState);
+    if (this->dataPtr->stateIsBinary)
+    {
+        this->dataPtr->stateBinary = fdm_state_binary_frame{};
+        fdm_state_binary_v1 &state = this->dataPtr->stateBinary.state;
+        state.magic = kStateBinaryMagic;
+        state.version = kStateBinaryVersion;
+        state.length = sizeof(fdm_state_binary_v1);
+        state.frame_count = this->dataPtr->fcu_frame_count;
+        state.timestamp = timestamp;
+        state.gyro[0] = angularVel.X();
+        state.gyro[1] = angularVel.Y();
+        state.gyro[2] = angularVel.Z();
+        state.accel_body[0] = linearAccel.X();
+        state.accel_body[1] = linearAccel.Y();
+        state.accel_body[2] = linearAccel.Z();
+        state.position[0] = wldAToBdyA.Pos().X();
+        state.position[1] = wldAToBdyA.Pos().Y();
+        state.position[2] = wldAToBdyA.Pos().Z();
+        state.quaternion[0] = wldAToBdyA.Rot().W();
+        state.quaternion[1] = wldAToBdyA.Rot().X();
+        state.quaternion[2] = wldAToBdyA.Rot().Y();
+        state.quaternion[3] = wldAToBdyA.Rot().Z();
+        state.velocity[0] = velWldA.X();
+        state.velocity[1] = velWldA.Y();
+        state.velocity[2] = velWldA.Z();
+        {
+            std::lock_guard<std::mutex> lock(this->dataPtr->rangeMsgMutex);
+            state.range_count = static_cast<uint8_t>(
+                std::min<size_t>(6, this->dataPtr->ranges.size()));
+            for (uint8_t i = 0; i < state.range_count; ++i)
+            {
+                state.rng[i] = this->dataPtr->ranges[i];
+            }
+        }
+        if (this->dataPtr->anemometerInitialized)
+        {
+            state.flags |= STATE_FLAG_WINDVANE;
+            state.wind_direction = windDirBdyA;
+            state.wind_speed = windSpdBdyA;
+        }
+        if (this->dataPtr->opticalFlow.enabled)
+        {
+            state.flags |= STATE_FLAG_OPTICAL_FLOW;
+            state.length = sizeof(fdm_state_binary_frame);
+            this->dataPtr->stateBinary.flow =
+                this->dataPtr->opticalFlow.sample;
+        }
+        return;
     }
 
     // build JSON document
@@ -1972,6 +3800,29 @@ void gz::sim::systems::ArduPilotPlugin::CreateStateJSON(
       writer.EndObject();
     }
 
+    // Optical flow sensor
+    if (this->dataPtr->opticalFlow.enabled)
+    {
+      const fdm_state_flow_v1 &flow = this->dataPtr->opticalFlow.sample;
+      writer.Key("optical_flow");
+      writer.StartObject();
+      writer.Key("flow_rate");
+      writer.StartArray();
+      writer.Double(flow.flow_rate[0]);
+      writer.Double(flow.flow_rate[1]);
+      writer.EndArray();
+      writer.Key("body_rate");
+      writer.StartArray();
+      writer.Double(flow.body_rate[0]);
+      writer.Double(flow.body_rate[1]);
+      writer.EndArray();
+      writer.Key("distance");
+      writer.Double(flow.distance);
+      writer.Key("quality");
+      writer.Uint(flow.quality);
+      writer.EndObject();
+    }
+
     writer.EndObject();
 
     // get JSON
@@ -1982,6 +3833,18 @@ void gz::sim::systems::ArduPilotPlugin::CreateStateJSON(
 /////////////////////////////////////////////////
 void gz::sim::systems::ArduPilotPlugin::SendState() const
 {
+    this->dataPtr->stateSendTime = std::chrono::steady_clock::now();
+
+    if (this->dataPtr->stateIsBinary)
+    {
+        this->dataPtr->sock.sendto(
+            &this->dataPtr->stateBinary,
+            this->dataPtr->stateBinary.state.length,
+            this->dataPtr->fcu_address,
+            this->dataPtr->fcu_port_out);
+        return;
+    }
+
 #if DEBUG_JSON_IO
     auto bytes_sent =
 #endif
@@ -0,0 +1,323 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CollisionScene.hh"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gz/common/Console.hh>
+#include <gz/common/Mesh.hh>
+#include <gz/common/MeshManager.hh>
+#include <gz/common/SubMesh.hh>
+#include <gz/math/Quaternion.hh>
+#include <gz/math/Vector3.hh>
+#include <gz/sim/components/Collision.hh>
+#include <gz/sim/components/Geometry.hh>
+#include <gz/sim/components/ParentEntity.hh>
+#include <gz/sim/components/Pose.hh>
+#include <gz/sim/components/Static.hh>
+#include <gz/sim/Util.hh>
+
+#include <sdf/Box.hh>
+#include <sdf/Capsule.hh>
+#include <sdf/Cylinder.hh>
+#include <sdf/Ellipsoid.hh>
+#include <sdf/Mesh.hh>
+#include <sdf/Plane.hh>
+#include <sdf/Sphere.hh>
+
+//////////////////////////////////////////////////
+void CollisionScene::Update(gz::sim::EntityComponentManager &_ecm)
+{
+  auto add = [&](const gz::sim::Entity &_entity,
+                 const gz::sim::components::Collision *,
+                 const gz::sim::components::Geometry *_geometry,
+                 const gz::sim::components::Pose *_pose,
+                 const gz::sim::components::ParentEntity *_parent) -> bool
+  {
+    if (this->objects.find(_entity) == this->objects.end())
+    {
+      this->AddCollision(_ecm, _entity, _geometry->Data(), _pose->Data(),
+          _parent->Data());
+    }
+    return true;
+  };
+
+  // all collisions on the first update, then the new ones
+  if (!this->initialized)
+  {
+    _ecm.Each<gz::sim::components::Collision,
+              gz::sim::components::Geometry,
+              gz::sim::components::Pose,
+              gz::sim::components::ParentEntity>(add);
+    this->initialized = true;
+  }
+  else
+  {
+    _ecm.EachNew<gz::sim::components::Collision,
+                 gz::sim::components::Geometry,
+                 gz::sim::components::Pose,
+                 gz::sim::components::ParentEntity>(add);
+  }
+
+  _ecm.EachRemoved<gz::sim::components::Collision>(
+      [&](const gz::sim::Entity &_entity,
+          const gz::sim::components::Collision *) -> bool
+      {
+        auto it = this->objects.find(_entity);
+        if (it != this->objects.end())
+        {
+          const uint32_t object = it->second;
+          this->scene.RemoveObject(object);
+          this->dynamics.erase(std::remove_if(
+              this->dynamics.begin(), this->dynamics.end(),
+              [&](const Dynamic &_d) { return _d.object == object; }),
+              this->dynamics.end());
+          this->objects.erase(it);
+        }
+        return true;
+      });
+
+  // link poses are updated by physics from the next step
+  for (const gz::sim::Entity link : this->newLinks)
+  {
+    gz::sim::enableComponent<gz::sim::components::WorldPose>(
+        _ecm, link, true);
+  }
+  this->newLinks.clear();
+
+  // follow the links of moving models
+  for (auto &dynamic : this->dynamics)
+  {
+    auto poseComp =
+        _ecm.Component<gz::sim::components::WorldPose>(dynamic.link);
+    if (poseComp && poseComp->Data() != dynamic.linkPose)
+    {
+      dynamic.linkPose = poseComp->Data();
+      this->scene.SetPose(dynamic.object, dynamic.linkPose * dynamic.offset);
+    }
+  }
+
+  this->scene.Update();
+}
+
+//////////////////////////////////////////////////
+const RayCastScene &CollisionScene::Scene() const
+{
+  return this->scene;
+}
+
+//////////////////////////////////////////////////
+gz::sim::Entity CollisionScene::CollisionEntity(uint32_t _object) const
+{
+  return _object < this->collisions.size() ?
+      this->collisions[_object] : gz::sim::kNullEntity;
+}
+
+//////////////////////////////////////////////////
+void CollisionScene::AddCollision(
+    const gz::sim::EntityComponentManager &_ecm,
+    gz::sim::Entity _collision,
+    const sdf::Geometry &_geometry,
+    const gz::math::Pose3d &_pose,
+    gz::sim::Entity _link)
+{
+  RayCastScene::Shape shape;
+  gz::math::Pose3d offset = _pose;
+  switch (_geometry.Type())
+  {
+    case sdf::GeometryType::BOX:
+      shape.type = RayCastScene::ShapeType::BOX;
+      shape.size = _geometry.BoxShape()->Size();
+      break;
+    case sdf::GeometryType::SPHERE:
+      shape.type = RayCastScene::ShapeType::SPHERE;
+      shape.size.X(_geometry.SphereShape()->Radius());
+      break;
+    case sdf::GeometryType::CYLINDER:
+      shape.type = RayCastScene::ShapeType::CYLINDER;
+      shape.size.Set(_geometry.CylinderShape()->Radius(), 0.0,
+          _geometry.CylinderShape()->Length());
+      break;
+    case sdf::GeometryType::CAPSULE:
+    {
+      // bounding cylinder
+      const double radius = _geometry.CapsuleShape()->Radius();
+      shape.type = RayCastScene::ShapeType::CYLINDER;
+      shape.size.Set(radius, 0.0,
+          _geometry.CapsuleShape()->Length() + 2.0 * radius);
+      break;
+    }
+    case sdf::GeometryType::ELLIPSOID:
+      // bounding box
+      shape.type = RayCastScene::ShapeType::BOX;
+      shape.size = 2.0 * _geometry.EllipsoidShape()->Radii();
+      break;
+    case sdf::GeometryType::PLANE:
+    {
+      // a box with no height, rotated so z is along the normal
+      const auto *plane = _geometry.PlaneShape();
+      shape.type = RayCastScene::ShapeType::BOX;
+      shape.size.Set(plane->Size().X(), plane->Size().Y(), 0.0);
+      gz::math::Quaterniond rot;
+      rot.SetFrom2Axes(gz::math::Vector3d::UnitZ, plane->Normal());
+      offset = _pose * gz::math::Pose3d(gz::math::Vector3d::Zero, rot);
+      break;
+    }
+    case sdf::GeometryType::MESH:
+      shape.type = RayCastScene::ShapeType::MESH;
+      if (!this->LoadMesh(_geometry, shape.mesh))
+      {
+        return;
+      }
+      break;
+    default:
+      if (!this->warned)
+      {
+        gzwarn << "CollisionScene: collision geometry type ["
+               << static_cast<int>(_geometry.Type())
+               << "] is not supported for ray casting, skipping.\n";
+        this->warned = true;
+      }
+      return;
+  }
+
+  // only links of non-static models move
+  const gz::sim::Entity model = gz::sim::topLevelModel(_link, _ecm);
+  auto staticComp = _ecm.Component<gz::sim::components::Static>(model);
+  const bool isStatic = staticComp && staticComp->Data();
+
+  const gz::math::Pose3d linkPose = gz::sim::worldPose(_link, _ecm);
+  const uint32_t object = this->scene.AddObject(shape, linkPose * offset,
+      model);
+  this->collisions.resize(object + 1, gz::sim::kNullEntity);
+  this->collisions[object] = _collision;
+  this->objects[_collision] = object;
+
+  if (!isStatic)
+  {
+    this->newLinks.push_back(_link);
+    this->dynamics.push_back(Dynamic{_link, linkPose, offset, object});
+  }
+}
+
+//////////////////////////////////////////////////
+bool CollisionScene::LoadMesh(const sdf::Geometry &_geometry,
+                              uint32_t &_mesh)
+{
+  const sdf::Mesh *meshSdf = _geometry.MeshShape();
+  const std::string file =
+      gz::sim::asFullPath(meshSdf->Uri(), meshSdf->FilePath());
+
+  std::ostringstream key;
+  key << file << "|" << meshSdf->Submesh() << "|" << meshSdf->Scale();
+  auto it = this->meshes.find(key.str());
+  if (it != this->meshes.end())
+  {
+    _mesh = it->second;
+    return true;
+  }
+
+  const gz::common::Mesh *mesh =
+      gz::common::MeshManager::Instance()->Load(file);
+  if (!mesh)
+  {
+    gzwarn << "CollisionScene: failed to load mesh [" << file
+           << "], skipping.\n";
+    return false;
+  }
+
+  const gz::math::Vector3d scale = meshSdf->Scale();
+  std::vector<gz::math::Vector3d> vertices;
+  std::vector<uint32_t> indices;
+  for (unsigned int i = 0; i < mesh->SubMeshCount(); ++i)
+  {
+    auto subMesh = mesh->SubMeshByIndex(i).lock();
+    if (!subMesh ||
+        subMesh->SubMeshPrimitiveType() != gz::common::SubMesh::TRIANGLES ||
+        (!meshSdf->Submesh().empty() &&
+         subMesh->Name() != meshSdf->Submesh()))
+    {
+      continue;
+    }
+
+    // optionally centre the selected submesh on its bounds
+    gz::math::Vector3d centre;
+    if (!meshSdf->Submesh().empty() && meshSdf->CenterSubmesh())
+    {
+      centre = 0.5 * (subMesh->Min() + subMesh->Max());
+    }
+
+    const uint32_t base = static_cast<uint32_t>(vertices.size());
+    for (unsigned int v = 0; v < subMesh->VertexCount(); ++v)
+    {
+      const gz::math::Vector3d p = subMesh->Vertex(v) - centre;
+      vertices.emplace_back(p.X() * scale.X(), p.Y() * scale.Y(),
+          p.Z() * scale.Z());
+    }
+    for (unsigned int n = 0; n < subMesh->IndexCount(); ++n)
+    {
+      indices.push_back(base + static_cast<uint32_t>(subMesh->Index(n)));
+    }
+  }
+
+  _mesh = this->scene.AddMesh(vertices, indices);
+  this->meshes[key.str()] = _mesh;
+  return true;
+}
+
+//////////////////////////////////////////////////
+std::shared_ptr<SharedCollisionScene> SharedCollisionScene::ForWorld(
+    const std::string &_world)
+{
+  static std::mutex registryMutex;
+  static std::map<std::string, std::weak_ptr<SharedCollisionScene>> registry;
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  std::shared_ptr<SharedCollisionScene> scene = registry[_world].lock();
+  if (!scene)
+  {
+    scene = std::make_shared<SharedCollisionScene>();
+    registry[_world] = scene;
+  }
+  return scene;
+}
+
+//////////////////////////////////////////////////
+void SharedCollisionScene::Update(const gz::sim::UpdateInfo &_info,
+                                  gz::sim::EntityComponentManager &_ecm)
+{
+  if (this->updated && this->iterations == _info.iterations &&
+      this->realTime == _info.realTime)
+  {
+    return;
+  }
+  this->updated = true;
+  this->iterations = _info.iterations;
+  this->realTime = _info.realTime;
+  this->collisions.Update(_ecm);
+}
+
+//////////////////////////////////////////////////
+const CollisionScene &SharedCollisionScene::Collisions() const
+{
+  return this->collisions;
+}
@@ -0,0 +1,210 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ConnectionHealthMonitor.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace
+{
+/// \brief Monotonic wall time (ns).
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// \brief Smoothing of the observed frame interval.
+constexpr double kIntervalAlpha = 0.1;
+}  // namespace
+
+struct ConnectionHealthMonitor::Impl
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop{false};
+    Callback callback;
+
+    /// \brief Written by the simulation thread.
+    std::atomic<int64_t> lastFrameTime{0};
+    std::atomic<bool> connected{false};
+    std::atomic<bool> rateLow{false};
+    std::atomic<bool> active{true};
+    std::atomic<double> observedRate{0.0};
+
+    /// \brief Owned by the simulation thread.
+    double lastSimTime{-1.0};
+    double interval{0.0};
+
+    /// \brief Written by the monitor thread.
+    std::atomic<State> state{State::CONNECTING};
+};
+
+ConnectionHealthMonitor::ConnectionHealthMonitor(const Params &_params) :
+    params(_params),
+    impl(new Impl)
+{
+}
+
+ConnectionHealthMonitor::~ConnectionHealthMonitor()
+{
+    Stop();
+}
+
+void ConnectionHealthMonitor::Start(Callback _callback)
+{
+    Stop();
+    impl->callback = std::move(_callback);
+    impl->stop = false;
+    impl->thread = std::thread(&ConnectionHealthMonitor::Run, this);
+}
+
+void ConnectionHealthMonitor::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        impl->stop = true;
+    }
+    impl->cv.notify_all();
+    if (impl->thread.joinable()) {
+        impl->thread.join();
+    }
+}
+
+void ConnectionHealthMonitor::OnFrame(double _simTime, uint16_t _frameRate)
+{
+    impl->lastFrameTime.store(now_ns(), std::memory_order_release);
+    impl->connected.store(true, std::memory_order_release);
+
+    // smoothed interval between frames in simulation time, restarted
+    // after a reset or a gap in the link
+    const double dt = _simTime - impl->lastSimTime;
+    impl->lastSimTime = _simTime;
+    if (dt <= 0.0 || dt > params.lostTimeout) {
+        return;
+    }
+    impl->interval = impl->interval > 0.0 ?
+        impl->interval + kIntervalAlpha * (dt - impl->interval) : dt;
+
+    const double rate = 1.0 / impl->interval;
+    impl->observedRate.store(rate, std::memory_order_relaxed);
+    impl->rateLow.store(
+        _frameRate > 0 && rate < params.degradedRateFraction * _frameRate,
+        std::memory_order_relaxed);
+}
+
+void ConnectionHealthMonitor::SetActive(bool _active)
+{
+    if (_active == impl->active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // restart the deadlines on resume
+    if (_active && impl->connected.load(std::memory_order_acquire)) {
+        impl->lastFrameTime.store(now_ns(), std::memory_order_release);
+    }
+    impl->active.store(_active, std::memory_order_release);
+}
+
+ConnectionHealthMonitor::State ConnectionHealthMonitor::CurrentState() const
+{
+    return impl->state.load(std::memory_order_acquire);
+}
+
+double ConnectionHealthMonitor::ObservedRate() const
+{
+    return impl->observedRate.load(std::memory_order_relaxed);
+}
+
+const ConnectionHealthMonitor::Params &
+ConnectionHealthMonitor::Parameters() const
+{
+    return params;
+}
+
+const char *ConnectionHealthMonitor::StateName(State _state)
+{
+    switch (_state) {
+    case State::CONNECTING:
+        return "connecting";
+    case State::ONLINE:
+        return "online";
+    case State::DEGRADED:
+        return "degraded";
+    case State::LOST:
+        return "lost";
+    }
+    return "unknown";
+}
+
+ConnectionHealthMonitor::State
+ConnectionHealthMonitor::Classify(int64_t _now) const
+{
+    if (!impl->connected.load(std::memory_order_acquire)) {
+        return State::CONNECTING;
+    }
+    const double age = 1.0e-9 *
+        (_now - impl->lastFrameTime.load(std::memory_order_acquire));
+    if (age > params.lostTimeout) {
+        return State::LOST;
+    }
+    if (age > params.degradedTimeout ||
+        impl->rateLow.load(std::memory_order_relaxed)) {
+        return State::DEGRADED;
+    }
+    return State::ONLINE;
+}
+
+void ConnectionHealthMonitor::Run()
+{
+    const auto period = std::chrono::duration_cast<
+        std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(
+                std::max(params.checkPeriod, 1.0e-3)));
+    auto deadline = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    while (!impl->stop) {
+        deadline += period;
+        impl->cv.wait_until(lock, deadline, [this] { return impl->stop; });
+        if (impl->stop) {
+            break;
+        }
+
+        // hold the state while inactive
+        if (!impl->active.load(std::memory_order_acquire)) {
+            continue;
+        }
+
+        const State from = impl->state.load(std::memory_order_relaxed);
+        const State to = Classify(now_ns());
+        if (to != from) {
+            impl->state.store(to, std::memory_order_release);
+            if (impl->callback) {
+                lock.unlock();
+                impl->callback(from, to);
+                lock.lock();
+            }
+        }
+    }
+}
@@ -16,14 +16,21 @@
  */
 
 #include "GstCameraPlugin.hh"
+#include "AdaptiveBitrate.hh"
 
 #include <gst/app/gstappsrc.h>
 #include <gst/gst.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <gz/plugin/Register.hh>
@@ -32,6 +39,7 @@
 #include <gz/sim/Model.hh>
 #include <gz/sim/Sensor.hh>
 #include <gz/sim/Util.hh>
+#include <gz/sim/World.hh>
 #include <gz/sim/components/Camera.hh>
 #include <gz/sim/components/Name.hh>
 #include <gz/sim/components/Sensor.hh>
@@ -49,15 +57,36 @@ namespace systems {
 
 class GstCameraPlugin::Impl {
    public:
+    /// \brief One branch of a simulcast ladder.
+    struct SimulcastStream
+    {
+        unsigned int width{0};
+        unsigned int height{0};
+        unsigned int bitrate{800};
+        std::string udpHost{"127.0.0.1"};
+        int udpPort{5600};
+    };
+
     void InitializeCamera();
     void StartStreaming();
     static void *StartThread(void *);
     void StartGstThread();
 
     void OnImage(const msgs::Image &msg);
+    void OnMosaicImage(const msgs::Image &_msg, size_t _index);
+    void PushFrame(const cv::Mat &_frame);
+    bool ConfigureMosaic(const Entity &_entity,
+        const std::shared_ptr<const sdf::Element> &_sdf,
+        const EntityComponentManager &_ecm);
     void OnVideoStreamEnable(const msgs::Boolean &_msg);
+    void OnOutputResolution(const msgs::Vector2d &_msg);
     void OnRenderTeardown();
 
+    void UpdateOutputSize(unsigned int _imageWidth,
+        unsigned int _imageHeight);
+    GstCaps *CreateSourceCaps(unsigned int _width,
+        unsigned int _height) const;
+
     void StopStreaming();
     void StopGstThread();
 
@@ -66,13 +95,21 @@ class GstCameraPlugin::Impl {
     bool useRtmpPipeline{false};
     std::string rtmpLocation;
     bool useBasicPipeline{false};
+    std::string pipelineTemplate;
+    std::vector<SimulcastStream> simulcastStreams;
     bool useCuda{false};
     std::string imageTopic;
     std::string enableTopic;
+    std::string resolutionTopic;
 
+    // Size of the frames pushed to the appsrc (the negotiated caps).
     unsigned int width{0};
     unsigned int height{0};
 
+    // Requested output size, zero to stream at the camera resolution.
+    std::atomic<unsigned int> outputWidth{0};
+    std::atomic<unsigned int> outputHeight{0};
+
     // Unused by actual pipeline since it's based on the gazebo topic rate?
     unsigned int rate{5};
 
@@ -83,11 +120,44 @@ class GstCameraPlugin::Impl {
     GMainLoop *gst_loop{nullptr};
     GstElement *source{nullptr};
     void CreateMpeg2tsPipeline(GstElement *pipeline);
+    bool CreateCustomPipeline(GstElement *pipeline);
+    bool ValidateCustomPipeline(unsigned int _width, unsigned int _height);
+    std::string ExpandPipelineTemplate(unsigned int _width,
+        unsigned int _height) const;
+    static void OnCapsNotify(GObject *_pad, GParamSpec *, gpointer);
+    static void WatchCaps(GstElement *_bin);
     void CreateRtmpPipeline(GstElement *pipeline);
     void CreateGenericPipeline(GstElement *pipeline);
-    GstElement *CreateEncoder();
+    void CreateSimulcastPipeline(GstElement *pipeline);
+    bool AddRtcpFeedback(GstElement *pipeline, GstElement *payloader);
+    static gboolean OnRtcpStatsTimeout(gpointer _data);
+    void ApplyReceiverReport();
+    GstElement *CreateEncoder(unsigned int _bitrate = 800);
+
+    // Adaptive bitrate from RTCP receiver reports (generic pipeline only).
+    bool useAdaptiveBitrate{false};
+    AdaptiveBitrateController::Params abrParams;
+    std::unique_ptr<AdaptiveBitrateController> abr;
+    int rtcpPort{0};
+    int rtcpListenPort{0};
+    GstElement *encoder{nullptr};
+    GstElement *rtpBin{nullptr};
+    GSource *rtcpTimer{nullptr};
+    guint lastRbSequence{0};
+    std::atomic<unsigned int> keyframeInterval{0};
+    std::atomic<bool> keyframeRequested{false};
+    unsigned int framesSinceKeyframe{0};
+
+    // Mosaic mode: several cameras tiled into one frame and encoded once.
+    std::vector<std::string> mosaicTopics;
+    unsigned int mosaicColumns{2};
+    unsigned int tileWidth{640};
+    unsigned int tileHeight{360};
+    cv::Mat mosaic;
+    std::mutex mosaicMutex;
 
     bool is_initialised{false};
+    bool validConfig{false};
     Sensor parentSensor;
     rendering::ScenePtr scene;
     rendering::CameraPtr camera;
@@ -113,25 +183,40 @@ void GstCameraPlugin::Configure(
     EntityComponentManager &_ecm,
     EventManager &_eventMgr)
 {
-    impl->parentSensor = Sensor(_entity);
-
-    if (!impl->parentSensor.Valid(_ecm))
+    const bool mosaicMode = _sdf->HasElement("mosaic");
+    if (mosaicMode)
     {
-        gzerr << "GstCameraPlugin: must be attached to a camera sensor. "
-                 "Failed to initialize" << std::endl;
-        return;
-    }
-
-    if (auto maybeName = impl->parentSensor.Name(_ecm))
-    {
-        gzmsg << "GstCameraPlugin: attached to sensor ["
-              << maybeName.value() << "]" << std::endl;
+        // the cameras are named in the <mosaic> block, the plugin is
+        // attached to the world
+        if (!impl->ConfigureMosaic(_entity, _sdf, _ecm))
+        {
+            gzerr << "GstCameraPlugin: invalid <mosaic>. "
+                     "Failed to initialize" << std::endl;
+            return;
+        }
     }
     else
     {
-        gzerr << "GstCameraPlugin: camera sensor has invalid name. "
-                 "Failed to initialize" << std::endl;
-        return;
+        impl->parentSensor = Sensor(_entity);
+
+        if (!impl->parentSensor.Valid(_ecm))
+        {
+            gzerr << "GstCameraPlugin: must be attached to a camera sensor. "
+                     "Failed to initialize" << std::endl;
+            return;
+        }
+
+        if (auto maybeName = impl->parentSensor.Name(_ecm))
+        {
+            gzmsg << "GstCameraPlugin: attached to sensor ["
+                  << maybeName.value() << "]" << std::endl;
+        }
+        else
+        {
+            gzerr << "GstCameraPlugin: camera sensor has invalid name. "
+                     "Failed to initialize" << std::endl;
+            return;
+        }
     }
 
     if (_sdf->HasElement("udp_host"))
@@ -147,9 +232,105 @@ void GstCameraPlugin::Configure(
           << impl->udpHost << ":"
           << impl->udpPort << std::endl;
 
-    // uses MPEG2TS pipeline by default. RTMP and Generic are
-    // mutually exclusive with priority to RTMP
-    if (_sdf->HasElement("rtmp_location"))
+    if (_sdf->HasElement("output_width") && _sdf->HasElement("output_height"))
+    {
+        impl->outputWidth = _sdf->Get<unsigned int>("output_width");
+        impl->outputHeight = _sdf->Get<unsigned int>("output_height");
+        gzmsg << "GstCameraPlugin: output resolution "
+              << impl->outputWidth.load() << "x"
+              << impl->outputHeight.load() << std::endl;
+    }
+
+    // uses MPEG2TS pipeline by default. Simulcast, Custom, RTMP and Generic
+    // are mutually exclusive with priority in that order
+    if (_sdf->HasElement("simulcast"))
+    {
+        auto simulcastSdf = _sdf->FindElement("simulcast");
+        auto streamSdf = simulcastSdf->FindElement("stream");
+        while (streamSdf)
+        {
+            Impl::SimulcastStream stream;
+            stream.udpHost = impl->udpHost;
+            stream.udpPort = impl->udpPort +
+                static_cast<int>(impl->simulcastStreams.size());
+            stream.width = streamSdf->Get<unsigned int>(
+                "width", stream.width).first & ~1u;
+            stream.height = streamSdf->Get<unsigned int>(
+                "height", stream.height).first & ~1u;
+            stream.bitrate = streamSdf->Get<unsigned int>(
+                "bitrate", stream.bitrate).first;
+            stream.udpHost = streamSdf->Get<std::string>(
+                "udp_host", stream.udpHost).first;
+            stream.udpPort = streamSdf->Get<int>(
+                "udp_port", stream.udpPort).first;
+            // a stream without a size is sent at the source resolution
+            if ((stream.width == 0) != (stream.height == 0) ||
+                stream.bitrate == 0)
+            {
+                gzerr << "GstCameraPlugin: simulcast stream "
+                      << impl->simulcastStreams.size()
+                      << " needs a non-zero bitrate, and a width and "
+                         "height that are both set or both zero. "
+                         "Failed to initialize" << std::endl;
+                return;
+            }
+
+            gzmsg << "GstCameraPlugin: simulcast stream "
+                  << impl->simulcastStreams.size() << " "
+                  << (stream.width > 0 ?
+                      std::to_string(stream.width) + "x" +
+                      std::to_string(stream.height) : "source size")
+                  << " @ "
+                  << stream.bitrate << " kbit/s to "
+                  << stream.udpHost << ":" << stream.udpPort << std::endl;
+            impl->simulcastStreams.push_back(stream);
+            streamSdf = streamSdf->GetNextElement("stream");
+        }
+        if (impl->simulcastStreams.empty())
+        {
+            gzerr << "GstCameraPlugin: <simulcast> requires at least one "
+                     "<stream>. Failed to initialize" << std::endl;
+            return;
+        }
+    }
+    else if (_sdf->HasElement("pipeline"))
+    {
+        impl->pipelineTemplate = _sdf->Get<std::string>("pipeline");
+
+        // check the description parses and links to the appsrc at load time
+        // using the sensor's configured image size, and the output size the
+        // stream starts at if one is set
+        unsigned int w = 640;
+        unsigned int h = 480;
+        auto cameraComp = _ecm.Component<components::Camera>(_entity);
+        if (!impl->mosaic.empty())
+        {
+            w = impl->mosaic.cols;
+            h = impl->mosaic.rows;
+        }
+        else if (cameraComp && cameraComp->Data().CameraSensor())
+        {
+            w = cameraComp->Data().CameraSensor()->ImageWidth();
+            h = cameraComp->Data().CameraSensor()->ImageHeight();
+        }
+        bool valid = impl->ValidateCustomPipeline(w, h);
+        if (valid && impl->outputWidth > 0 && impl->outputHeight > 0)
+        {
+            impl->UpdateOutputSize(w, h);
+            if (impl->width != w || impl->height != h)
+            {
+                valid = impl->ValidateCustomPipeline(impl->width,
+                    impl->height);
+            }
+        }
+        if (!valid)
+        {
+            gzerr << "GstCameraPlugin: invalid <pipeline>. "
+                     "Failed to initialize" << std::endl;
+            return;
+        }
+    }
+    else if (_sdf->HasElement("rtmp_location"))
     {
         impl->rtmpLocation = _sdf->Get<std::string>("rtmp_location");
         impl->useRtmpPipeline = true;
@@ -166,6 +347,38 @@ void GstCameraPlugin::Configure(
         impl->useCuda = _sdf->Get<bool>("use_cuda");
     }
 
+    if (_sdf->HasElement("adaptive_bitrate"))
+    {
+        auto abrSdf = _sdf->FindElement("adaptive_bitrate");
+        auto &params = impl->abrParams;
+        params.minKbps = abrSdf->Get<unsigned int>(
+            "min_bitrate", params.minKbps).first;
+        params.maxKbps = abrSdf->Get<unsigned int>(
+            "max_bitrate", params.maxKbps).first;
+        params.startKbps = abrSdf->Get<unsigned int>(
+            "start_bitrate", params.startKbps).first;
+        impl->rtcpPort = abrSdf->Get<int>(
+            "rtcp_port", impl->udpPort + 1).first;
+        impl->rtcpListenPort = abrSdf->Get<int>(
+            "rtcp_listen_port", impl->udpPort + 5).first;
+
+        if (impl->useBasicPipeline && impl->simulcastStreams.empty() &&
+            impl->pipelineTemplate.empty() && !impl->useRtmpPipeline)
+        {
+            impl->useAdaptiveBitrate = true;
+            gzmsg << "GstCameraPlugin: adaptive bitrate "
+                  << params.minKbps << "-" << params.maxKbps
+                  << " kbit/s, RTCP to " << impl->udpHost << ":"
+                  << impl->rtcpPort << ", receiver reports on port "
+                  << impl->rtcpListenPort << std::endl;
+        }
+        else
+        {
+            gzwarn << "GstCameraPlugin: <adaptive_bitrate> requires "
+                      "<use_basic_pipeline>, ignoring" << std::endl;
+        }
+    }
+
     if (_sdf->HasElement("image_topic"))
     {
         impl->imageTopic = _sdf->Get<std::string>("image_topic");
@@ -176,6 +389,36 @@ void GstCameraPlugin::Configure(
         impl->enableTopic = _sdf->Get<std::string>("enable_topic");
     }
 
+    if (_sdf->HasElement("resolution_topic"))
+    {
+        impl->resolutionTopic = _sdf->Get<std::string>("resolution_topic");
+    }
+
+    if (mosaicMode)
+    {
+        gzmsg << "GstCameraPlugin: enable topic ["
+              << impl->enableTopic << "]" << std::endl;
+        gzmsg << "GstCameraPlugin: resolution topic ["
+              << impl->resolutionTopic << "]" << std::endl;
+
+        for (size_t i = 0; i < impl->mosaicTopics.size(); ++i)
+        {
+            std::function<void(const msgs::Image &)> cb =
+                [this, i](const msgs::Image &_msg)
+                {
+                    this->impl->OnMosaicImage(_msg, i);
+                };
+            impl->node.Subscribe(impl->mosaicTopics[i], cb);
+        }
+        impl->node.Subscribe(impl->enableTopic,
+            &GstCameraPlugin::Impl::OnVideoStreamEnable, impl.get());
+        impl->node.Subscribe(impl->resolutionTopic,
+            &GstCameraPlugin::Impl::OnOutputResolution, impl.get());
+        impl->is_initialised = true;
+        impl->validConfig = true;
+        return;
+    }
+
     //! @note subscriptions are deferred to Pre-Update as the enclosing
     //  sensor must be fully initialised before entity - component queries
     //  for topics names etc. to succeed.
@@ -184,11 +427,20 @@ void GstCameraPlugin::Configure(
     impl->connections.push_back(
         _eventMgr.Connect<gz::sim::events::RenderTeardown>(
             std::bind(&GstCameraPlugin::Impl::OnRenderTeardown, impl.get())));
+
+    impl->validConfig = true;
 }
 
 void GstCameraPlugin::PreUpdate(const UpdateInfo &_info,
     EntityComponentManager &_ecm)
 {
+    // nothing to do if Configure() failed, mosaic mode is fully
+    // configured there
+    if (!impl->validConfig || !impl->mosaicTopics.empty())
+    {
+        return;
+    }
+
     if (impl->cameraName.empty())
     {
         Entity cameraEntity = impl->parentSensor.Entity();
@@ -220,16 +472,31 @@ void GstCameraPlugin::PreUpdate(const UpdateInfo &_info,
             }
             impl->enableTopic = maybeTopic.value() + "/enable_streaming";
         }
+
+        if (impl->resolutionTopic.empty())
+        {
+            auto maybeTopic = impl->parentSensor.Topic(_ecm);
+            if (!maybeTopic.has_value())
+            {
+                return;
+            }
+            impl->resolutionTopic =
+                maybeTopic.value() + "/output_resolution";
+        }
         gzmsg << "GstCameraPlugin: image topic ["
               << impl->imageTopic << "]" << std::endl;
         gzmsg << "GstCameraPlugin: enable topic ["
               << impl->enableTopic << "]" << std::endl;
+        gzmsg << "GstCameraPlugin: resolution topic ["
+              << impl->resolutionTopic << "]" << std::endl;
 
         // subscribe to gazebo topics
         impl->node.Subscribe(impl->imageTopic,
             &GstCameraPlugin::Impl::OnImage, impl.get());
         impl->node.Subscribe(impl->enableTopic,
             &GstCameraPlugin::Impl::OnVideoStreamEnable, impl.get());
+        impl->node.Subscribe(impl->resolutionTopic,
+            &GstCameraPlugin::Impl::OnOutputResolution, impl.get());
 
         impl->is_initialised = true;
     }
@@ -241,6 +508,61 @@ void GstCameraPlugin::PreUpdate(const UpdateInfo &_info,
     }
 }
 
+bool GstCameraPlugin::Impl::ConfigureMosaic(const Entity &_entity,
+    const std::shared_ptr<const sdf::Element> &_sdf,
+    const EntityComponentManager &_ecm)
+{
+    World world(_entity);
+    auto maybeWorldName = world.Name(_ecm);
+    if (!maybeWorldName.has_value())
+    {
+        gzerr << "GstCameraPlugin: <mosaic> must be attached to a world"
+              << std::endl;
+        return false;
+    }
+
+    auto mosaicSdf = _sdf->FindElement("mosaic");
+    mosaicColumns = std::max(1u,
+        mosaicSdf->Get<unsigned int>("columns", mosaicColumns).first);
+    tileWidth = mosaicSdf->Get<unsigned int>("tile_width", tileWidth).first;
+    tileHeight = mosaicSdf->Get<unsigned int>(
+        "tile_height", tileHeight).first;
+
+    // keep the mosaic dimensions even for I420
+    tileWidth = std::max(2u, tileWidth & ~1u);
+    tileHeight = std::max(2u, tileHeight & ~1u);
+
+    auto topicSdf = mosaicSdf->FindElement("image_topic");
+    while (topicSdf)
+    {
+        mosaicTopics.push_back(topicSdf->Get<std::string>());
+        gzmsg << "GstCameraPlugin: mosaic tile " << mosaicTopics.size() - 1
+              << " image topic [" << mosaicTopics.back() << "]" << std::endl;
+        topicSdf = topicSdf->GetNextElement("image_topic");
+    }
+    if (mosaicTopics.empty())
+    {
+        gzerr << "GstCameraPlugin: <mosaic> requires at least one "
+                 "<image_topic>" << std::endl;
+        return false;
+    }
+
+    const unsigned int count = mosaicTopics.size();
+    const unsigned int columns = std::min(mosaicColumns, count);
+    const unsigned int rows = (count + columns - 1) / columns;
+    mosaicColumns = columns;
+    mosaic = cv::Mat::zeros(rows * tileHeight, columns * tileWidth, CV_8UC3);
+    gzmsg << "GstCameraPlugin: mosaic " << columns << "x" << rows
+          << " tiles of " << tileWidth << "x" << tileHeight << std::endl;
+
+    const std::string prefix = "/world/" + maybeWorldName.value() + "/mosaic";
+    enableTopic = _sdf->Get<std::string>(
+        "enable_topic", prefix + "/enable_streaming").first;
+    resolutionTopic = _sdf->Get<std::string>(
+        "resolution_topic", prefix + "/output_resolution").first;
+    return true;
+}
+
 void GstCameraPlugin::Impl::InitializeCamera()
 {
     // Wait for render engine to be available.
@@ -304,7 +626,11 @@ void GstCameraPlugin::Impl::StartGstThread()
 {
     gst_init(nullptr, nullptr);
 
-    gst_loop = g_main_loop_new(nullptr, FALSE);
+    // each camera runs its own main context, so its sources are
+    // dispatched by its own loop and not by another camera's thread
+    GMainContext *context = g_main_context_new();
+    gst_loop = g_main_loop_new(context, FALSE);
+    g_main_context_unref(context);
     if (!gst_loop)
     {
         gzerr << "GstCameraPlugin: failed to create GStreamer main loop"
@@ -320,7 +646,15 @@ void GstCameraPlugin::Impl::StartGstThread()
     }
 
     source = gst_element_factory_make("appsrc", nullptr);
-    if (useRtmpPipeline)
+    if (!simulcastStreams.empty())
+    {
+        CreateSimulcastPipeline(pipeline);
+    }
+    else if (!pipelineTemplate.empty())
+    {
+        CreateCustomPipeline(pipeline);
+    }
+    else if (useRtmpPipeline)
     {
         CreateRtmpPipeline(pipeline);
     }
@@ -334,17 +668,13 @@ void GstCameraPlugin::Impl::StartGstThread()
     }
 
     // Configure source element
-    g_object_set(G_OBJECT(source), "caps",
-        gst_caps_new_simple("video/x-raw",
-                            "format", G_TYPE_STRING, "I420",
-                            "width", G_TYPE_INT, width,
-                            "height", G_TYPE_INT, height,
-                            "framerate", GST_TYPE_FRACTION,
-                            this->rate, 1, nullptr),
+    GstCaps *caps = CreateSourceCaps(width, height);
+    g_object_set(G_OBJECT(source), "caps", caps,
                  "is-live", TRUE,
                  "do-timestamp", TRUE,
                  "stream-type", GST_APP_STREAM_TYPE_STREAM,
                  "format", GST_FORMAT_TIME, nullptr);
+    gst_caps_unref(caps);
 
     gst_object_ref(source);
 
@@ -364,12 +694,20 @@ void GstCameraPlugin::Impl::StartGstThread()
     gzmsg << "GstCameraPlugin: stopping GStreamer main loop" << std::endl;
 
     // Clean up
+    if (rtcpTimer)
+    {
+        g_source_destroy(rtcpTimer);
+        g_source_unref(rtcpTimer);
+        rtcpTimer = nullptr;
+    }
     gst_element_set_state(pipeline, GST_STATE_NULL);
     gst_object_unref(GST_OBJECT(pipeline));
     gst_object_unref(source);
     g_main_loop_unref(gst_loop);
     gst_loop = nullptr;
     source = nullptr;
+    encoder = nullptr;
+    rtpBin = nullptr;
 }
 
 void GstCameraPlugin::Impl::CreateRtmpPipeline(GstElement *pipeline)
@@ -409,14 +747,27 @@ void GstCameraPlugin::Impl::CreateGenericPipeline(GstElement *pipeline)
     gzdbg << "GstCameraPlugin: creating generic pipeline" << std::endl;
     GstElement *queue = gst_element_factory_make("queue", nullptr);
     GstElement *converter = gst_element_factory_make("videoconvert", nullptr);
-    GstElement *encoder = CreateEncoder();
-    GstElement *payloader = gst_element_factory_make("rtph264pay", nullptr);
-    GstElement *sink = gst_element_factory_make("udpsink", nullptr);
+    if (useAdaptiveBitrate)
+    {
+        abr.reset(new AdaptiveBitrateController(abrParams));
+        encoder = CreateEncoder(abr->BitrateKbps());
 
-    g_object_set(G_OBJECT(sink), "host", udpHost.c_str(),
-        "port", udpPort, nullptr);
+        // keyframes are forced from PushFrame, so only cap the GOP at the
+        // longest interval the controller will ask for
+        if (encoder)
+        {
+            g_object_set(G_OBJECT(encoder),
+                useCuda ? "gop-size" : "key-int-max",
+                static_cast<int>(abrParams.maxKeyInterval), nullptr);
+        }
+    }
+    else
+    {
+        encoder = CreateEncoder();
+    }
+    GstElement *payloader = gst_element_factory_make("rtph264pay", nullptr);
 
-    if (!source || !queue || !converter || !encoder || !payloader || !sink)
+    if (!source || !queue || !converter || !encoder || !payloader)
     {
         gzerr << "GstCameraPlugin: failed to create GStreamer elements"
               << std::endl;
@@ -425,16 +776,195 @@ void GstCameraPlugin::Impl::CreateGenericPipeline(GstElement *pipeline)
 
     // Connect all elements to pipeline
     gst_bin_add_many(GST_BIN(pipeline), source, queue, converter, encoder,
-        payloader, sink, nullptr);
+        payloader, nullptr);
 
     // Link all elements
     if (gst_element_link_many(source, queue, converter, encoder,
-        payloader, sink, nullptr) != TRUE)
+        payloader, nullptr) != TRUE)
     {
         gzerr << "GstCameraPlugin: failed to link GStreamer elements"
               << std::endl;
         return;
     }
+
+    if (useAdaptiveBitrate)
+    {
+        AddRtcpFeedback(pipeline, payloader);
+        return;
+    }
+
+    GstElement *sink = gst_element_factory_make("udpsink", nullptr);
+    if (!sink)
+    {
+        gzerr << "GstCameraPlugin: failed to create GStreamer elements"
+              << std::endl;
+        return;
+    }
+    g_object_set(G_OBJECT(sink), "host", udpHost.c_str(),
+        "port", udpPort, nullptr);
+    gst_bin_add(GST_BIN(pipeline), sink);
+    if (gst_element_link(payloader, sink) != TRUE)
+    {
+        gzerr << "GstCameraPlugin: failed to link GStreamer elements"
+              << std::endl;
+        return;
+    }
+}
+
+bool GstCameraPlugin::Impl::AddRtcpFeedback(GstElement *pipeline,
+    GstElement *payloader)
+{
+    // payloader ! rtpbin ! udpsink (RTP)
+    //             rtpbin ! udpsink (RTCP sender reports)
+    //   udpsrc ! rtpbin            (RTCP receiver reports)
+    rtpBin = gst_element_factory_make("rtpbin", nullptr);
+    GstElement *rtpSink = gst_element_factory_make("udpsink", nullptr);
+    GstElement *rtcpSink = gst_element_factory_make("udpsink", nullptr);
+    GstElement *rtcpSrc = gst_element_factory_make("udpsrc", nullptr);
+
+    if (!rtpBin || !rtpSink || !rtcpSink || !rtcpSrc)
+    {
+        gzerr << "GstCameraPlugin: failed to create GStreamer elements"
+              << std::endl;
+        return false;
+    }
+
+    g_object_set(G_OBJECT(rtpSink), "host", udpHost.c_str(),
+        "port", udpPort, nullptr);
+    g_object_set(G_OBJECT(rtcpSink), "host", udpHost.c_str(),
+        "port", rtcpPort, "sync", FALSE, "async", FALSE, nullptr);
+    g_object_set(G_OBJECT(rtcpSrc), "port", rtcpListenPort, nullptr);
+
+    gst_bin_add_many(GST_BIN(pipeline), rtpBin, rtpSink, rtcpSink, rtcpSrc,
+        nullptr);
+
+    if (gst_element_link_pads(payloader, "src", rtpBin,
+            "send_rtp_sink_0") != TRUE ||
+        gst_element_link_pads(rtpBin, "send_rtp_src_0", rtpSink,
+            "sink") != TRUE ||
+        gst_element_link_pads(rtpBin, "send_rtcp_src_0", rtcpSink,
+            "sink") != TRUE ||
+        gst_element_link_pads(rtcpSrc, "src", rtpBin,
+            "recv_rtcp_sink_0") != TRUE)
+    {
+        gzerr << "GstCameraPlugin: failed to link RTCP elements"
+              << std::endl;
+        return false;
+    }
+
+    // poll the session statistics for new receiver reports
+    keyframeInterval = abr->KeyframeInterval();
+    rtcpTimer = g_timeout_source_new(500);
+    g_source_set_callback(rtcpTimer,
+        &GstCameraPlugin::Impl::OnRtcpStatsTimeout, this, nullptr);
+    g_source_attach(rtcpTimer, g_main_loop_get_context(gst_loop));
+    return true;
+}
+
+gboolean GstCameraPlugin::Impl::OnRtcpStatsTimeout(gpointer _data)
+{
+    static_cast<GstCameraPlugin::Impl *>(_data)->ApplyReceiverReport();
+    return G_SOURCE_CONTINUE;
+}
+
+void GstCameraPlugin::Impl::ApplyReceiverReport()
+{
+    if (!rtpBin || !abr || !encoder)
+    {
+        return;
+    }
+
+    GObject *session{nullptr};
+    g_signal_emit_by_name(rtpBin, "get-internal-session", 0, &session);
+    if (!session)
+    {
+        return;
+    }
+    GstStructure *stats{nullptr};
+    g_object_get(session, "stats", &stats, nullptr);
+    g_object_unref(session);
+    if (!stats)
+    {
+        return;
+    }
+
+    // rtpsession keeps a report block on the stats of the remote source
+    // that sent it, with rb-ssrc naming the stream it reports on, so find
+    // our own sender SSRC first and then the report about it.
+    // source-stats is still a GValueArray in GStreamer 1.x
+    bool haveReport{false};
+    guint fractionLost{0};
+    guint roundTrip{0};
+    const GValue *sourceStats = gst_structure_get_value(stats,
+        "source-stats");
+G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    GValueArray *sources = sourceStats ?
+        static_cast<GValueArray *>(g_value_get_boxed(sourceStats)) : nullptr;
+    bool haveSsrc{false};
+    guint ssrc{0};
+    for (guint i = 0; sources && i < sources->n_values; ++i)
+    {
+        const GstStructure *source = gst_value_get_structure(
+            g_value_array_get_nth(sources, i));
+        gboolean internal{FALSE};
+        gboolean isSender{FALSE};
+        gst_structure_get_boolean(source, "internal", &internal);
+        gst_structure_get_boolean(source, "is-sender", &isSender);
+        if (internal && isSender &&
+            gst_structure_get_uint(source, "ssrc", &ssrc))
+        {
+            haveSsrc = true;
+            break;
+        }
+    }
+    for (guint i = 0; haveSsrc && i < sources->n_values; ++i)
+    {
+        const GstStructure *source = gst_value_get_structure(
+            g_value_array_get_nth(sources, i));
+        gboolean internal{FALSE};
+        gboolean haveRb{FALSE};
+        guint rbSsrc{0};
+        guint sequence{0};
+        gst_structure_get_boolean(source, "internal", &internal);
+        gst_structure_get_boolean(source, "have-rb", &haveRb);
+        gst_structure_get_uint(source, "rb-ssrc", &rbSsrc);
+        gst_structure_get_uint(source, "rb-exthighestseq", &sequence);
+        if (internal || !haveRb || rbSsrc != ssrc ||
+            sequence == lastRbSequence)
+        {
+            continue;
+        }
+        lastRbSequence = sequence;
+        gst_structure_get_uint(source, "rb-fractionlost", &fractionLost);
+        gst_structure_get_uint(source, "rb-round-trip", &roundTrip);
+        haveReport = true;
+        break;
+    }
+G_GNUC_END_IGNORE_DEPRECATIONS
+    gst_structure_free(stats);
+
+    if (!haveReport)
+    {
+        return;
+    }
+
+    // fraction lost is 8 bit fixed point, round trip is 16.16 seconds
+    const double now = g_get_monotonic_time() * 1.0e-6;
+    const double loss = fractionLost / 256.0;
+    const double rttMs = roundTrip > 0 ? roundTrip * 1000.0 / 65536.0 : -1.0;
+    if (abr->Update(now, loss, rttMs))
+    {
+        g_object_set(G_OBJECT(encoder), "bitrate", abr->BitrateKbps(),
+            nullptr);
+        keyframeInterval = abr->KeyframeInterval();
+        gzdbg << "GstCameraPlugin: loss " << loss << ", rtt " << rttMs
+              << " ms, bitrate " << abr->BitrateKbps() << " kbit/s, "
+              << "keyframe interval " << abr->KeyframeInterval() << std::endl;
+    }
+    if (abr->TakeKeyframeRequest())
+    {
+        keyframeRequested = true;
+    }
 }
 
 void GstCameraPlugin::Impl::CreateMpeg2tsPipeline(GstElement *pipeline)
@@ -471,30 +1001,352 @@ void GstCameraPlugin::Impl::CreateMpeg2tsPipeline(GstElement *pipeline)
     }
 }
 
-GstElement* GstCameraPlugin::Impl::CreateEncoder()
+std::string GstCameraPlugin::Impl::ExpandPipelineTemplate(
+    unsigned int _width, unsigned int _height) const
+{
+    const std::vector<std::pair<std::string, std::string>> values = {
+        {"{host}", udpHost},
+        {"{port}", std::to_string(udpPort)},
+        {"{width}", std::to_string(_width)},
+        {"{height}", std::to_string(_height)},
+        {"{fps}", std::to_string(rate)},
+    };
+
+    std::string desc = pipelineTemplate;
+    for (const auto &value : values)
+    {
+        size_t pos = 0;
+        while ((pos = desc.find(value.first, pos)) != std::string::npos)
+        {
+            desc.replace(pos, value.first.size(), value.second);
+            pos += value.second.size();
+        }
+    }
+    return desc;
+}
+
+bool GstCameraPlugin::Impl::ValidateCustomPipeline(
+    unsigned int _width, unsigned int _height)
+{
+    gst_init(nullptr, nullptr);
+
+    const std::string desc = ExpandPipelineTemplate(_width, _height);
+    gzmsg << "GstCameraPlugin: custom pipeline [" << desc << "]" << std::endl;
+
+    GError *error{nullptr};
+    GstElement *bin = gst_parse_bin_from_description(
+        desc.c_str(), TRUE, &error);
+    if (!bin)
+    {
+        gzerr << "GstCameraPlugin: failed to parse pipeline: "
+              << (error ? error->message : "unknown error") << std::endl;
+        g_clear_error(&error);
+        return false;
+    }
+    if (error)
+    {
+        // recoverable error, e.g. a missing property
+        gzwarn << "GstCameraPlugin: pipeline parsed with warning: "
+               << error->message << std::endl;
+        g_clear_error(&error);
+    }
+
+    bool valid = true;
+    GstPad *sinkPad = gst_element_get_static_pad(bin, "sink");
+    if (!sinkPad)
+    {
+        gzerr << "GstCameraPlugin: pipeline has no unlinked sink pad "
+                 "to connect the appsrc" << std::endl;
+        valid = false;
+    }
+    else
+    {
+        // report the caps the pipeline will accept from the appsrc
+        GstCaps *srcCaps = CreateSourceCaps(_width, _height);
+        GstCaps *caps = gst_pad_query_caps(sinkPad, srcCaps);
+        if (gst_caps_is_empty(caps))
+        {
+            gchar *str = gst_caps_to_string(srcCaps);
+            gzerr << "GstCameraPlugin: pipeline does not accept [" << str
+                  << "]" << std::endl;
+            g_free(str);
+            valid = false;
+        }
+        else
+        {
+            gchar *str = gst_caps_to_string(caps);
+            gzmsg << "GstCameraPlugin: pipeline input caps [" << str
+                  << "]" << std::endl;
+            g_free(str);
+        }
+        gst_caps_unref(caps);
+        gst_caps_unref(srcCaps);
+        gst_object_unref(sinkPad);
+    }
+
+    gst_object_unref(bin);
+    return valid;
+}
+
+bool GstCameraPlugin::Impl::CreateCustomPipeline(GstElement *pipeline)
+{
+    gzdbg << "GstCameraPlugin: creating custom pipeline" << std::endl;
+    const std::string desc = ExpandPipelineTemplate(width, height);
+
+    GError *error{nullptr};
+    GstElement *bin = gst_parse_bin_from_description(
+        desc.c_str(), TRUE, &error);
+    if (!bin)
+    {
+        gzerr << "GstCameraPlugin: failed to parse pipeline: "
+              << (error ? error->message : "unknown error") << std::endl;
+        g_clear_error(&error);
+        return false;
+    }
+    if (error)
+    {
+        // recoverable error, e.g. a missing property
+        gzwarn << "GstCameraPlugin: pipeline parsed with warning: "
+               << error->message << std::endl;
+        g_clear_error(&error);
+    }
+    if (!source)
+    {
+        gzerr << "GstCameraPlugin: failed to create GStreamer elements"
+              << std::endl;
+        return false;
+    }
+
+    gst_bin_add_many(GST_BIN(pipeline), source, bin, nullptr);
+    if (gst_element_link(source, bin) != TRUE)
+    {
+        gzerr << "GstCameraPlugin: failed to link GStreamer elements"
+              << std::endl;
+        return false;
+    }
+
+    // report the caps negotiated by each element once data flows
+    WatchCaps(bin);
+    return true;
+}
+
+void GstCameraPlugin::Impl::OnCapsNotify(GObject *_pad, GParamSpec *,
+    gpointer)
+{
+    GstPad *pad = GST_PAD(_pad);
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps)
+    {
+        return;
+    }
+    gchar *str = gst_caps_to_string(caps);
+    GstElement *parent = gst_pad_get_parent_element(pad);
+    gzmsg << "GstCameraPlugin: negotiated ["
+          << (parent ? GST_ELEMENT_NAME(parent) : "?") << "."
+          << GST_PAD_NAME(pad) << "] " << str << std::endl;
+    if (parent)
+    {
+        gst_object_unref(parent);
+    }
+    g_free(str);
+    gst_caps_unref(caps);
+}
+
+void GstCameraPlugin::Impl::WatchCaps(GstElement *_bin)
+{
+    GstIterator *it = gst_bin_iterate_recurse(GST_BIN(_bin));
+    GValue item = G_VALUE_INIT;
+    while (gst_iterator_next(it, &item) == GST_ITERATOR_OK)
+    {
+        GstElement *element = GST_ELEMENT(g_value_get_object(&item));
+        GstIterator *padIt = gst_element_iterate_src_pads(element);
+        GValue padItem = G_VALUE_INIT;
+        while (gst_iterator_next(padIt, &padItem) == GST_ITERATOR_OK)
+        {
+            g_signal_connect(g_value_get_object(&padItem), "notify::caps",
+                G_CALLBACK(&GstCameraPlugin::Impl::OnCapsNotify), nullptr);
+            g_value_reset(&padItem);
+        }
+        g_value_unset(&padItem);
+        gst_iterator_free(padIt);
+        g_value_reset(&item);
+    }
+    g_value_unset(&item);
+    gst_iterator_free(it);
+}
+
+void GstCameraPlugin::Impl::CreateSimulcastPipeline(GstElement *pipeline)
+{
+    gzdbg << "GstCameraPlugin: creating simulcast pipeline with "
+          << simulcastStreams.size() << " streams" << std::endl;
+
+    // The frames are converted to I420 once in OnImage. Each branch scales
+    // the I420 planes directly and has its own encoder and sink.
+    GstElement *tee = gst_element_factory_make("tee", nullptr);
+    if (!source || !tee)
+    {
+        gzerr << "GstCameraPlugin: failed to create GStreamer elements"
+              << std::endl;
+        return;
+    }
+    gst_bin_add_many(GST_BIN(pipeline), source, tee, nullptr);
+    if (gst_element_link(source, tee) != TRUE)
+    {
+        gzerr << "GstCameraPlugin: failed to link GStreamer elements"
+              << std::endl;
+        return;
+    }
+
+    for (const auto &stream : simulcastStreams)
+    {
+        // a leaky queue decouples the branches so a slow encoder
+        // drops its own frames rather than stalling the others
+        GstElement *queue = gst_element_factory_make("queue", nullptr);
+        GstElement *scaler = gst_element_factory_make("videoscale", nullptr);
+        GstElement *filter = gst_element_factory_make("capsfilter", nullptr);
+        GstElement *encoder = CreateEncoder(stream.bitrate);
+        GstElement *payloader = gst_element_factory_make("rtph264pay",
+            nullptr);
+        GstElement *sink = gst_element_factory_make("udpsink", nullptr);
+
+        if (!queue || !scaler || !filter || !encoder || !payloader || !sink)
+        {
+            gzerr << "GstCameraPlugin: failed to create GStreamer elements"
+                  << std::endl;
+            return;
+        }
+
+        g_object_set(G_OBJECT(queue), "leaky", 2, "max-size-buffers", 2,
+            nullptr);
+        GstCaps *caps = gst_caps_new_simple("video/x-raw",
+            "format", G_TYPE_STRING, "I420", nullptr);
+        // without a size the branch keeps the source resolution
+        if (stream.width > 0)
+        {
+            gst_caps_set_simple(caps,
+                "width", G_TYPE_INT, stream.width,
+                "height", G_TYPE_INT, stream.height, nullptr);
+        }
+        g_object_set(G_OBJECT(filter), "caps", caps, nullptr);
+        gst_caps_unref(caps);
+        g_object_set(G_OBJECT(sink), "host", stream.udpHost.c_str(),
+            "port", stream.udpPort, "sync", false, nullptr);
+
+        gst_bin_add_many(GST_BIN(pipeline), queue, scaler, filter, encoder,
+            payloader, sink, nullptr);
+        if (gst_element_link_many(tee, queue, scaler, filter, encoder,
+            payloader, sink, nullptr) != TRUE)
+        {
+            gzerr << "GstCameraPlugin: failed to link GStreamer elements"
+                  << std::endl;
+            return;
+        }
+    }
+}
+
+GstElement* GstCameraPlugin::Impl::CreateEncoder(unsigned int _bitrate)
 {
     GstElement* encoder{nullptr};
     if (useCuda)
     {
         gzdbg << "Using Cuda" << std::endl;
         encoder = gst_element_factory_make("nvh264enc", nullptr);
-        g_object_set(G_OBJECT(encoder), "bitrate", 800, "preset", 1, nullptr);
+        if (encoder)
+        {
+            g_object_set(G_OBJECT(encoder), "bitrate", _bitrate,
+                "preset", 1, nullptr);
+        }
     }
     else
     {
         encoder = gst_element_factory_make("x264enc", nullptr);
-        g_object_set(G_OBJECT(encoder), "bitrate", 800, "speed-preset", 6,
-            "tune", 4, "key-int-max", 10, nullptr);
+        if (encoder)
+        {
+            g_object_set(G_OBJECT(encoder), "bitrate", _bitrate,
+                "speed-preset", 6, "tune", 4, "key-int-max", 10, nullptr);
+        }
     }
     return encoder;
 }
 
+GstCaps *GstCameraPlugin::Impl::CreateSourceCaps(unsigned int _width,
+    unsigned int _height) const
+{
+    return gst_caps_new_simple("video/x-raw",
+        "format", G_TYPE_STRING, "I420",
+        "width", G_TYPE_INT, _width,
+        "height", G_TYPE_INT, _height,
+        "framerate", GST_TYPE_FRACTION, this->rate, 1, nullptr);
+}
+
+void GstCameraPlugin::Impl::UpdateOutputSize(unsigned int _imageWidth,
+    unsigned int _imageHeight)
+{
+    // Stream at the camera resolution unless a smaller size is requested.
+    // Upscaling only costs bandwidth so it is not supported. The image is
+    // fitted within the requested size with one scale factor, so the
+    // aspect ratio of the camera is kept.
+    unsigned int w = _imageWidth;
+    unsigned int h = _imageHeight;
+    const unsigned int reqWidth = outputWidth;
+    const unsigned int reqHeight = outputHeight;
+    if (reqWidth > 0 && reqHeight > 0 && w > 0 && h > 0)
+    {
+        const double scale = std::min({1.0,
+            static_cast<double>(reqWidth) / w,
+            static_cast<double>(reqHeight) / h});
+        w = static_cast<unsigned int>(std::lround(w * scale));
+        h = static_cast<unsigned int>(std::lround(h * scale));
+    }
+
+    // I420 requires even dimensions.
+    width = std::max(2u, w & ~1u);
+    height = std::max(2u, h & ~1u);
+}
+
 void GstCameraPlugin::Impl::OnImage(const msgs::Image &msg)
+{
+    cv::Mat frame(msg.height(), msg.width(), CV_8UC3,
+        reinterpret_cast<unsigned char *>(
+            const_cast<char *>(msg.data().c_str())));
+    PushFrame(frame);
+}
+
+void GstCameraPlugin::Impl::OnMosaicImage(const msgs::Image &_msg,
+    size_t _index)
+{
+    cv::Mat frame(_msg.height(), _msg.width(), CV_8UC3,
+        reinterpret_cast<unsigned char *>(
+            const_cast<char *>(_msg.data().c_str())));
+
+    const int col = _index % mosaicColumns;
+    const int row = _index / mosaicColumns;
+
+    std::lock_guard<std::mutex> lock(mosaicMutex);
+    cv::Mat tile = mosaic(cv::Rect(col * tileWidth, row * tileHeight,
+        tileWidth, tileHeight));
+    if (frame.cols == tile.cols && frame.rows == tile.rows)
+    {
+        frame.copyTo(tile);
+    }
+    else
+    {
+        cv::resize(frame, tile, tile.size(), 0, 0, cv::INTER_AREA);
+    }
+
+    // the first camera paces the stream, the other tiles are
+    // encoded with their most recent frame
+    if (_index == 0)
+    {
+        PushFrame(mosaic);
+    }
+}
+
+void GstCameraPlugin::Impl::PushFrame(const cv::Mat &_frame)
 {
     if (requestedStartStreaming)
     {
-        width = msg.width();
-        height = msg.height();
+        UpdateOutputSize(_frame.cols, _frame.rows);
         StartStreaming();
         requestedStartStreaming = false;
         return;
@@ -502,8 +1354,37 @@ void GstCameraPlugin::Impl::OnImage(const msgs::Image &msg)
 
     if (!isGstMainLoopActive) return;
 
+    // Renegotiate the appsrc caps if the camera resolution or the requested
+    // output resolution has changed. The encoder reconfigures itself on the
+    // caps event, so the stream does not need to be restarted.
+    const unsigned int prevWidth = width;
+    const unsigned int prevHeight = height;
+    UpdateOutputSize(_frame.cols, _frame.rows);
+    if ((width != prevWidth || height != prevHeight) &&
+        (pipelineTemplate.find("{width}") != std::string::npos ||
+         pipelineTemplate.find("{height}") != std::string::npos))
+    {
+        // a custom pipeline with the size substituted into its caps
+        // cannot renegotiate, so it is rebuilt at the new size
+        gzmsg << "GstCameraPlugin: restarting custom pipeline "
+              << prevWidth << "x" << prevHeight << " -> "
+              << width << "x" << height << std::endl;
+        StopStreaming();
+        StartStreaming();
+        return;
+    }
+    if (width != prevWidth || height != prevHeight)
+    {
+        gzmsg << "GstCameraPlugin: renegotiating caps "
+              << prevWidth << "x" << prevHeight << " -> "
+              << width << "x" << height << std::endl;
+        GstCaps *caps = CreateSourceCaps(width, height);
+        gst_app_src_set_caps(GST_APP_SRC(this->source), caps);
+        gst_caps_unref(caps);
+    }
+
     // Alloc buffer
-    const guint size = width * height * 1.5;
+    const guint size = width * height * 3 / 2;
     GstBuffer *buffer = gst_buffer_new_allocate(NULL, size, NULL);
 
     if (!buffer)
@@ -518,17 +1399,25 @@ void GstCameraPlugin::Impl::OnImage(const msgs::Image &msg)
     if (!gst_buffer_map(buffer, &map, GST_MAP_WRITE))
     {
         gzerr << "GstCameraPlugin: gst_buffer_map failed" << std::endl;
+        gst_buffer_unref(buffer);
         return;
     }
 
-    // Color Conversion from RGB to YUV
-    cv::Mat frame = cv::Mat(height, width, CV_8UC3);
-    cv::Mat frameYUV = cv::Mat(height, width, CV_8UC3);
-    frame.data = reinterpret_cast<unsigned char *>(
-        const_cast<char *>(msg.data().c_str()));
+    // Color Conversion from RGB to YUV, written directly into the buffer
+    cv::Mat frameYUV(height * 3 / 2, width, CV_8UC1, map.data);
 
-    cvtColor(frame, frameYUV, cv::COLOR_RGB2YUV_I420);
-    memcpy(map.data, frameYUV.data, size);
+    if (_frame.cols != static_cast<int>(width) ||
+        _frame.rows != static_cast<int>(height))
+    {
+        cv::Mat scaled;
+        cv::resize(_frame, scaled, cv::Size(width, height), 0, 0,
+            cv::INTER_AREA);
+        cvtColor(scaled, frameYUV, cv::COLOR_RGB2YUV_I420);
+    }
+    else
+    {
+        cvtColor(_frame, frameYUV, cv::COLOR_RGB2YUV_I420);
+    }
     gst_buffer_unmap(buffer, &map);
 
     GstFlowReturn ret =
@@ -539,6 +1428,27 @@ void GstCameraPlugin::Impl::OnImage(const msgs::Image &msg)
         gzerr << "GstCameraPlugin: gst_app_src_push_buffer failed"
               << std::endl;
         g_main_loop_quit(gst_loop);
+        return;
+    }
+
+    // keyframe spacing steered by the adaptive bitrate controller
+    const unsigned int interval = keyframeInterval;
+    if (interval > 0 && encoder &&
+        (keyframeRequested.exchange(false) ||
+         ++framesSinceKeyframe >= interval))
+    {
+        framesSinceKeyframe = 0;
+        GstPad *pad = gst_element_get_static_pad(encoder, "src");
+        if (pad)
+        {
+            gst_pad_send_event(pad, gst_event_new_custom(
+                GST_EVENT_CUSTOM_UPSTREAM,
+                gst_structure_new("GstForceKeyUnit",
+                    "running-time", GST_TYPE_CLOCK_TIME, GST_CLOCK_TIME_NONE,
+                    "all-headers", G_TYPE_BOOLEAN, TRUE,
+                    "count", G_TYPE_UINT, 0, nullptr)));
+            gst_object_unref(pad);
+        }
     }
 }
 
@@ -557,6 +1467,19 @@ void GstCameraPlugin::Impl::OnVideoStreamEnable(const msgs::Boolean &msg)
     }
 }
 
+void GstCameraPlugin::Impl::OnOutputResolution(const msgs::Vector2d &_msg)
+{
+    // A non-positive size restores the camera resolution.
+    const unsigned int w =
+        _msg.x() > 0.0 ? static_cast<unsigned int>(_msg.x()) : 0;
+    const unsigned int h =
+        _msg.y() > 0.0 ? static_cast<unsigned int>(_msg.y()) : 0;
+    gzmsg << "GstCameraPlugin: requested output resolution "
+          << w << "x" << h << std::endl;
+    outputWidth = w;
+    outputHeight = h;
+}
+
 void GstCameraPlugin::Impl::OnRenderTeardown()
 {
     StopStreaming();
@@ -0,0 +1,238 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JointStateFilterBank.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+/// \brief One step of _n biquads, _n a multiple of 4.
+///
+/// y = b0 x + z1, z1 = b1 x - a1 y + z2, z2 = b2 x - a2 y
+void step(const double *_b0, const double *_b1, const double *_b2,
+          const double *_a1, const double *_a2, double *_z1, double *_z2,
+          const double *_x, double *_y, size_t _n)
+{
+#if defined(__AVX__)
+    for (size_t i = 0; i < _n; i += 4) {
+        const __m256d x = _mm256_loadu_pd(_x + i);
+        const __m256d y = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_loadu_pd(_b0 + i), x),
+            _mm256_loadu_pd(_z1 + i));
+        const __m256d z1 = _mm256_add_pd(
+            _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(_b1 + i), x),
+                          _mm256_mul_pd(_mm256_loadu_pd(_a1 + i), y)),
+            _mm256_loadu_pd(_z2 + i));
+        const __m256d z2 =
+            _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(_b2 + i), x),
+                          _mm256_mul_pd(_mm256_loadu_pd(_a2 + i), y));
+        _mm256_storeu_pd(_y + i, y);
+        _mm256_storeu_pd(_z1 + i, z1);
+        _mm256_storeu_pd(_z2 + i, z2);
+    }
+#elif defined(__SSE2__)
+    for (size_t i = 0; i < _n; i += 2) {
+        const __m128d x = _mm_loadu_pd(_x + i);
+        const __m128d y = _mm_add_pd(
+            _mm_mul_pd(_mm_loadu_pd(_b0 + i), x), _mm_loadu_pd(_z1 + i));
+        const __m128d z1 = _mm_add_pd(
+            _mm_sub_pd(_mm_mul_pd(_mm_loadu_pd(_b1 + i), x),
+                       _mm_mul_pd(_mm_loadu_pd(_a1 + i), y)),
+            _mm_loadu_pd(_z2 + i));
+        const __m128d z2 =
+            _mm_sub_pd(_mm_mul_pd(_mm_loadu_pd(_b2 + i), x),
+                       _mm_mul_pd(_mm_loadu_pd(_a2 + i), y));
+        _mm_storeu_pd(_y + i, y);
+        _mm_storeu_pd(_z1 + i, z1);
+        _mm_storeu_pd(_z2 + i, z2);
+    }
+#elif defined(__aarch64__)
+    for (size_t i = 0; i < _n; i += 2) {
+        const float64x2_t x = vld1q_f64(_x + i);
+        const float64x2_t y =
+            vfmaq_f64(vld1q_f64(_z1 + i), vld1q_f64(_b0 + i), x);
+        const float64x2_t z1 = vfmsq_f64(
+            vfmaq_f64(vld1q_f64(_z2 + i), vld1q_f64(_b1 + i), x),
+            vld1q_f64(_a1 + i), y);
+        const float64x2_t z2 = vfmsq_f64(
+            vmulq_f64(vld1q_f64(_b2 + i), x), vld1q_f64(_a2 + i), y);
+        vst1q_f64(_y + i, y);
+        vst1q_f64(_z1 + i, z1);
+        vst1q_f64(_z2 + i, z2);
+    }
+#else
+    for (size_t i = 0; i < _n; ++i) {
+        const double x = _x[i];
+        const double y = _b0[i] * x + _z1[i];
+        _z1[i] = _b1[i] * x - _a1[i] * y + _z2[i];
+        _z2[i] = _b2[i] * x - _a2[i] * y;
+        _y[i] = y;
+    }
+#endif
+}
+}  // namespace
+
+bool JointStateFilterBank::ParseType(const std::string &_name, Type &_type)
+{
+    if (_name == "none") {
+        _type = Type::NONE;
+    } else if (_name == "one_pole") {
+        _type = Type::ONE_POLE;
+    } else if (_name == "biquad") {
+        _type = Type::BIQUAD;
+    } else if (_name == "notch") {
+        _type = Type::NOTCH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void JointStateFilterBank::Resize(size_t _size)
+{
+    channels.assign(_size, Channel());
+    stride = (_size + 3) & ~static_cast<size_t>(3);
+    b0.assign(stride, 1.0);
+    b1.assign(stride, 0.0);
+    b2.assign(stride, 0.0);
+    a1.assign(stride, 0.0);
+    a2.assign(stride, 0.0);
+    z1.assign(stride, 0.0);
+    z2.assign(stride, 0.0);
+    input.assign(stride, 0.0);
+    output.assign(stride, 0.0);
+}
+
+size_t JointStateFilterBank::Size() const
+{
+    return channels.size();
+}
+
+bool JointStateFilterBank::Enabled() const
+{
+    return std::any_of(channels.begin(), channels.end(),
+        [](const Channel &_c) { return _c.type != Type::NONE; });
+}
+
+void JointStateFilterBank::Configure(size_t _channel, Type _type,
+                                     double _frequency, double _q,
+                                     double _sampleRate)
+{
+    Channel &channel = channels[_channel];
+    channel.type = _type;
+    channel.frequency = _frequency;
+    channel.q = _q > 0.0 ? _q : 0.7071;
+    channel.sampleRate = _sampleRate;
+    channel.primed = false;
+    Design(_channel);
+}
+
+void JointStateFilterBank::SetFrequency(size_t _channel, double _frequency)
+{
+    if (channels[_channel].frequency != _frequency) {
+        channels[_channel].frequency = _frequency;
+        Design(_channel);
+    }
+}
+
+void JointStateFilterBank::SetStepRate(double _rate)
+{
+    if (_rate == stepRate) {
+        return;
+    }
+    stepRate = _rate;
+    for (size_t i = 0; i < channels.size(); ++i) {
+        if (channels[i].sampleRate <= 0.0) {
+            Design(i);
+        }
+    }
+}
+
+void JointStateFilterBank::Process(const double *_in, double *_out)
+{
+    for (size_t i = 0; i < channels.size(); ++i) {
+        if (!channels[i].primed) {
+            Prime(i, _in[i]);
+        }
+    }
+    std::copy(_in, _in + channels.size(), input.begin());
+    step(b0.data(), b1.data(), b2.data(), a1.data(), a2.data(),
+         z1.data(), z2.data(), input.data(), output.data(), stride);
+    std::copy(output.begin(), output.begin() + channels.size(), _out);
+}
+
+void JointStateFilterBank::Design(size_t _channel)
+{
+    const Channel &channel = channels[_channel];
+    const double rate =
+        channel.sampleRate > 0.0 ? channel.sampleRate : stepRate;
+
+    // pass through until the frequency is below Nyquist
+    b0[_channel] = 1.0;
+    b1[_channel] = 0.0;
+    b2[_channel] = 0.0;
+    a1[_channel] = 0.0;
+    a2[_channel] = 0.0;
+    if (channel.type == Type::NONE || rate <= 0.0 ||
+        channel.frequency <= 0.0 || channel.frequency >= 0.5 * rate) {
+        return;
+    }
+
+    const double w0 = 2.0 * kPi * channel.frequency / rate;
+    if (channel.type == Type::ONE_POLE) {
+        const double alpha = 1.0 - std::exp(-w0);
+        b0[_channel] = alpha;
+        a1[_channel] = alpha - 1.0;
+        return;
+    }
+
+    // biquads from the RBJ audio EQ cookbook
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * channel.q);
+    const double a0 = 1.0 + alpha;
+    if (channel.type == Type::BIQUAD) {
+        b0[_channel] = 0.5 * (1.0 - cosw) / a0;
+        b1[_channel] = (1.0 - cosw) / a0;
+        b2[_channel] = b0[_channel];
+    } else {
+        b0[_channel] = 1.0 / a0;
+        b1[_channel] = -2.0 * cosw / a0;
+        b2[_channel] = b0[_channel];
+    }
+    a1[_channel] = -2.0 * cosw / a0;
+    a2[_channel] = (1.0 - alpha) / a0;
+}
+
+void JointStateFilterBank::Prime(size_t _channel, double _value)
+{
+    // all the filters have unit gain at DC
+    z1[_channel] = _value - b0[_channel] * _value;
+    z2[_channel] = (b2[_channel] - a2[_channel]) * _value;
+    channels[_channel].primed = true;
+}
@@ -19,6 +19,9 @@
 
 #include <gz/msgs/entity_factory.pb.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
@@ -27,11 +30,20 @@
 #include <gz/common/Profiler.hh>
 #include <gz/math/Pose3.hh>
 #include <gz/math/Quaternion.hh>
+#include <gz/math/Color.hh>
+#include <gz/math/Vector3.hh>
+#include <gz/sim/components/CastShadows.hh>
 #include <gz/sim/components/DetachableJoint.hh>
+#include <gz/sim/components/Geometry.hh>
+#include <gz/sim/components/LinearVelocity.hh>
+#include <gz/sim/components/Material.hh>
 #include <gz/sim/components/Model.hh>
 #include <gz/sim/components/Name.hh>
 #include <gz/sim/components/ParentEntity.hh>
+#include <gz/sim/components/Pose.hh>
 #include <gz/sim/components/Link.hh>
+#include <gz/sim/components/Visual.hh>
+#include <gz/sim/components/Wind.hh>
 #include <gz/sim/components/World.hh>
 #include <gz/sim/Link.hh>
 #include <gz/sim/Model.hh>
@@ -39,6 +51,12 @@
 #include <gz/sim/Util.hh>
 #include <gz/transport/Node.hh>
 
+#include <sdf/Cylinder.hh>
+#include <sdf/Geometry.hh>
+#include <sdf/Material.hh>
+
+#include "WindFieldComponents.hh"
+
 namespace gz {
 namespace sim {
 inline namespace GZ_SIM_VERSION_NAMESPACE {
@@ -53,6 +71,31 @@ class ParachutePlugin::Impl
   ///   The command message. Should be a normalised PWM level in [0, 1].
   public: void OnCommand(const msgs::Double &_msg);
 
+  /// \brief Apply the analytic drag force in drag mode.
+  public: void UpdateDrag(const UpdateInfo &_info,
+                          EntityComponentManager &_ecm);
+
+  /// \brief Create the visual-only canopy on the parent link.
+  ///
+  /// \param _airflow
+  ///   Unit vector of the airflow past the link in the link frame.
+  public: void CreateCanopyVisual(EntityComponentManager &_ecm,
+                                  const math::Vector3d &_airflow);
+
+  /// \brief Pose of the canopy in the link frame, downstream of the
+  /// attachment point.
+  ///
+  /// \param _airflow
+  ///   Unit vector of the airflow past the link in the link frame.
+  public: math::Pose3d CanopyPose(const math::Vector3d &_airflow) const;
+
+  /// \brief Trail the canopy visual behind the parent link.
+  ///
+  /// \param _airflow
+  ///   Unit vector of the airflow past the link in the link frame.
+  public: void UpdateCanopyVisual(EntityComponentManager &_ecm,
+                                  const math::Vector3d &_airflow);
+
   /// \brief World occupied by the parent model.
   public: World world{kNullEntity};
 
@@ -120,6 +163,39 @@ class ParachutePlugin::Impl
   /// \brief Flag set to true when the parachute model has been created.
   public: bool parachuteCreated{false};
 
+  /// \brief Flag set to true if the parachute is modelled as a drag force.
+  public: bool dragMode{false};
+
+  /// \brief Canopy drag coefficient.
+  public: double dragCoefficient{1.5};
+
+  /// \brief Reference area of the inflated canopy (m^2).
+  public: double area{1.0};
+
+  /// \brief Time from release to full inflation (s).
+  public: double inflationTime{1.0};
+
+  /// \brief Exponent of the canopy area growth during inflation.
+  public: double inflationExponent{2.0};
+
+  /// \brief Air density (kg/m^3).
+  public: double airDensity{1.225};
+
+  /// \brief Flag set to true if a visual-only canopy is shown.
+  public: bool canopyVisual{true};
+
+  /// \brief Distance from the attachment point to the canopy (m).
+  public: double riserLength{2.0};
+
+  /// \brief Flag set to true when the parachute is released in drag mode.
+  public: bool deployed{false};
+
+  /// \brief Simulation time of the release in drag mode.
+  public: std::chrono::steady_clock::duration deployTime{0};
+
+  /// \brief The visual-only canopy entity.
+  public: Entity canopyEntity{kNullEntity};
+
   /// \brief Transport node for subscriptions.
   public: transport::Node node;
 };
@@ -134,6 +210,144 @@ void ParachutePlugin::Impl::OnCommand(const msgs::Double &_msg)
   }
 }
 
+//////////////////////////////////////////////////
+void ParachutePlugin::Impl::UpdateDrag(
+    const UpdateInfo &_info,
+    EntityComponentManager &_ecm)
+{
+  if (!this->deployed)
+  {
+    if (!this->attachRequested)
+    {
+      return;
+    }
+    gzdbg << "Parachute release requested!\n";
+    this->attachRequested = false;
+    this->deployed = true;
+    this->deployTime = _info.simTime;
+  }
+
+  if (_info.paused)
+  {
+    return;
+  }
+
+  auto X_WL = this->parentLink.WorldPose(_ecm);
+  auto v_WL = this->parentLink.WorldLinearVelocity(_ecm);
+  if (!X_WL.has_value() || !v_WL.has_value())
+  {
+    return;
+  }
+
+  // velocity relative to the air, using the local wind from a
+  // WindFieldPlugin if one is running, otherwise the global wind
+  math::Vector3d v_rel = v_WL.value();
+  auto localWind = _ecm.Component<components::WindFieldVelocity>(
+      this->parentLink.Entity());
+  auto windEntity = _ecm.EntityByComponents(components::Wind());
+  if (localWind && _ecm.Component<components::WindFieldVelocity>(
+      worldEntity(_ecm)))
+  {
+    v_rel -= localWind->Data();
+  }
+  else if (windEntity != kNullEntity)
+  {
+    auto windVel =
+        _ecm.Component<components::WorldLinearVelocity>(windEntity);
+    if (windVel)
+    {
+      v_rel -= windVel->Data();
+    }
+  }
+  const double speed = v_rel.Length();
+  if (speed < 1.0e-6)
+  {
+    return;
+  }
+
+  // canopy area grows with a power law until fully inflated
+  const double t = std::chrono::duration<double>(
+      _info.simTime - this->deployTime).count();
+  double inflation = 1.0;
+  if (this->inflationTime > 0.0 && t < this->inflationTime)
+  {
+    inflation = std::pow(std::max(t, 0.0) / this->inflationTime,
+        this->inflationExponent);
+  }
+
+  const double q = 0.5 * this->airDensity * speed * speed;
+  const math::Vector3d force =
+      -q * this->dragCoefficient * this->area * inflation / speed * v_rel;
+  this->parentLink.AddWorldForce(_ecm, force, this->childPose.Pos());
+
+  // the canopy is created on the first airflow so it does not jump
+  const math::Vector3d airflow =
+      X_WL->Rot().RotateVectorReverse(-v_rel / speed);
+  if (this->canopyEntity != kNullEntity)
+  {
+    this->UpdateCanopyVisual(_ecm, airflow);
+  }
+  else if (this->canopyVisual)
+  {
+    this->CreateCanopyVisual(_ecm, airflow);
+  }
+}
+
+//////////////////////////////////////////////////
+void ParachutePlugin::Impl::CreateCanopyVisual(
+    EntityComponentManager &_ecm,
+    const math::Vector3d &_airflow)
+{
+  // a flat disc with the reference area of the inflated canopy
+  const double radius = std::sqrt(this->area / GZ_PI);
+  sdf::Cylinder cylinder;
+  cylinder.SetRadius(radius);
+  cylinder.SetLength(0.05 * radius);
+  sdf::Geometry geometry;
+  geometry.SetType(sdf::GeometryType::CYLINDER);
+  geometry.SetCylinderShape(cylinder);
+
+  sdf::Material material;
+  material.SetAmbient(math::Color(1.0, 0.4, 0.0));
+  material.SetDiffuse(math::Color(1.0, 0.4, 0.0));
+
+  this->canopyEntity = _ecm.CreateEntity();
+  _ecm.CreateComponent(this->canopyEntity, components::Visual());
+  _ecm.CreateComponent(this->canopyEntity,
+      components::Name("parachute_canopy"));
+  _ecm.CreateComponent(this->canopyEntity,
+      components::ParentEntity(this->parentLink.Entity()));
+  _ecm.CreateComponent(this->canopyEntity,
+      components::Pose(this->CanopyPose(_airflow)));
+  _ecm.CreateComponent(this->canopyEntity, components::Geometry(geometry));
+  _ecm.CreateComponent(this->canopyEntity, components::Material(material));
+  _ecm.CreateComponent(this->canopyEntity, components::CastShadows(false));
+}
+
+//////////////////////////////////////////////////
+math::Pose3d ParachutePlugin::Impl::CanopyPose(
+    const math::Vector3d &_airflow) const
+{
+  // the disc axis points along the airflow, downstream of the link
+  math::Quaterniond rot;
+  rot.SetFrom2Axes(math::Vector3d::UnitZ, _airflow);
+  return math::Pose3d(
+      this->childPose.Pos() + this->riserLength * _airflow, rot);
+}
+
+//////////////////////////////////////////////////
+void ParachutePlugin::Impl::UpdateCanopyVisual(
+    EntityComponentManager &_ecm,
+    const math::Vector3d &_airflow)
+{
+  const math::Pose3d pose = this->CanopyPose(_airflow);
+  if (_ecm.SetComponentData<components::Pose>(this->canopyEntity, pose))
+  {
+    _ecm.SetChanged(this->canopyEntity, components::Pose::typeId,
+        ComponentState::PeriodicChange);
+  }
+}
+
 //////////////////////////////////////////////////
 //////////////////////////////////////////////////
 ParachutePlugin::~ParachutePlugin() = default;
@@ -187,26 +401,64 @@ void ParachutePlugin::Configure(
     return;
   }
 
-  if (_sdf->HasElement("child_model"))
-  {
-    this->impl->childModelName = _sdf->Get<std::string>("child_model");
-  }
-  else
+  if (_sdf->HasElement("mode"))
   {
-    gzerr << "ParachutePlugin requires parameter 'child_model'. "
-             "Failed to initialize.\n";
-    return;
+    const auto mode = _sdf->Get<std::string>("mode");
+    if (mode == "drag")
+    {
+      this->impl->dragMode = true;
+    }
+    else if (mode != "model")
+    {
+      gzerr << "ParachutePlugin - unknown mode [" << mode << "]. "
+               "Failed to initialize.\n";
+      return;
+    }
   }
 
-  if (_sdf->HasElement("child_link"))
+  if (this->impl->dragMode)
   {
-    this->impl->childLinkName = _sdf->Get<std::string>("child_link");
+    this->impl->dragCoefficient = _sdf->Get<double>(
+        "drag_coefficient", this->impl->dragCoefficient).first;
+    this->impl->area = _sdf->Get<double>(
+        "area", this->impl->area).first;
+    this->impl->inflationTime = _sdf->Get<double>(
+        "inflation_time", this->impl->inflationTime).first;
+    this->impl->inflationExponent = _sdf->Get<double>(
+        "inflation_exponent", this->impl->inflationExponent).first;
+    this->impl->airDensity = _sdf->Get<double>(
+        "air_density", this->impl->airDensity).first;
+    this->impl->canopyVisual = _sdf->Get<bool>(
+        "canopy_visual", this->impl->canopyVisual).first;
+    this->impl->riserLength = _sdf->Get<double>(
+        "riser_length", this->impl->riserLength).first;
+    gzdbg << "ParachutePlugin drag mode: Cd " << this->impl->dragCoefficient
+          << ", area " << this->impl->area << " m^2, inflation time "
+          << this->impl->inflationTime << " s\n";
   }
   else
   {
-    gzerr << "ParachutePlugin requires parameter 'child_link'. "
-             "Failed to initialize.\n";
-    return;
+    if (_sdf->HasElement("child_model"))
+    {
+      this->impl->childModelName = _sdf->Get<std::string>("child_model");
+    }
+    else
+    {
+      gzerr << "ParachutePlugin requires parameter 'child_model'. "
+               "Failed to initialize.\n";
+      return;
+    }
+
+    if (_sdf->HasElement("child_link"))
+    {
+      this->impl->childLinkName = _sdf->Get<std::string>("child_link");
+    }
+    else
+    {
+      gzerr << "ParachutePlugin requires parameter 'child_link'. "
+               "Failed to initialize.\n";
+      return;
+    }
   }
 
   if (_sdf->HasElement("child_pose"))
@@ -243,6 +495,13 @@ void ParachutePlugin::Configure(
   }
   this->impl->parentLink.EnableVelocityChecks(_ecm);
 
+  // request the local wind from a WindFieldPlugin, if present
+  if (this->impl->dragMode)
+  {
+    enableComponent<components::WindFieldVelocity>(
+        _ecm, this->impl->parentLink.Entity(), true);
+  }
+
   // subscriptions
   this->impl->node.Subscribe(
       this->impl->commandTopic,
@@ -256,10 +515,16 @@ void ParachutePlugin::Configure(
 
 //////////////////////////////////////////////////
 void ParachutePlugin::PreUpdate(
-    const UpdateInfo &/*_info*/,
+    const UpdateInfo &_info,
     EntityComponentManager &_ecm)
 {
   GZ_PROFILE("ParachutePlugin::PreUpdate");
+  if (this->impl->validConfig && this->impl->dragMode)
+  {
+    this->impl->UpdateDrag(_info, _ecm);
+    return;
+  }
+
   if (this->impl->validConfig &&
       this->impl->shouldAttach &&
       !this->impl->attached)
@@ -0,0 +1,354 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PickingPlugin.hh"
+
+#include <gz/msgs/double_v.pb.h>
+#include <gz/msgs/pose_v.pb.h>
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gz/common/Console.hh>
+#include <gz/common/Profiler.hh>
+#include <gz/math/Pose3.hh>
+#include <gz/math/Vector3.hh>
+#include <gz/msgs/Utility.hh>
+#include <gz/plugin/Register.hh>
+#include <gz/sim/components/Camera.hh>
+#include <gz/sim/components/World.hh>
+#include <gz/sim/Util.hh>
+#include <gz/sim/World.hh>
+#include <gz/transport/Node.hh>
+#include <sdf/Camera.hh>
+#include <sdf/Sensor.hh>
+
+#include "CollisionScene.hh"
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+//////////////////////////////////////////////////
+class PickingPlugin::Impl
+{
+  /// \brief Pinhole model of a camera sensor at the last step.
+  public: struct CameraView
+  {
+    /// \brief Scoped name without the world.
+    std::string name;
+
+    /// \brief Sensor pose in the world frame.
+    math::Pose3d pose;
+
+    /// \brief Focal length (pixels).
+    double focal{1.0};
+
+    /// \brief Principal point (pixels).
+    double cx{0.0};
+    double cy{0.0};
+
+    /// \brief Clip planes (m).
+    double nearClip{0.0};
+    double farClip{0.0};
+
+    /// \brief Top level model carrying the camera.
+    Entity model{kNullEntity};
+  };
+
+  /// \brief Answer a batch of ray queries.
+  public: bool OnPickRay(const msgs::Double_V &_req, msgs::Pose_V &_res);
+
+  /// \brief Answer a batch of pixel queries.
+  public: bool OnPickPixel(const msgs::Double_V &_req, msgs::Pose_V &_res);
+
+  /// \brief Cast the rays and fill the response.
+  /// \note The scene mutex must be held.
+  public: void Cast(msgs::Pose_V &_res);
+
+  /// \brief The world collisions, shared with the RangefinderPlugin. Its
+  /// mutex also protects the names and cameras from the service threads.
+  public: std::shared_ptr<SharedCollisionScene> scene;
+
+  /// \brief Scoped name of each scene object.
+  public: std::vector<std::string> objectNames;
+
+  /// \brief Cameras by entity.
+  public: std::unordered_map<Entity, CameraView> cameras;
+
+  /// \brief Rays of the current query.
+  public: std::vector<RayCastScene::Ray> rays;
+
+  /// \brief Results of the current query.
+  public: std::vector<RayCastScene::Hit> hits;
+
+  /// \brief Maximum range of ray queries (m).
+  public: double maxRange{1000.0};
+
+  /// \brief Transport node.
+  public: transport::Node node;
+
+  /// \brief Set if the plugin is attached to a world.
+  public: bool validConfig{false};
+};
+
+//////////////////////////////////////////////////
+bool PickingPlugin::Impl::OnPickRay(const msgs::Double_V &_req,
+                                    msgs::Pose_V &_res)
+{
+  if (_req.data_size() % 6 != 0)
+  {
+    gzerr << "PickingPlugin: ray query needs six values per ray, got ["
+          << _req.data_size() << "].\n";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->scene->mutex);
+  this->rays.clear();
+  for (int i = 0; i < _req.data_size(); i += 6)
+  {
+    RayCastScene::Ray ray;
+    ray.origin.Set(_req.data(i), _req.data(i + 1), _req.data(i + 2));
+    ray.direction.Set(_req.data(i + 3), _req.data(i + 4), _req.data(i + 5));
+    ray.direction.Normalize();
+    ray.maxRange = this->maxRange;
+    this->rays.push_back(ray);
+  }
+  this->Cast(_res);
+  return true;
+}
+
+//////////////////////////////////////////////////
+bool PickingPlugin::Impl::OnPickPixel(const msgs::Double_V &_req,
+                                      msgs::Pose_V &_res)
+{
+  std::string cameraName;
+  for (const auto &data : _req.header().data())
+  {
+    if (data.key() == "camera" && data.value_size() > 0)
+    {
+      cameraName = data.value(0);
+    }
+  }
+  if (_req.data_size() % 2 != 0 || cameraName.empty())
+  {
+    gzerr << "PickingPlugin: pixel query needs a camera and two values "
+          << "per pixel.\n";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->scene->mutex);
+  const CameraView *camera = nullptr;
+  for (const auto &entry : this->cameras)
+  {
+    if (entry.second.name == cameraName)
+    {
+      camera = &entry.second;
+      break;
+    }
+  }
+  if (camera == nullptr)
+  {
+    gzerr << "PickingPlugin: camera [" << cameraName << "] not found.\n";
+    return false;
+  }
+
+  // the camera looks along x with the image right along -y and down
+  // along -z
+  this->rays.clear();
+  for (int i = 0; i < _req.data_size(); i += 2)
+  {
+    const math::Vector3d dir(1.0,
+        -(_req.data(i) - camera->cx) / camera->focal,
+        -(_req.data(i + 1) - camera->cy) / camera->focal);
+    RayCastScene::Ray ray;
+    ray.origin = camera->pose.Pos();
+    ray.direction = camera->pose.Rot().RotateVector(dir.Normalized());
+    // clip distances are along the optical axis
+    ray.minRange = camera->nearClip * dir.Length();
+    ray.maxRange = camera->farClip * dir.Length();
+    ray.ignoreGroup = camera->model;
+    this->rays.push_back(ray);
+  }
+  this->Cast(_res);
+  return true;
+}
+
+//////////////////////////////////////////////////
+void PickingPlugin::Impl::Cast(msgs::Pose_V &_res)
+{
+  this->hits.resize(this->rays.size());
+  this->scene->Collisions().Scene().Cast(
+      this->rays.data(), this->hits.data(), this->rays.size());
+
+  _res.Clear();
+  for (size_t i = 0; i < this->rays.size(); ++i)
+  {
+    msgs::Pose *pose = _res.add_pose();
+    const RayCastScene::Hit &hit = this->hits[i];
+    if (std::isinf(hit.distance))
+    {
+      pose->set_id(kNullEntity);
+      continue;
+    }
+    pose->set_id(this->scene->Collisions().CollisionEntity(hit.object));
+    if (hit.object < this->objectNames.size())
+    {
+      pose->set_name(this->objectNames[hit.object]);
+    }
+    msgs::Set(pose->mutable_position(),
+        this->rays[i].origin + hit.distance * this->rays[i].direction);
+    msgs::Set(pose->mutable_orientation(), math::Quaterniond::Identity);
+  }
+}
+
+//////////////////////////////////////////////////
+PickingPlugin::~PickingPlugin() = default;
+
+//////////////////////////////////////////////////
+PickingPlugin::PickingPlugin()
+    : impl(std::make_unique<PickingPlugin::Impl>())
+{
+}
+
+//////////////////////////////////////////////////
+void PickingPlugin::Configure(
+    const Entity &_entity,
+    const std::shared_ptr<const sdf::Element> &_sdf,
+    EntityComponentManager &_ecm,
+    EventManager &)
+{
+  if (!_ecm.Component<components::World>(_entity))
+  {
+    gzerr << "PickingPlugin should be attached to a world. "
+          << "Failed to initialize.\n";
+    return;
+  }
+
+  this->impl->maxRange =
+      _sdf->Get<double>("max_range", this->impl->maxRange).first;
+
+  const std::string worldName = World(_entity).Name(_ecm).value();
+  this->impl->scene = SharedCollisionScene::ForWorld(worldName);
+  const std::string rayService = "/world/" + worldName + "/pick/ray";
+  const std::string pixelService = "/world/" + worldName + "/pick/pixel";
+
+  // services
+  if (!this->impl->node.Advertise(rayService,
+          &PickingPlugin::Impl::OnPickRay, this->impl.get()) ||
+      !this->impl->node.Advertise(pixelService,
+          &PickingPlugin::Impl::OnPickPixel, this->impl.get()))
+  {
+    gzerr << "PickingPlugin failed to advertise services. "
+          << "Failed to initialize.\n";
+    return;
+  }
+
+  gzdbg << "PickingPlugin advertising services "
+        << "[" << rayService << "] and [" << pixelService << "]\n";
+
+  this->impl->validConfig = true;
+}
+
+//////////////////////////////////////////////////
+void PickingPlugin::PreUpdate(
+    const UpdateInfo &_info,
+    EntityComponentManager &_ecm)
+{
+  GZ_PROFILE("PickingPlugin::PreUpdate");
+
+  if (!this->impl->validConfig)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(this->impl->scene->mutex);
+
+  // collisions, naming the new ones
+  this->impl->scene->Update(_info, _ecm);
+  const CollisionScene &collisions = this->impl->scene->Collisions();
+  auto &names = this->impl->objectNames;
+  const size_t count = collisions.Scene().ObjectCount();
+  for (size_t i = names.size(); i < count; ++i)
+  {
+    names.push_back(removeParentScope(scopedName(
+        collisions.CollisionEntity(static_cast<uint32_t>(i)),
+        _ecm, "::", false), "::"));
+  }
+
+  // cameras, following their pose and zoom
+  _ecm.Each<components::Camera>(
+      [&](const Entity &_entity, const components::Camera *_camera) -> bool
+      {
+        const sdf::Camera *cameraSdf = _camera->Data().CameraSensor();
+        if (cameraSdf == nullptr)
+        {
+          return true;
+        }
+
+        auto it = this->impl->cameras.find(_entity);
+        if (it == this->impl->cameras.end())
+        {
+          Impl::CameraView view;
+          view.name = removeParentScope(
+              scopedName(_entity, _ecm, "::", false), "::");
+          view.model = topLevelModel(_entity, _ecm);
+          it = this->impl->cameras.emplace(_entity, view).first;
+        }
+
+        Impl::CameraView &view = it->second;
+        const double width = cameraSdf->ImageWidth();
+        const double height = cameraSdf->ImageHeight();
+        view.pose = worldPose(_entity, _ecm);
+        view.focal = 0.5 * width /
+            std::tan(0.5 * cameraSdf->HorizontalFov().Radian());
+        view.cx = 0.5 * width;
+        view.cy = 0.5 * height;
+        view.nearClip = cameraSdf->NearClip();
+        view.farClip = cameraSdf->FarClip();
+        return true;
+      });
+
+  _ecm.EachRemoved<components::Camera>(
+      [&](const Entity &_entity, const components::Camera *) -> bool
+      {
+        this->impl->cameras.erase(_entity);
+        return true;
+      });
+}
+
+//////////////////////////////////////////////////
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+GZ_ADD_PLUGIN(
+    gz::sim::systems::PickingPlugin,
+    gz::sim::System,
+    gz::sim::systems::PickingPlugin::ISystemConfigure,
+    gz::sim::systems::PickingPlugin::ISystemPreUpdate)
+
+GZ_ADD_PLUGIN_ALIAS(
+    gz::sim::systems::PickingPlugin,
+    "PickingPlugin")
@@ -0,0 +1,221 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RangefinderPlugin.hh"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <gz/common/Console.hh>
+#include <gz/common/Profiler.hh>
+#include <gz/math/Pose3.hh>
+#include <gz/math/Vector3.hh>
+#include <gz/plugin/Register.hh>
+#include <gz/sim/components/ParentEntity.hh>
+#include <gz/sim/components/Pose.hh>
+#include <gz/sim/components/World.hh>
+#include <gz/sim/Util.hh>
+#include <gz/sim/World.hh>
+
+#include "CollisionScene.hh"
+#include "RangefinderComponents.hh"
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+//////////////////////////////////////////////////
+class RangefinderPlugin::Impl
+{
+  /// \brief The world collisions, shared with the PickingPlugin.
+  public: std::shared_ptr<SharedCollisionScene> scene;
+
+  /// \brief Rangefinder entities in ray order.
+  public: std::vector<Entity> entities;
+
+  /// \brief Rays of the current batch.
+  public: std::vector<RayCastScene::Ray> rays;
+
+  /// \brief Results of the current batch.
+  public: std::vector<RayCastScene::Hit> hits;
+
+  /// \brief Top level model of each rangefinder.
+  public: std::unordered_map<Entity, Entity> models;
+
+  /// \brief Period between casts, zero for every step.
+  public: std::chrono::steady_clock::duration updatePeriod{0};
+
+  /// \brief Simulation time of the last cast.
+  public: std::chrono::steady_clock::duration lastUpdateTime{0};
+
+  /// \brief Set if the plugin is attached to a world.
+  public: bool validConfig{false};
+};
+
+//////////////////////////////////////////////////
+RangefinderPlugin::~RangefinderPlugin() = default;
+
+//////////////////////////////////////////////////
+RangefinderPlugin::RangefinderPlugin()
+    : impl(std::make_unique<RangefinderPlugin::Impl>())
+{
+}
+
+//////////////////////////////////////////////////
+void RangefinderPlugin::Configure(
+    const Entity &_entity,
+    const std::shared_ptr<const sdf::Element> &_sdf,
+    EntityComponentManager &_ecm,
+    EventManager &)
+{
+  if (!_ecm.Component<components::World>(_entity))
+  {
+    gzerr << "RangefinderPlugin should be attached to a world. "
+          << "Failed to initialize.\n";
+    return;
+  }
+
+  this->impl->scene =
+      SharedCollisionScene::ForWorld(World(_entity).Name(_ecm).value());
+
+  const double rate = _sdf->Get<double>("update_rate", 0.0).first;
+  if (rate > 0.0)
+  {
+    this->impl->updatePeriod =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / rate));
+  }
+
+  this->impl->validConfig = true;
+}
+
+//////////////////////////////////////////////////
+void RangefinderPlugin::PreUpdate(
+    const UpdateInfo &_info,
+    EntityComponentManager &_ecm)
+{
+  GZ_PROFILE("RangefinderPlugin::PreUpdate");
+
+  if (!this->impl->validConfig)
+  {
+    return;
+  }
+
+  // track collisions every step so none created or removed are missed,
+  // the lock keeps picking queries out while the scene changes
+  {
+    std::lock_guard<std::mutex> lock(this->impl->scene->mutex);
+    this->impl->scene->Update(_info, _ecm);
+  }
+
+  if (_info.paused ||
+      (this->impl->updatePeriod.count() > 0 &&
+       _info.simTime - this->impl->lastUpdateTime <
+          this->impl->updatePeriod))
+  {
+    return;
+  }
+  this->impl->lastUpdateTime = _info.simTime;
+
+  // gather the rays of all rangefinders
+  auto &entities = this->impl->entities;
+  auto &rays = this->impl->rays;
+  std::vector<Entity> missing;
+  entities.clear();
+  rays.clear();
+  _ecm.Each<components::RaycastRangefinder, components::Pose,
+            components::ParentEntity>(
+      [&](const Entity &_entity,
+          const components::RaycastRangefinder *_rangefinder,
+          const components::Pose *_pose,
+          const components::ParentEntity *_parent) -> bool
+      {
+        const Entity link = _parent->Data();
+        auto linkPoseComp = _ecm.Component<components::WorldPose>(link);
+        math::Pose3d linkPose;
+        if (linkPoseComp)
+        {
+          linkPose = linkPoseComp->Data();
+        }
+        else
+        {
+          missing.push_back(link);
+          linkPose = worldPose(link, _ecm);
+        }
+
+        auto model = this->impl->models.find(_entity);
+        if (model == this->impl->models.end())
+        {
+          model = this->impl->models.emplace(
+              _entity, topLevelModel(_entity, _ecm)).first;
+        }
+
+        const math::Pose3d pose = linkPose * _pose->Data();
+        RayCastScene::Ray ray;
+        ray.origin = pose.Pos();
+        ray.direction = pose.Rot().RotateVector(math::Vector3d::UnitX);
+        ray.minRange = _rangefinder->Data().minRange;
+        ray.maxRange = _rangefinder->Data().maxRange;
+        ray.ignoreGroup = model->second;
+        rays.push_back(ray);
+        entities.push_back(_entity);
+        return true;
+      });
+
+  // link poses are updated by physics from the next step
+  for (const Entity link : missing)
+  {
+    enableComponent<components::WorldPose>(_ecm, link, true);
+  }
+
+  if (rays.empty())
+  {
+    return;
+  }
+
+  // cast them in one batch and write back the ranges
+  this->impl->hits.resize(rays.size());
+  this->impl->scene->Collisions().Scene().Cast(
+      rays.data(), this->impl->hits.data(), rays.size());
+
+  for (size_t i = 0; i < entities.size(); ++i)
+  {
+    auto comp = _ecm.Component<components::RaycastRangefinder>(entities[i]);
+    comp->Data().range = this->impl->hits[i].distance;
+  }
+}
+
+//////////////////////////////////////////////////
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+GZ_ADD_PLUGIN(
+    gz::sim::systems::RangefinderPlugin,
+    gz::sim::System,
+    gz::sim::systems::RangefinderPlugin::ISystemConfigure,
+    gz::sim::systems::RangefinderPlugin::ISystemPreUpdate)
+
+GZ_ADD_PLUGIN_ALIAS(
+    gz::sim::systems::RangefinderPlugin,
+    "RangefinderPlugin")
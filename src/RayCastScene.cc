@@ -0,0 +1,547 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RayCastScene.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gz/math/Matrix3.hh>
+
+namespace
+{
+/// \brief Maximum number of items in a leaf.
+constexpr uint32_t kLeafSize = 4;
+
+/// \brief Infinity.
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+/// \brief First root of a quadratic `a t^2 + 2 b t + c` in [_tMin, _tMax].
+double firstRoot(double _a, double _b, double _c, double _tMin, double _tMax)
+{
+    const double disc = _b * _b - _a * _c;
+    if (_a <= 0.0 || disc < 0.0)
+    {
+        return kInf;
+    }
+    const double s = std::sqrt(disc);
+    const double t0 = (-_b - s) / _a;
+    if (t0 >= _tMin && t0 <= _tMax)
+    {
+        return t0;
+    }
+    const double t1 = (-_b + s) / _a;
+    if (t1 >= _tMin && t1 <= _tMax)
+    {
+        return t1;
+    }
+    return kInf;
+}
+
+/// \brief Ray and axis aligned box centred on the origin, the first
+/// surface crossing in [_tMin, _tMax].
+double intersectBox(const gz::math::Vector3d &_half,
+                    const gz::math::Vector3d &_o,
+                    const gz::math::Vector3d &_d,
+                    double _tMin, double _tMax)
+{
+    double t0 = -kInf;
+    double t1 = kInf;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (std::abs(_d[k]) < 1.0e-12)
+        {
+            if (std::abs(_o[k]) > _half[k])
+            {
+                return kInf;
+            }
+            continue;
+        }
+        double a = (-_half[k] - _o[k]) / _d[k];
+        double b = (_half[k] - _o[k]) / _d[k];
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+    }
+    if (t0 > t1)
+    {
+        return kInf;
+    }
+    if (t0 >= _tMin && t0 <= _tMax)
+    {
+        return t0;
+    }
+    if (t1 >= _tMin && t1 <= _tMax)
+    {
+        return t1;
+    }
+    return kInf;
+}
+
+/// \brief Ray and cylinder along z centred on the origin.
+double intersectCylinder(double _radius, double _length,
+                         const gz::math::Vector3d &_o,
+                         const gz::math::Vector3d &_d,
+                         double _tMin, double _tMax)
+{
+    const double h = 0.5 * _length;
+    double best = kInf;
+
+    // side, first root within the length
+    const double a = _d.X() * _d.X() + _d.Y() * _d.Y();
+    const double b = _o.X() * _d.X() + _o.Y() * _d.Y();
+    const double c = _o.X() * _o.X() + _o.Y() * _o.Y() - _radius * _radius;
+    const double disc = b * b - a * c;
+    if (a > 0.0 && disc >= 0.0)
+    {
+        const double s = std::sqrt(disc);
+        for (double t : {(-b - s) / a, (-b + s) / a})
+        {
+            const double z = _o.Z() + t * _d.Z();
+            if (t >= _tMin && t <= _tMax && std::abs(z) <= h)
+            {
+                best = std::min(best, t);
+            }
+        }
+    }
+
+    // caps
+    if (std::abs(_d.Z()) > 1.0e-12)
+    {
+        for (double zc : {-h, h})
+        {
+            const double t = (zc - _o.Z()) / _d.Z();
+            const double x = _o.X() + t * _d.X();
+            const double y = _o.Y() + t * _d.Y();
+            if (t >= _tMin && t <= _tMax &&
+                x * x + y * y <= _radius * _radius)
+            {
+                best = std::min(best, t);
+            }
+        }
+    }
+    return best;
+}
+
+/// \brief Ray and triangle (Moller-Trumbore), either side.
+double intersectTriangle(const gz::math::Vector3d &_v0,
+                         const gz::math::Vector3d &_v1,
+                         const gz::math::Vector3d &_v2,
+                         const gz::math::Vector3d &_o,
+                         const gz::math::Vector3d &_d,
+                         double _tMin, double _tMax)
+{
+    const gz::math::Vector3d e1 = _v1 - _v0;
+    const gz::math::Vector3d e2 = _v2 - _v0;
+    const gz::math::Vector3d p = _d.Cross(e2);
+    const double det = e1.Dot(p);
+    if (std::abs(det) < 1.0e-12)
+    {
+        return kInf;
+    }
+    const double invDet = 1.0 / det;
+    const gz::math::Vector3d s = _o - _v0;
+    const double u = s.Dot(p) * invDet;
+    if (u < 0.0 || u > 1.0)
+    {
+        return kInf;
+    }
+    const gz::math::Vector3d q = s.Cross(e1);
+    const double v = _d.Dot(q) * invDet;
+    if (v < 0.0 || u + v > 1.0)
+    {
+        return kInf;
+    }
+    const double t = e2.Dot(q) * invDet;
+    return t >= _tMin && t <= _tMax ? t : kInf;
+}
+
+/// \brief Component-wise inverse of a direction.
+void inverse(const gz::math::Vector3d &_d, double _inv[3])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        _inv[k] = 1.0 / _d[k];
+    }
+}
+}  // namespace
+
+//////////////////////////////////////////////////
+void RayCastBvh::Build(const std::vector<double> &_min,
+                       const std::vector<double> &_max)
+{
+    const uint32_t n = static_cast<uint32_t>(_min.size() / 3);
+    nodes.clear();
+    items.resize(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        items[i] = i;
+    }
+    if (n == 0)
+    {
+        return;
+    }
+
+    // empty bounds have no centre, place them at the origin
+    std::vector<double> centre(_min.size());
+    for (size_t i = 0; i < centre.size(); ++i)
+    {
+        centre[i] = _min[i] <= _max[i] ? 0.5 * (_min[i] + _max[i]) : 0.0;
+    }
+    nodes.reserve(2 * n);
+    BuildNode(0, n, _min, _max, centre);
+}
+
+//////////////////////////////////////////////////
+void RayCastBvh::BuildNode(uint32_t _begin, uint32_t _end,
+                           const std::vector<double> &_min,
+                           const std::vector<double> &_max,
+                           const std::vector<double> &_centre)
+{
+    const size_t idx = nodes.size();
+    nodes.push_back(Node{{kInf, kInf, kInf}, {-kInf, -kInf, -kInf},
+                         _begin, _end - _begin});
+
+    // bounds of the items and of their centres
+    double cmin[3] = {kInf, kInf, kInf};
+    double cmax[3] = {-kInf, -kInf, -kInf};
+    for (uint32_t i = _begin; i < _end; ++i)
+    {
+        const uint32_t item = items[i];
+        for (int k = 0; k < 3; ++k)
+        {
+            nodes[idx].min[k] = std::min(nodes[idx].min[k], _min[3 * item + k]);
+            nodes[idx].max[k] = std::max(nodes[idx].max[k], _max[3 * item + k]);
+            cmin[k] = std::min(cmin[k], _centre[3 * item + k]);
+            cmax[k] = std::max(cmax[k], _centre[3 * item + k]);
+        }
+    }
+    if (_end - _begin <= kLeafSize)
+    {
+        return;
+    }
+
+    // median split along the widest axis of the centres
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis])
+        {
+            axis = k;
+        }
+    }
+    if (cmax[axis] - cmin[axis] <= 0.0)
+    {
+        return;
+    }
+    const uint32_t mid = _begin + (_end - _begin) / 2;
+    std::nth_element(items.begin() + _begin, items.begin() + mid,
+        items.begin() + _end,
+        [&](uint32_t _a, uint32_t _b)
+        {
+            return _centre[3 * _a + axis] < _centre[3 * _b + axis];
+        });
+
+    nodes[idx].count = 0;
+    BuildNode(_begin, mid, _min, _max, _centre);
+    nodes[idx].index = static_cast<uint32_t>(nodes.size());
+    BuildNode(mid, _end, _min, _max, _centre);
+}
+
+//////////////////////////////////////////////////
+void RayCastBvh::Refit(const std::vector<double> &_min,
+                       const std::vector<double> &_max)
+{
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node &node = nodes[i];
+        for (int k = 0; k < 3; ++k)
+        {
+            node.min[k] = kInf;
+            node.max[k] = -kInf;
+        }
+        if (node.count > 0)
+        {
+            for (uint32_t j = node.index; j < node.index + node.count; ++j)
+            {
+                const uint32_t item = items[j];
+                for (int k = 0; k < 3; ++k)
+                {
+                    node.min[k] = std::min(node.min[k], _min[3 * item + k]);
+                    node.max[k] = std::max(node.max[k], _max[3 * item + k]);
+                }
+            }
+        }
+        else
+        {
+            const Node &left = nodes[i + 1];
+            const Node &right = nodes[node.index];
+            for (int k = 0; k < 3; ++k)
+            {
+                node.min[k] = std::min(left.min[k], right.min[k]);
+                node.max[k] = std::max(left.max[k], right.max[k]);
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////
+uint32_t RayCastScene::AddMesh(
+    const std::vector<gz::math::Vector3d> &_vertices,
+    const std::vector<uint32_t> &_indices)
+{
+    Mesh mesh;
+    mesh.vertices = _vertices;
+    mesh.indices = _indices;
+    mesh.indices.resize(_indices.size() / 3 * 3);
+
+    const size_t n = mesh.indices.size() / 3;
+    std::vector<double> tmin(3 * n), tmax(3 * n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            double lo = kInf;
+            double hi = -kInf;
+            for (int j = 0; j < 3; ++j)
+            {
+                const double v = mesh.vertices[mesh.indices[3 * i + j]][k];
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            }
+            tmin[3 * i + k] = lo;
+            tmax[3 * i + k] = hi;
+        }
+    }
+    mesh.bvh.Build(tmin, tmax);
+
+    meshes.push_back(std::move(mesh));
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+//////////////////////////////////////////////////
+uint32_t RayCastScene::AddObject(const Shape &_shape,
+                                 const gz::math::Pose3d &_pose,
+                                 uint64_t _group)
+{
+    const uint32_t object = static_cast<uint32_t>(shapes.size());
+    shapes.push_back(_shape);
+    poses.push_back(_pose);
+    groups.push_back(_group);
+    removed.push_back(false);
+    boundsMin.resize(boundsMin.size() + 3);
+    boundsMax.resize(boundsMax.size() + 3);
+    UpdateBounds(object);
+    rebuild = true;
+    return object;
+}
+
+//////////////////////////////////////////////////
+size_t RayCastScene::ObjectCount() const
+{
+    return shapes.size();
+}
+
+//////////////////////////////////////////////////
+uint64_t RayCastScene::ObjectGroup(uint32_t _object) const
+{
+    return groups[_object];
+}
+
+//////////////////////////////////////////////////
+void RayCastScene::SetPose(uint32_t _object, const gz::math::Pose3d &_pose)
+{
+    poses[_object] = _pose;
+    UpdateBounds(_object);
+    refit = true;
+}
+
+//////////////////////////////////////////////////
+void RayCastScene::RemoveObject(uint32_t _object)
+{
+    removed[_object] = true;
+    UpdateBounds(_object);
+    refit = true;
+}
+
+//////////////////////////////////////////////////
+void RayCastScene::UpdateBounds(uint32_t _object)
+{
+    // empty bounds are never entered
+    if (removed[_object])
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[3 * _object + k] = kInf;
+            boundsMax[3 * _object + k] = -kInf;
+        }
+        return;
+    }
+
+    // local bounds
+    const Shape &shape = shapes[_object];
+    gz::math::Vector3d lo, hi;
+    switch (shape.type)
+    {
+        case ShapeType::BOX:
+            hi = 0.5 * shape.size;
+            lo = -hi;
+            break;
+        case ShapeType::SPHERE:
+            hi.Set(shape.size.X(), shape.size.X(), shape.size.X());
+            lo = -hi;
+            break;
+        case ShapeType::CYLINDER:
+            hi.Set(shape.size.X(), shape.size.X(), 0.5 * shape.size.Z());
+            lo = -hi;
+            break;
+        case ShapeType::MESH:
+        {
+            lo.Set(kInf, kInf, kInf);
+            hi.Set(-kInf, -kInf, -kInf);
+            for (const auto &v : meshes[shape.mesh].vertices)
+            {
+                lo.Min(v);
+                hi.Max(v);
+            }
+            if (meshes[shape.mesh].vertices.empty())
+            {
+                lo = hi = gz::math::Vector3d::Zero;
+            }
+            break;
+        }
+    }
+
+    // world bounds of the rotated box
+    const gz::math::Pose3d &pose = poses[_object];
+    const gz::math::Vector3d centre = pose.Pos() +
+        pose.Rot().RotateVector(0.5 * (lo + hi));
+    const gz::math::Vector3d half = 0.5 * (hi - lo);
+    const gz::math::Matrix3d rot(pose.Rot());
+    for (int k = 0; k < 3; ++k)
+    {
+        const double e = std::abs(rot(k, 0)) * half.X() +
+                         std::abs(rot(k, 1)) * half.Y() +
+                         std::abs(rot(k, 2)) * half.Z();
+        boundsMin[3 * _object + k] = centre[k] - e;
+        boundsMax[3 * _object + k] = centre[k] + e;
+    }
+}
+
+//////////////////////////////////////////////////
+void RayCastScene::Update()
+{
+    if (rebuild)
+    {
+        bvh.Build(boundsMin, boundsMax);
+    }
+    else if (refit)
+    {
+        bvh.Refit(boundsMin, boundsMax);
+    }
+    rebuild = false;
+    refit = false;
+}
+
+//////////////////////////////////////////////////
+double RayCastScene::Intersect(uint32_t _object,
+                               const gz::math::Vector3d &_origin,
+                               const gz::math::Vector3d &_dir,
+                               double _tMin, double _tMax) const
+{
+    const Shape &shape = shapes[_object];
+    switch (shape.type)
+    {
+        case ShapeType::BOX:
+            return intersectBox(0.5 * shape.size, _origin, _dir,
+                _tMin, _tMax);
+        case ShapeType::SPHERE:
+            return firstRoot(1.0, _origin.Dot(_dir),
+                _origin.SquaredLength() - shape.size.X() * shape.size.X(),
+                _tMin, _tMax);
+        case ShapeType::CYLINDER:
+            return intersectCylinder(shape.size.X(), shape.size.Z(),
+                _origin, _dir, _tMin, _tMax);
+        case ShapeType::MESH:
+        {
+            const Mesh &mesh = meshes[shape.mesh];
+            const double o[3] = {_origin.X(), _origin.Y(), _origin.Z()};
+            double inv[3];
+            inverse(_dir, inv);
+            double tMax = _tMax;
+            double best = kInf;
+            mesh.bvh.Traverse(o, inv, _tMin, tMax,
+                [&](uint32_t _tri, double &_t)
+                {
+                    const double t = intersectTriangle(
+                        mesh.vertices[mesh.indices[3 * _tri]],
+                        mesh.vertices[mesh.indices[3 * _tri + 1]],
+                        mesh.vertices[mesh.indices[3 * _tri + 2]],
+                        _origin, _dir, _tMin, _t);
+                    if (t < _t)
+                    {
+                        _t = t;
+                        best = t;
+                    }
+                });
+            return best;
+        }
+    }
+    return kInf;
+}
+
+//////////////////////////////////////////////////
+void RayCastScene::Cast(const Ray *_rays, Hit *_hits, size_t _count) const
+{
+    for (size_t i = 0; i < _count; ++i)
+    {
+        const Ray &ray = _rays[i];
+        Hit &hit = _hits[i];
+        hit = Hit();
+
+        const double o[3] = {ray.origin.X(), ray.origin.Y(), ray.origin.Z()};
+        double inv[3];
+        inverse(ray.direction, inv);
+        double tMax = ray.maxRange;
+        bvh.Traverse(o, inv, ray.minRange, tMax,
+            [&](uint32_t _object, double &_t)
+            {
+                if (removed[_object] || (ray.ignoreGroup != 0 &&
+                    groups[_object] == ray.ignoreGroup))
+                {
+                    return;
+                }
+                // the ray in the object frame, rigid so distances hold
+                const gz::math::Pose3d &pose = poses[_object];
+                const gz::math::Vector3d origin =
+                    pose.Rot().RotateVectorReverse(ray.origin - pose.Pos());
+                const gz::math::Vector3d dir =
+                    pose.Rot().RotateVectorReverse(ray.direction);
+                const double t = Intersect(_object, origin, dir,
+                    ray.minRange, _t);
+                if (t < _t)
+                {
+                    _t = t;
+                    hit.distance = t;
+                    hit.object = _object;
+                }
+            });
+    }
+}
@@ -0,0 +1,119 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RealTimeFactorMatcher.hh"
+
+#include <algorithm>
+#include <cmath>
+
+RealTimeFactorMatcher::RealTimeFactorMatcher(const Params &_params) :
+    params(_params)
+{
+}
+
+void RealTimeFactorMatcher::Reset(double _target, double _wallTime,
+                                  double _simTime)
+{
+    target = _target;
+    windowWall = _wallTime;
+    windowSim = _simTime;
+    waitSum = 0.0;
+    controllerSum = 0.0;
+    frames = 0;
+}
+
+void RealTimeFactorMatcher::AddWait(double _seconds)
+{
+    waitSum += _seconds;
+}
+
+void RealTimeFactorMatcher::AddFrame(uint16_t _frameRate)
+{
+    if (_frameRate > 0) {
+        controllerSum += 1.0 / _frameRate;
+        frames++;
+    }
+}
+
+bool RealTimeFactorMatcher::Update(double _wallTime, double _simTime,
+                                   double &_target)
+{
+    const double wall = _wallTime - windowWall;
+    if (wall < params.period) {
+        return false;
+    }
+
+    // nothing to match without the controller, or while paused
+    const double sim = _simTime - windowSim;
+    const bool measured = frames > 0 && sim > 0.0;
+    achieved = sim / wall;
+    controller = controllerSum / wall;
+    wait = waitSum / wall;
+    Reset(target, _wallTime, _simTime);
+    if (!measured) {
+        return false;
+    }
+
+    double next;
+    if (!params.lockStep || wait > params.waitFraction) {
+        // the controller sets the pace
+        next = controller * (1.0 + params.headroom);
+    } else if (target <= 0.0) {
+        // unlimited and not waiting, already as fast as it can be
+        return false;
+    } else if (achieved >= target / (1.0 + params.deadband)) {
+        // held back by the target
+        next = target * params.stepUp;
+    } else {
+        // the simulation sets the pace
+        next = achieved * (1.0 + params.headroom);
+    }
+    next = std::min(std::max(next, params.minFactor), params.maxFactor);
+
+    if (target > 0.0 &&
+        std::abs(next - target) <= params.deadband * target) {
+        return false;
+    }
+    target = next;
+    _target = next;
+    return true;
+}
+
+double RealTimeFactorMatcher::Target() const
+{
+    return target;
+}
+
+double RealTimeFactorMatcher::AchievedFactor() const
+{
+    return achieved;
+}
+
+double RealTimeFactorMatcher::ControllerFactor() const
+{
+    return controller;
+}
+
+double RealTimeFactorMatcher::WaitFraction() const
+{
+    return wait;
+}
+
+const RealTimeFactorMatcher::Params &RealTimeFactorMatcher::Parameters() const
+{
+    return params;
+}
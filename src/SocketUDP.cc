@@ -17,9 +17,31 @@
 
 
 #include "SocketUDP.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+struct SocketUDP::SpinReceiver {
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<size_t> queued{0};
+    std::mutex mutex;
+    std::deque<Datagram> queue;
+};
 
 
 SocketUDP::SocketUDP(bool reuseaddress, bool blocking) {
@@ -44,6 +66,7 @@ SocketUDP::SocketUDP(bool reuseaddress, bool blocking) {
 
 
 SocketUDP::~SocketUDP() {
+    stop_spin_receiver();
     if (fd != -1) {
         ::close(fd);
         fd = -1;
@@ -96,6 +119,18 @@ ssize_t SocketUDP::sendto(const void *buf, size_t size, const char *address,
     struct sockaddr_in sockaddr_out{};
     make_sockaddr(address, port, sockaddr_out);
 
+    if (impairment.enabled() && impairment.impair_send) {
+        const int64_t now = now_us();
+        Datagram dgram;
+        const uint8_t *bytes = static_cast<const uint8_t *>(buf);
+        dgram.data.assign(bytes, bytes + size);
+        dgram.addr = sockaddr_out;
+        dgram.enqueued_us = now;
+        impair(std::move(dgram), tx_wheel, tx_stats);
+        flush_send(now);
+        return static_cast<ssize_t>(size);
+    }
+
     return ::sendto(fd, buf, size, 0,
                     reinterpret_cast<sockaddr *>(&sockaddr_out),
                     sizeof(sockaddr_out));
@@ -105,12 +140,16 @@ ssize_t SocketUDP::sendto(const void *buf, size_t size, const char *address,
   receive some data
  */
 ssize_t SocketUDP::recv(void *buf, size_t size, uint32_t timeout_ms) {
-    if (!pollin(timeout_ms)) {
+    if (impairment.enabled()) {
+        flush_send(now_us());
+        if (impairment.impair_recv) {
+            return recv_impaired(buf, size, timeout_ms);
+        }
+    }
+    if (!wait_readable(timeout_ms)) {
         return -1;
     }
-    socklen_t len = sizeof(in_addr);
-    return ::recvfrom(fd, buf, size, MSG_DONTWAIT,
-                      reinterpret_cast<sockaddr *>(&in_addr), &len);
+    return read_datagram(buf, size, in_addr);
 }
 
 
@@ -147,3 +186,409 @@ void SocketUDP::make_sockaddr(const char *address, uint16_t port,
     sockaddr.sin_len = sizeof(sockaddr);
 #endif
 }
+
+
+bool UDPImpairment::enabled() const {
+    return delay_ms > 0.0 || jitter_ms > 0.0 || loss > 0.0 ||
+           reorder > 0.0 || duplicate > 0.0;
+}
+
+
+void SocketUDP::set_impairment(const UDPImpairment &_impairment) {
+    impairment = _impairment;
+    rng.seed(impairment.seed);
+    tx_stats = UDPImpairmentStats();
+    rx_stats = UDPImpairmentStats();
+}
+
+
+int64_t SocketUDP::now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+int64_t SocketUDP::sample_delay_us() {
+    double delay = impairment.delay_ms;
+    const double jitter = impairment.jitter_ms;
+    if (jitter > 0.0) {
+        switch (impairment.distribution) {
+        case UDPImpairment::Distribution::UNIFORM:
+            delay += std::uniform_real_distribution<double>(
+                -jitter, jitter)(rng);
+            break;
+        case UDPImpairment::Distribution::NORMAL:
+            delay += std::normal_distribution<double>(0.0, jitter)(rng);
+            break;
+        case UDPImpairment::Distribution::PARETO: {
+            // heavy tail above the mean delay, shape 2.5
+            const double u = std::uniform_real_distribution<double>(
+                1.0e-9, 1.0)(rng);
+            delay += jitter * (std::pow(u, -1.0 / 2.5) - 1.0);
+            break;
+        }
+        case UDPImpairment::Distribution::CONSTANT:
+        default:
+            break;
+        }
+    }
+    return static_cast<int64_t>(std::max(delay, 0.0) * 1000.0);
+}
+
+
+void SocketUDP::impair(Datagram &&dgram, TimingWheel &wheel,
+                       UDPImpairmentStats &stats) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    if (uniform(rng) < impairment.loss) {
+        stats.dropped++;
+        return;
+    }
+
+    int copies = 1;
+    if (uniform(rng) < impairment.duplicate) {
+        copies = 2;
+        stats.duplicated++;
+    }
+
+    for (int i = 0; i < copies; ++i) {
+        Datagram copy;
+        if (i + 1 < copies) {
+            copy = dgram;
+        } else {
+            copy = std::move(dgram);
+        }
+
+        // a reordered datagram is delivered without delay and overtakes
+        // the datagrams in flight
+        int64_t delay_us;
+        if (uniform(rng) < impairment.reorder) {
+            delay_us = 0;
+            stats.reordered++;
+        } else {
+            delay_us = sample_delay_us();
+        }
+        copy.due_us = copy.enqueued_us + delay_us;
+        wheel.insert(std::move(copy));
+    }
+}
+
+
+void SocketUDP::record(UDPImpairmentStats &stats, const Datagram &dgram,
+                       int64_t now) {
+    const double delay_ms = (now - dgram.enqueued_us) * 1.0e-3;
+    stats.delivered++;
+    stats.delay_sum_ms += delay_ms;
+    stats.delay_max_ms = std::max(stats.delay_max_ms, delay_ms);
+}
+
+
+void SocketUDP::flush_send(int64_t now) {
+    tx_wheel.advance(now);
+    while (!tx_wheel.ready.empty()) {
+        const Datagram &dgram = tx_wheel.ready.front();
+        ::sendto(fd, dgram.data.data(), dgram.data.size(), 0,
+                 reinterpret_cast<const sockaddr *>(&dgram.addr),
+                 sizeof(dgram.addr));
+        record(tx_stats, dgram, now);
+        tx_wheel.ready.pop_front();
+    }
+}
+
+
+void SocketUDP::drain_recv(int64_t now) {
+    uint8_t buf[65536];
+    while (wait_readable(0)) {
+        Datagram dgram;
+        const ssize_t n = read_datagram(buf, sizeof(buf), dgram.addr);
+        if (n < 0) {
+            break;
+        }
+        dgram.data.assign(buf, buf + n);
+        dgram.enqueued_us = now;
+        impair(std::move(dgram), rx_wheel, rx_stats);
+    }
+}
+
+
+ssize_t SocketUDP::recv_impaired(void *buf, size_t size, uint32_t timeout_ms) {
+    const int64_t deadline = now_us() + int64_t(timeout_ms) * 1000;
+    while (true) {
+        const int64_t now = now_us();
+        drain_recv(now);
+        rx_wheel.advance(now);
+        if (!rx_wheel.ready.empty()) {
+            const Datagram &dgram = rx_wheel.ready.front();
+            const size_t n = std::min(size, dgram.data.size());
+            memcpy(buf, dgram.data.data(), n);
+            in_addr = dgram.addr;
+            record(rx_stats, dgram, now);
+            rx_wheel.ready.pop_front();
+            return static_cast<ssize_t>(n);
+        }
+        flush_send(now);
+        if (now >= deadline) {
+            return -1;
+        }
+
+        // sleep until new data, the next delayed datagram or the deadline
+        int64_t wake = deadline;
+        const int64_t rx_due = rx_wheel.next_due();
+        const int64_t tx_due = tx_wheel.next_due();
+        if (rx_due >= 0) {
+            wake = std::min(wake, rx_due);
+        }
+        if (tx_due >= 0) {
+            wake = std::min(wake, tx_due);
+        }
+        const int64_t wait_us = std::max<int64_t>(wake - now, 0);
+        wait_readable(static_cast<uint32_t>((wait_us + 999) / 1000));
+    }
+}
+
+
+SocketUDP::TimingWheel::TimingWheel() : slots(kSlots) {
+    cursor_us = SocketUDP::now_us() / kSlotUs * kSlotUs;
+}
+
+
+void SocketUDP::TimingWheel::insert(Datagram &&dgram) {
+    // datagrams already due go in the current slot
+    const int64_t tick = std::max(dgram.due_us, cursor_us) / kSlotUs;
+    slots[size_t(tick) % kSlots].push_back(std::move(dgram));
+    pending++;
+}
+
+
+void SocketUDP::TimingWheel::advance(int64_t now) {
+    if (pending == 0) {
+        cursor_us = std::max(cursor_us, now / kSlotUs * kSlotUs);
+        return;
+    }
+
+    // visit each slot from the cursor to now, at most one revolution,
+    // revisiting the current slot as it may hold datagrams due later
+    // within the same millisecond
+    const int64_t first = cursor_us / kSlotUs;
+    const int64_t last = std::max(first, now / kSlotUs);
+    const int64_t count = std::min<int64_t>(last - first + 1, kSlots);
+    std::vector<Datagram> due;
+    for (int64_t tick = first; tick < first + count; ++tick) {
+        auto &slot = slots[size_t(tick) % kSlots];
+        for (size_t i = 0; i < slot.size();) {
+            if (slot[i].due_us <= now) {
+                due.push_back(std::move(slot[i]));
+                slot[i] = std::move(slot.back());
+                slot.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+    cursor_us = last * kSlotUs;
+
+    std::stable_sort(due.begin(), due.end(),
+        [](const Datagram &a, const Datagram &b) {
+            return a.due_us < b.due_us;
+        });
+    pending -= due.size();
+    for (auto &dgram : due) {
+        ready.push_back(std::move(dgram));
+    }
+}
+
+
+int64_t SocketUDP::TimingWheel::next_due() const {
+    if (!ready.empty()) {
+        return ready.front().due_us;
+    }
+    int64_t next = -1;
+    if (pending == 0) {
+        return next;
+    }
+    for (const auto &slot : slots) {
+        for (const auto &dgram : slot) {
+            if (next < 0 || dgram.due_us < next) {
+                next = dgram.due_us;
+            }
+        }
+    }
+    return next;
+}
+
+
+bool SocketUDP::set_low_latency(const UDPLowLatency &options) {
+    bool ok = true;
+    if (options.rcvbuf > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
+                   reinterpret_cast<const char *>(&options.rcvbuf),
+                   sizeof(options.rcvbuf)) != 0) {
+        perror("SocketUDP SO_RCVBUF failed");
+        ok = false;
+    }
+    if (options.sndbuf > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF,
+                   reinterpret_cast<const char *>(&options.sndbuf),
+                   sizeof(options.sndbuf)) != 0) {
+        perror("SocketUDP SO_SNDBUF failed");
+        ok = false;
+    }
+#ifdef __linux__
+    if (options.busy_poll_us > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &options.busy_poll_us,
+                   sizeof(options.busy_poll_us)) != 0) {
+        perror("SocketUDP SO_BUSY_POLL failed");
+        ok = false;
+    }
+    if (options.priority >= 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &options.priority,
+                   sizeof(options.priority)) != 0) {
+        perror("SocketUDP SO_PRIORITY failed");
+        ok = false;
+    }
+    int one = 1;
+    timestamps = setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one,
+                            sizeof(one)) == 0;
+#endif
+
+    low_latency_enabled = true;
+    reset_wakeup_stats();
+
+    if (options.spin && !spinner) {
+        spinner.reset(new SpinReceiver());
+        spinner->running = true;
+        spinner->thread = std::thread(&SocketUDP::spin_receive, this);
+#ifdef __linux__
+        if (options.spin_cpu >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(options.spin_cpu, &cpus);
+            if (pthread_setaffinity_np(spinner->thread.native_handle(),
+                                       sizeof(cpus), &cpus) != 0) {
+                fprintf(stderr, "SocketUDP failed to pin receiver to cpu %d\n",
+                        options.spin_cpu);
+                ok = false;
+            }
+        }
+#endif
+    }
+    return ok;
+}
+
+
+void SocketUDP::stop_spin_receiver() {
+    if (spinner) {
+        spinner->running = false;
+        if (spinner->thread.joinable()) {
+            spinner->thread.join();
+        }
+        spinner.reset();
+    }
+}
+
+
+void SocketUDP::spin_receive() {
+    uint8_t buf[65536];
+    while (spinner->running) {
+        Datagram dgram;
+        const ssize_t n = recv_datagram(buf, sizeof(buf), dgram.addr,
+                                        dgram.rx_ns);
+        if (n < 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        dgram.data.assign(buf, buf + n);
+        std::lock_guard<std::mutex> lock(spinner->mutex);
+        spinner->queue.push_back(std::move(dgram));
+        spinner->queued++;
+    }
+}
+
+
+bool SocketUDP::wait_readable(uint32_t timeout_ms) {
+    if (!spinner) {
+        return pollin(timeout_ms);
+    }
+
+    // spin on the receiver queue rather than sleeping in the kernel
+    const int64_t deadline = now_us() + int64_t(timeout_ms) * 1000;
+    while (spinner->queued == 0) {
+        if (now_us() >= deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+
+ssize_t SocketUDP::read_datagram(void *buf, size_t size,
+                                 struct sockaddr_in &addr) {
+    ssize_t n = -1;
+    int64_t rx_ns = -1;
+    if (spinner) {
+        std::lock_guard<std::mutex> lock(spinner->mutex);
+        if (spinner->queue.empty()) {
+            return -1;
+        }
+        const Datagram &dgram = spinner->queue.front();
+        n = static_cast<ssize_t>(std::min(size, dgram.data.size()));
+        memcpy(buf, dgram.data.data(), n);
+        addr = dgram.addr;
+        rx_ns = dgram.rx_ns;
+        spinner->queue.pop_front();
+        spinner->queued--;
+    } else {
+        n = recv_datagram(buf, size, addr, rx_ns);
+    }
+
+    if (n >= 0 && rx_ns >= 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        const double latency_us =
+            (int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec - rx_ns) * 1.0e-3;
+        wakeup.count++;
+        wakeup.sum_us += latency_us;
+        wakeup.max_us = std::max(wakeup.max_us, latency_us);
+    }
+    return n;
+}
+
+
+ssize_t SocketUDP::recv_datagram(void *buf, size_t size,
+                                 struct sockaddr_in &addr, int64_t &rx_ns) {
+    rx_ns = -1;
+#ifdef __linux__
+    if (timestamps) {
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        char control[CMSG_SPACE(sizeof(struct timespec))];
+        struct msghdr msg{};
+        msg.msg_name = &addr;
+        msg.msg_namelen = sizeof(addr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        const ssize_t n = ::recvmsg(fd, &msg, MSG_DONTWAIT);
+        if (n < 0) {
+            return n;
+        }
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                rx_ns = int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+            }
+        }
+        return n;
+    }
+#endif
+    socklen_t len = sizeof(addr);
+    return ::recvfrom(fd, static_cast<char *>(buf), size, MSG_DONTWAIT,
+                      reinterpret_cast<sockaddr *>(&addr), &len);
+}
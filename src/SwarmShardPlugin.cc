@@ -0,0 +1,635 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SwarmShardPlugin.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gz/common/Console.hh>
+#include <gz/common/Profiler.hh>
+#include <gz/math/Pose3.hh>
+#include <gz/math/Vector3.hh>
+#include <gz/plugin/Register.hh>
+#include <gz/sim/components/Model.hh>
+#include <gz/sim/components/Name.hh>
+#include <gz/sim/components/ParentEntity.hh>
+#include <gz/sim/components/World.hh>
+#include <gz/sim/Link.hh>
+#include <gz/sim/Model.hh>
+#include <gz/sim/SdfEntityCreator.hh>
+#include <gz/sim/Util.hh>
+
+#include <sdf/Root.hh>
+
+#include "SocketUDP.hh"
+#include "SwarmShardFrame.hh"
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+//////////////////////////////////////////////////
+class SwarmShardPlugin::Impl
+{
+  /// \brief Instance number of a vehicle model name, -1 if it is not one.
+  public: int64_t Instance(const std::string &_name) const;
+
+  /// \brief Track the local vehicles as models are added and removed.
+  public: void UpdateVehicles(EntityComponentManager &_ecm);
+
+  /// \brief Receive frames from the other shards until every shard that
+  /// is not skipped has sent sync step _step, or for _timeoutMs if zero.
+  public: void Receive(uint64_t _step, uint32_t _timeoutMs);
+
+  /// \brief Handle a received datagram.
+  public: void HandleFrame(const uint8_t *_buf, size_t _size);
+
+  /// \brief Create ghosts for new remote vehicles, move them all and
+  /// remove the ones not heard from within ghostTimeout.
+  public: void UpdateGhosts(EntityComponentManager &_ecm);
+
+  /// \brief State of another shard.
+  public: struct Peer
+  {
+    /// \brief Last sync step received, -1 for none.
+    int64_t step{-1};
+
+    /// \brief Not waited for until heard from again.
+    bool skipped{false};
+  };
+
+  /// \brief A vehicle of another shard.
+  public: struct Ghost
+  {
+    Entity entity{kNullEntity};
+    math::Pose3d pose;
+    bool moved{false};
+
+    /// \brief Local simulation time the pose was last received (ns).
+    int64_t lastSeen{0};
+  };
+
+  /// \brief Socket of the shard bus.
+  public: SocketUDP sock{true, true};
+
+  /// \brief Bus address and base port.
+  public: std::string busAddress{"127.0.0.1"};
+  public: uint16_t busPort{9700};
+
+  /// \brief Index of this shard and the number of shards.
+  public: uint32_t shard{0};
+  public: uint32_t shards{1};
+
+  /// \brief The other shards, indexed by shard.
+  public: std::vector<Peer> peers;
+
+  /// \brief Sync period in simulation time (ns).
+  public: int64_t syncPeriod{10000000};
+
+  /// \brief Wall time to wait for a shard (ms).
+  public: uint32_t syncTimeoutMs{2000};
+
+  /// \brief Sync step last sent, waited for in the next PreUpdate, -1
+  /// for none.
+  public: int64_t pendingStep{-1};
+
+  /// \brief Next sync step to send.
+  public: int64_t nextStep{0};
+
+  /// \brief Name prefix of vehicle models.
+  public: std::string vehiclePrefix{"iris_"};
+
+  /// \brief Local vehicles by instance.
+  public: std::map<uint32_t, Entity> vehicles;
+
+  /// \brief Remote vehicles by instance.
+  public: std::unordered_map<uint32_t, Ghost> ghosts;
+
+  /// \brief Ghost box size.
+  public: math::Vector3d ghostSize{0.6, 0.6, 0.25};
+
+  /// \brief Simulation time after which a ghost that is not heard from
+  /// is removed (ns).
+  public: int64_t ghostTimeout{2000000000};
+
+  /// \brief Local simulation time of the current update (ns).
+  public: int64_t simTime{0};
+
+  /// \brief The world entity.
+  public: Entity world{kNullEntity};
+
+  /// \brief Creates the ghost models.
+  public: std::unique_ptr<SdfEntityCreator> creator;
+
+  /// \brief Frame buffers.
+  public: std::vector<uint8_t> sendBuffer;
+  public: std::vector<uint8_t> recvBuffer;
+
+  /// \brief Set once the vehicles present at start are found.
+  public: bool vehiclesInitialized{false};
+
+  /// \brief Set if the plugin is attached to a world and bound.
+  public: bool validConfig{false};
+};
+
+//////////////////////////////////////////////////
+int64_t SwarmShardPlugin::Impl::Instance(const std::string &_name) const
+{
+  if (_name.size() <= this->vehiclePrefix.size() ||
+      _name.compare(0, this->vehiclePrefix.size(), this->vehiclePrefix) != 0)
+  {
+    return -1;
+  }
+  const std::string digits = _name.substr(this->vehiclePrefix.size());
+  if (digits.size() > 9 ||
+      digits.find_first_not_of("0123456789") != std::string::npos)
+  {
+    return -1;
+  }
+  return std::stoll(digits);
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::Impl::UpdateVehicles(EntityComponentManager &_ecm)
+{
+  auto add = [&](const Entity &_entity,
+                 const components::Model *,
+                 const components::Name *_name,
+                 const components::ParentEntity *_parent) -> bool
+  {
+    const int64_t instance = this->Instance(_name->Data());
+    if (_parent->Data() == this->world && instance >= 0)
+    {
+      this->vehicles[static_cast<uint32_t>(instance)] = _entity;
+    }
+    return true;
+  };
+
+  if (!this->vehiclesInitialized)
+  {
+    _ecm.Each<components::Model, components::Name,
+              components::ParentEntity>(add);
+    this->vehiclesInitialized = true;
+    gzmsg << "SwarmShardPlugin: shard " << this->shard << " of "
+          << this->shards << " has " << this->vehicles.size()
+          << " vehicles.\n";
+  }
+  else
+  {
+    _ecm.EachNew<components::Model, components::Name,
+                 components::ParentEntity>(add);
+  }
+
+  _ecm.EachRemoved<components::Model>(
+      [&](const Entity &_entity, const components::Model *) -> bool
+      {
+        for (auto it = this->vehicles.begin(); it != this->vehicles.end();
+             ++it)
+        {
+          if (it->second == _entity)
+          {
+            this->vehicles.erase(it);
+            break;
+          }
+        }
+        return true;
+      });
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::Impl::Receive(uint64_t _step, uint32_t _timeoutMs)
+{
+  auto waiting = [&]()
+  {
+    for (uint32_t i = 0; i < this->shards; ++i)
+    {
+      const Peer &peer = this->peers[i];
+      if (i != this->shard && !peer.skipped &&
+          peer.step < static_cast<int64_t>(_step))
+      {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  const auto deadline = std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(_timeoutMs);
+  while (true)
+  {
+    const bool wait = _timeoutMs > 0 && waiting();
+    uint32_t timeoutMs = 0;
+    if (wait)
+    {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now()).count();
+      if (left <= 0)
+      {
+        break;
+      }
+      timeoutMs = static_cast<uint32_t>(left);
+    }
+
+    const ssize_t size = this->sock.recv(this->recvBuffer.data(),
+        this->recvBuffer.size(), timeoutMs);
+    if (size < 0)
+    {
+      if (!wait)
+      {
+        return;
+      }
+      continue;
+    }
+    this->HandleFrame(this->recvBuffer.data(), static_cast<size_t>(size));
+  }
+
+  // skip the shards that did not answer in time
+  for (uint32_t i = 0; i < this->shards; ++i)
+  {
+    Peer &peer = this->peers[i];
+    if (i != this->shard && !peer.skipped &&
+        peer.step < static_cast<int64_t>(_step))
+    {
+      peer.skipped = true;
+      gzwarn << "SwarmShardPlugin: shard " << i << " did not reach sync"
+             << " step " << _step << ", continuing without it.\n";
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::Impl::HandleFrame(const uint8_t *_buf, size_t _size)
+{
+  swarm_shard_header_v1 header;
+  if (!decode_swarm_shard_header(_buf, _size, header) ||
+      header.shard >= this->shards || header.shard == this->shard)
+  {
+    return;
+  }
+
+  Peer &peer = this->peers[header.shard];
+  const int64_t step =
+      static_cast<int64_t>(header.sim_time) / this->syncPeriod;
+  // a skipped shard is waited for again once it has caught up
+  if (peer.skipped && step + 1 >= this->nextStep)
+  {
+    gzmsg << "SwarmShardPlugin: shard " << static_cast<int>(header.shard)
+          << " is back at sync step " << step << ".\n";
+    peer.skipped = false;
+  }
+  peer.step = step;
+
+  for (size_t i = 0; i < header.count; ++i)
+  {
+    swarm_shard_vehicle_v1 vehicle;
+    decode_swarm_shard_vehicle(_buf, i, vehicle);
+    Ghost &ghost = this->ghosts[vehicle.instance];
+    ghost.pose = math::Pose3d(
+        vehicle.position[0], vehicle.position[1], vehicle.position[2],
+        vehicle.quaternion[0], vehicle.quaternion[1],
+        vehicle.quaternion[2], vehicle.quaternion[3]);
+    ghost.moved = true;
+    ghost.lastSeen = this->simTime;
+  }
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::Impl::UpdateGhosts(EntityComponentManager &_ecm)
+{
+  // remove the ghosts of vehicles that stopped or whose shard went away
+  for (auto it = this->ghosts.begin(); it != this->ghosts.end();)
+  {
+    Ghost &ghost = it->second;
+
+    // time went back, e.g. on a reset
+    ghost.lastSeen = std::min(ghost.lastSeen, this->simTime);
+    if (this->simTime - ghost.lastSeen <= this->ghostTimeout)
+    {
+      ++it;
+      continue;
+    }
+
+    if (ghost.entity != kNullEntity)
+    {
+      gzmsg << "SwarmShardPlugin: removing ghost of "
+            << this->vehiclePrefix << it->first
+            << ", not heard from.\n";
+      this->creator->RequestRemoveEntity(ghost.entity);
+    }
+    it = this->ghosts.erase(it);
+  }
+
+  for (auto &item : this->ghosts)
+  {
+    Ghost &ghost = item.second;
+    if (!ghost.moved)
+    {
+      continue;
+    }
+    ghost.moved = false;
+
+    // a vehicle also simulated here is not a ghost
+    if (this->vehicles.count(item.first) > 0)
+    {
+      continue;
+    }
+
+    if (ghost.entity == kNullEntity)
+    {
+      const std::string name =
+          "ghost_" + this->vehiclePrefix + std::to_string(item.first);
+      const math::Pose3d &p = ghost.pose;
+      std::ostringstream size;
+      size << this->ghostSize;
+      std::ostringstream pose;
+      pose << p;
+
+      std::ostringstream sdfStr;
+      sdfStr
+        << "<?xml version='1.0'?>"
+        << "<sdf version='1.9'>"
+        << "<model name='" << name << "'>"
+        << "<pose>" << pose.str() << "</pose>"
+        << "<link name='link'>"
+        << "<kinematic>true</kinematic>"
+        << "<gravity>false</gravity>"
+        << "<collision name='collision'><geometry><box><size>"
+        << size.str() << "</size></box></geometry></collision>"
+        << "<visual name='visual'><geometry><box><size>"
+        << size.str() << "</size></box></geometry>"
+        << "<material><ambient>0.3 0.3 1 0.5</ambient>"
+        << "<diffuse>0.3 0.3 1 0.5</diffuse></material>"
+        << "<transparency>0.5</transparency></visual>"
+        << "</link></model></sdf>";
+
+      sdf::Root root;
+      const sdf::Errors errors = root.LoadSdfString(sdfStr.str());
+      if (!errors.empty() || root.Model() == nullptr)
+      {
+        gzerr << "SwarmShardPlugin: failed to create ghost [" << name
+              << "].\n";
+        continue;
+      }
+      ghost.entity = this->creator->CreateEntities(root.Model());
+      this->creator->SetParent(ghost.entity, this->world);
+      continue;
+    }
+
+    // kinematic links keep no contact velocity, reset it anyway for
+    // physics engines that treat them as dynamic
+    Model model(ghost.entity);
+    model.SetWorldPoseCmd(_ecm, ghost.pose);
+    for (const Entity link : model.Links(_ecm))
+    {
+      Link(link).SetLinearVelocity(_ecm, math::Vector3d::Zero);
+      Link(link).SetAngularVelocity(_ecm, math::Vector3d::Zero);
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+SwarmShardPlugin::~SwarmShardPlugin() = default;
+
+//////////////////////////////////////////////////
+SwarmShardPlugin::SwarmShardPlugin()
+    : impl(std::make_unique<SwarmShardPlugin::Impl>())
+{
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::Configure(
+    const Entity &_entity,
+    const std::shared_ptr<const sdf::Element> &_sdf,
+    EntityComponentManager &_ecm,
+    EventManager &_eventMgr)
+{
+  if (!_ecm.Component<components::World>(_entity))
+  {
+    gzerr << "SwarmShardPlugin should be attached to a world. "
+          << "Failed to initialize.\n";
+    return;
+  }
+  this->impl->world = _entity;
+
+  this->impl->shard = _sdf->Get<uint32_t>("shard", 0).first;
+  this->impl->shards = _sdf->Get<uint32_t>("shards", 1).first;
+  if (this->impl->shards < 1 || this->impl->shards > 255 ||
+      this->impl->shard >= this->impl->shards)
+  {
+    gzerr << "SwarmShardPlugin: <shard> [" << this->impl->shard
+          << "] must be less than <shards> [" << this->impl->shards
+          << "], at most 255. Failed to initialize.\n";
+    return;
+  }
+
+  this->impl->busAddress = _sdf->Get<std::string>(
+      "bus_address", this->impl->busAddress).first;
+  this->impl->busPort = static_cast<uint16_t>(_sdf->Get<uint32_t>(
+      "bus_port", this->impl->busPort).first);
+  const double syncPeriod =
+      _sdf->Get<double>("sync_period", 0.01).first;
+  const double syncTimeout =
+      _sdf->Get<double>("sync_timeout", 2.0).first;
+  const double ghostTimeout =
+      _sdf->Get<double>("ghost_timeout", 2.0).first;
+  this->impl->vehiclePrefix = _sdf->Get<std::string>(
+      "vehicle_prefix", this->impl->vehiclePrefix).first;
+  this->impl->ghostSize = _sdf->Get<math::Vector3d>(
+      "ghost_size", this->impl->ghostSize).first;
+
+  if (syncPeriod <= 0.0)
+  {
+    gzerr << "SwarmShardPlugin: <sync_period> must be positive. "
+          << "Failed to initialize.\n";
+    return;
+  }
+  this->impl->syncPeriod = static_cast<int64_t>(syncPeriod * 1e9);
+  this->impl->syncTimeoutMs =
+      static_cast<uint32_t>(std::max(syncTimeout, 0.0) * 1000.0);
+  this->impl->ghostTimeout =
+      static_cast<int64_t>(std::max(ghostTimeout, 0.0) * 1e9);
+
+  const uint32_t port = this->impl->busPort + this->impl->shard;
+  if (port + this->impl->shards - this->impl->shard > 65536 ||
+      !this->impl->sock.bind(this->impl->busAddress.c_str(),
+          static_cast<uint16_t>(port)))
+  {
+    gzerr << "SwarmShardPlugin: failed to bind with "
+          << this->impl->busAddress << ":" << port
+          << ". Failed to initialize.\n";
+    return;
+  }
+
+  this->impl->peers.assign(this->impl->shards, Impl::Peer());
+  this->impl->creator = std::make_unique<SdfEntityCreator>(_ecm, _eventMgr);
+  this->impl->sendBuffer.reserve(
+      swarm_shard_frame_size(kSwarmShardMaxVehicles));
+  this->impl->recvBuffer.resize(
+      swarm_shard_frame_size(kSwarmShardMaxVehicles));
+
+  gzmsg << "SwarmShardPlugin: shard " << this->impl->shard << " of "
+        << this->impl->shards << " on " << this->impl->busAddress << ":"
+        << port << ", sync every " << syncPeriod << " s\n";
+  this->impl->validConfig = true;
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::PreUpdate(
+    const UpdateInfo &_info,
+    EntityComponentManager &_ecm)
+{
+  GZ_PROFILE("SwarmShardPlugin::PreUpdate");
+
+  if (!this->impl->validConfig)
+  {
+    return;
+  }
+
+  this->impl->UpdateVehicles(_ecm);
+
+  if (_info.paused)
+  {
+    return;
+  }
+
+  this->impl->simTime =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          _info.simTime).count();
+
+  // wait at the barrier for the step sent last, otherwise take what
+  // has arrived
+  if (this->impl->pendingStep >= 0)
+  {
+    this->impl->Receive(static_cast<uint64_t>(this->impl->pendingStep),
+        this->impl->syncTimeoutMs);
+    this->impl->pendingStep = -1;
+  }
+  else
+  {
+    this->impl->Receive(0, 0);
+  }
+
+  this->impl->UpdateGhosts(_ecm);
+}
+
+//////////////////////////////////////////////////
+void SwarmShardPlugin::PostUpdate(
+    const UpdateInfo &_info,
+    const EntityComponentManager &_ecm)
+{
+  GZ_PROFILE("SwarmShardPlugin::PostUpdate");
+
+  if (!this->impl->validConfig || _info.paused)
+  {
+    return;
+  }
+
+  const int64_t simTime =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          _info.simTime).count();
+  const int64_t step = simTime / this->impl->syncPeriod;
+
+  // restart the schedule if time went back, e.g. on a reset
+  if (step + 1 < this->impl->nextStep)
+  {
+    this->impl->nextStep = step;
+    for (auto &peer : this->impl->peers)
+    {
+      peer.step = -1;
+    }
+  }
+  if (step < this->impl->nextStep)
+  {
+    return;
+  }
+  this->impl->nextStep = step + 1;
+
+  // the state of the local vehicles at this step
+  auto &buffer = this->impl->sendBuffer;
+  const size_t count = std::min<size_t>(
+      this->impl->vehicles.size(), kSwarmShardMaxVehicles);
+  buffer.resize(swarm_shard_frame_size(count));
+
+  swarm_shard_header_v1 header{};
+  header.magic = kSwarmShardMagic;
+  header.version = kSwarmShardVersion;
+  header.shard = static_cast<uint8_t>(this->impl->shard);
+  header.count = static_cast<uint16_t>(count);
+  header.sim_time = static_cast<uint64_t>(simTime);
+  std::memcpy(buffer.data(), &header, sizeof(header));
+
+  size_t i = 0;
+  for (const auto &item : this->impl->vehicles)
+  {
+    if (i == count)
+    {
+      break;
+    }
+    const math::Pose3d pose = worldPose(item.second, _ecm);
+    swarm_shard_vehicle_v1 vehicle;
+    vehicle.instance = item.first;
+    vehicle.position[0] = static_cast<float>(pose.Pos().X());
+    vehicle.position[1] = static_cast<float>(pose.Pos().Y());
+    vehicle.position[2] = static_cast<float>(pose.Pos().Z());
+    vehicle.quaternion[0] = static_cast<float>(pose.Rot().W());
+    vehicle.quaternion[1] = static_cast<float>(pose.Rot().X());
+    vehicle.quaternion[2] = static_cast<float>(pose.Rot().Y());
+    vehicle.quaternion[3] = static_cast<float>(pose.Rot().Z());
+    std::memcpy(buffer.data() + swarm_shard_frame_size(i), &vehicle,
+        sizeof(vehicle));
+    ++i;
+  }
+
+  for (uint32_t s = 0; s < this->impl->shards; ++s)
+  {
+    if (s != this->impl->shard)
+    {
+      this->impl->sock.sendto(buffer.data(), buffer.size(),
+          this->impl->busAddress.c_str(),
+          static_cast<uint16_t>(this->impl->busPort + s));
+    }
+  }
+  this->impl->pendingStep = step;
+}
+
+//////////////////////////////////////////////////
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+GZ_ADD_PLUGIN(
+    gz::sim::systems::SwarmShardPlugin,
+    gz::sim::System,
+    gz::sim::systems::SwarmShardPlugin::ISystemConfigure,
+    gz::sim::systems::SwarmShardPlugin::ISystemPreUpdate,
+    gz::sim::systems::SwarmShardPlugin::ISystemPostUpdate)
+
+GZ_ADD_PLUGIN_ALIAS(
+    gz::sim::systems::SwarmShardPlugin,
+    "SwarmShardPlugin")
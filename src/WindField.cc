@@ -0,0 +1,184 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WindField.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+/// \brief Feet per metre, the Dryden scales are defined in feet.
+constexpr double kFtPerM = 3.28084;
+
+/// \brief Lowest speed (m/s) used to advance the frozen turbulence.
+constexpr double kMinTurbulenceSpeed = 1.0;
+}  // namespace
+
+WindField::WindField(const Params &_params)
+    : params(_params),
+      rng(_params.seed)
+{
+    params.referenceHeight = std::max(params.referenceHeight, 1.0e-3);
+    params.minHeight = std::max(params.minHeight, 1.0e-3);
+    params.turbulenceIntensity = std::max(params.turbulenceIntensity, 0.0);
+}
+
+void WindField::Remap(const std::vector<int> &_from)
+{
+    const size_t n = _from.size();
+    std::vector<double> u(n, 0.0), v(n, 0.0), w(n, 0.0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const int j = _from[i];
+        if (j >= 0 && static_cast<size_t>(j) < tu.size())
+        {
+            u[i] = tu[j];
+            v[i] = tv[j];
+            w[i] = tw[j];
+        }
+    }
+    tu.swap(u);
+    tv.swap(v);
+    tw.swap(w);
+
+    for (auto *a : {&batch.x, &batch.y, &batch.z,
+                    &batch.vx, &batch.vy, &batch.vz,
+                    &batch.wx, &batch.wy, &batch.wz,
+                    &nu, &nv, &nw})
+    {
+        a->assign(n, 0.0);
+    }
+}
+
+size_t WindField::Size() const
+{
+    return tu.size();
+}
+
+WindField::Batch &WindField::Points()
+{
+    return batch;
+}
+
+double WindField::GustFactor(double _time) const
+{
+    if (params.gustDuration <= 0.0 || _time < params.gustStart)
+    {
+        return 0.0;
+    }
+    double t = _time - params.gustStart;
+    if (params.gustPeriod > 0.0)
+    {
+        t = std::fmod(t, params.gustPeriod);
+    }
+    if (t > params.gustDuration)
+    {
+        return 0.0;
+    }
+    return 0.5 * (1.0 - std::cos(2.0 * M_PI * t / params.gustDuration));
+}
+
+void WindField::ReferenceWind(double _time, double _wind[3]) const
+{
+    const double gust = GustFactor(_time);
+    for (int k = 0; k < 3; ++k)
+    {
+        _wind[k] = params.meanVelocity[k] + gust * params.gustVelocity[k];
+    }
+}
+
+void WindField::Update(double _time, double _dt)
+{
+    const size_t n = Size();
+    const double dt = std::max(_dt, 0.0);
+
+    // terms common to all points
+    double gust[3];
+    const double g = GustFactor(_time);
+    for (int k = 0; k < 3; ++k)
+    {
+        gust[k] = g * params.gustVelocity[k];
+    }
+    const double mx = params.meanVelocity[0];
+    const double my = params.meanVelocity[1];
+    const double mz = params.meanVelocity[2];
+    const double mh = std::sqrt(mx * mx + my * my);
+    const double ex = mh > 0.0 ? mx / mh : 1.0;
+    const double ey = mh > 0.0 ? my / mh : 0.0;
+    const double sigmaW = params.turbulenceIntensity;
+    const double alpha = params.shearExponent;
+    const double invRef = 1.0 / params.referenceHeight;
+    const double minHeight = params.minHeight;
+
+    // draw the noise first so the per-point loop has no dependencies
+    if (sigmaW > 0.0)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            nu[i] = normal(rng);
+            nv[i] = normal(rng);
+            nw[i] = normal(rng);
+        }
+    }
+
+    const double *z = batch.z.data();
+    const double *vx = batch.vx.data();
+    const double *vy = batch.vy.data();
+    const double *vz = batch.vz.data();
+    double *wx = batch.wx.data();
+    double *wy = batch.wy.data();
+    double *wz = batch.wz.data();
+    double *u = tu.data();
+    double *v = tv.data();
+    double *w = tw.data();
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        // mean wind with power law shear
+        const double h = std::max(z[i], minHeight);
+        const double shear = std::pow(h * invRef, alpha);
+        const double ux = mx * shear;
+        const double uy = my * shear;
+
+        // MIL-F-8785C low altitude scales, altitude in [10, 1000] ft
+        const double hFt = std::min(std::max(z[i] * kFtPerM, 10.0), 1000.0);
+        const double k = 0.177 + 0.000823 * hFt;
+        const double sigmaU = sigmaW / std::pow(k, 0.4);
+        const double lw = hFt / kFtPerM;
+        const double lu = lw / std::pow(k, 1.2);
+
+        // frozen turbulence advected at the speed relative to the air
+        const double rx = vx[i] - ux;
+        const double ry = vy[i] - uy;
+        const double rz = vz[i] - mz;
+        const double speed = std::max(
+            std::sqrt(rx * rx + ry * ry + rz * rz), kMinTurbulenceSpeed);
+        const double au = std::exp(-speed * dt / lu);
+        const double aw = std::exp(-speed * dt / lw);
+        const double bu = sigmaU * std::sqrt(1.0 - au * au);
+        const double bw = sigmaW * std::sqrt(1.0 - aw * aw);
+        u[i] = au * u[i] + bu * nu[i];
+        v[i] = au * v[i] + bu * nv[i];
+        w[i] = aw * w[i] + bw * nw[i];
+
+        // rotate the turbulence from the wind axes to the world frame
+        wx[i] = ux + gust[0] + ex * u[i] - ey * v[i];
+        wy[i] = uy + gust[1] + ey * u[i] + ex * v[i];
+        wz[i] = mz + gust[2] + w[i];
+    }
+}
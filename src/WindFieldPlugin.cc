@@ -0,0 +1,276 @@
+/*
+   Copyright (C) 2024 ardupilot.org
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WindFieldPlugin.hh"
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <gz/common/Console.hh>
+#include <gz/common/Profiler.hh>
+#include <gz/math/Pose3.hh>
+#include <gz/math/Vector3.hh>
+#include <gz/plugin/Register.hh>
+#include <gz/sim/components/LinearVelocity.hh>
+#include <gz/sim/components/Pose.hh>
+#include <gz/sim/components/Wind.hh>
+#include <gz/sim/components/World.hh>
+#include <gz/sim/Util.hh>
+
+#include "WindField.hh"
+#include "WindFieldComponents.hh"
+
+namespace gz {
+namespace sim {
+inline namespace GZ_SIM_VERSION_NAMESPACE {
+namespace systems {
+
+//////////////////////////////////////////////////
+class WindFieldPlugin::Impl
+{
+  /// \brief Match the batch to the entities requesting the wind,
+  /// keeping the turbulence state of the entities already present.
+  public: void Remap(const std::vector<Entity> &_entities);
+
+  /// \brief The world entity.
+  public: Entity worldEntity{kNullEntity};
+
+  /// \brief The wind field, null if the plugin is not configured.
+  public: std::unique_ptr<WindField> field;
+
+  /// \brief Entities in batch order.
+  public: std::vector<Entity> entities;
+
+  /// \brief Entities found in the current step, reused between steps.
+  public: std::vector<Entity> current;
+
+  /// \brief Set the global wind to the wind at the reference height.
+  public: bool updateGlobalWind{false};
+
+  /// \brief Simulation time of the previous update.
+  public: std::chrono::steady_clock::duration lastUpdateTime{0};
+};
+
+//////////////////////////////////////////////////
+void WindFieldPlugin::Impl::Remap(const std::vector<Entity> &_entities)
+{
+  std::unordered_map<Entity, int> previous;
+  for (size_t i = 0; i < this->entities.size(); ++i)
+  {
+    previous[this->entities[i]] = static_cast<int>(i);
+  }
+
+  std::vector<int> from(_entities.size(), -1);
+  for (size_t i = 0; i < _entities.size(); ++i)
+  {
+    auto it = previous.find(_entities[i]);
+    if (it != previous.end())
+    {
+      from[i] = it->second;
+    }
+  }
+
+  this->field->Remap(from);
+  this->entities = _entities;
+}
+
+//////////////////////////////////////////////////
+WindFieldPlugin::~WindFieldPlugin() = default;
+
+//////////////////////////////////////////////////
+WindFieldPlugin::WindFieldPlugin()
+    : impl(std::make_unique<WindFieldPlugin::Impl>())
+{
+}
+
+//////////////////////////////////////////////////
+void WindFieldPlugin::Configure(
+    const Entity &_entity,
+    const std::shared_ptr<const sdf::Element> &_sdf,
+    EntityComponentManager &_ecm,
+    EventManager &)
+{
+  if (!_ecm.Component<components::World>(_entity))
+  {
+    gzerr << "WindFieldPlugin should be attached to a world. "
+          << "Failed to initialize.\n";
+    return;
+  }
+  this->impl->worldEntity = _entity;
+
+  auto sdfClone = _sdf->Clone();
+
+  WindField::Params params;
+  auto setVector = [](const math::Vector3d &_v, double _out[3])
+  {
+    _out[0] = _v.X();
+    _out[1] = _v.Y();
+    _out[2] = _v.Z();
+  };
+
+  setVector(sdfClone->Get<math::Vector3d>("mean_velocity",
+      math::Vector3d::Zero).first, params.meanVelocity);
+  params.referenceHeight = sdfClone->Get<double>("reference_height",
+      params.referenceHeight).first;
+  params.shearExponent = sdfClone->Get<double>("shear_exponent",
+      params.shearExponent).first;
+
+  if (sdfClone->HasElement("gust"))
+  {
+    auto gustElem = sdfClone->GetElement("gust");
+    setVector(gustElem->Get<math::Vector3d>("velocity",
+        math::Vector3d::Zero).first, params.gustVelocity);
+    params.gustStart = gustElem->Get<double>("start",
+        params.gustStart).first;
+    params.gustDuration = gustElem->Get<double>("duration",
+        params.gustDuration).first;
+    params.gustPeriod = gustElem->Get<double>("period",
+        params.gustPeriod).first;
+  }
+
+  if (sdfClone->HasElement("turbulence"))
+  {
+    auto turbulenceElem = sdfClone->GetElement("turbulence");
+    params.turbulenceIntensity = turbulenceElem->Get<double>("intensity",
+        params.turbulenceIntensity).first;
+    params.seed = turbulenceElem->Get<uint32_t>("seed",
+        params.seed).first;
+  }
+
+  this->impl->updateGlobalWind = sdfClone->Get<bool>("update_global_wind",
+      this->impl->updateGlobalWind).first;
+
+  this->impl->field = std::make_unique<WindField>(params);
+
+  // mark the world so consumers know the wind field is running
+  double wind[3];
+  this->impl->field->ReferenceWind(0.0, wind);
+  _ecm.SetComponentData<components::WindFieldVelocity>(
+      this->impl->worldEntity, math::Vector3d(wind[0], wind[1], wind[2]));
+
+  gzmsg << "WindFieldPlugin: mean wind "
+        << math::Vector3d(params.meanVelocity[0], params.meanVelocity[1],
+            params.meanVelocity[2])
+        << " m/s at " << params.referenceHeight << " m, turbulence "
+        << params.turbulenceIntensity << " m/s\n";
+}
+
+//////////////////////////////////////////////////
+void WindFieldPlugin::PreUpdate(
+    const UpdateInfo &_info,
+    EntityComponentManager &_ecm)
+{
+  GZ_PROFILE("WindFieldPlugin::PreUpdate");
+
+  if (!this->impl->field || _info.paused)
+  {
+    return;
+  }
+
+  // entities requesting the wind, in a stable order
+  auto &current = this->impl->current;
+  current.clear();
+  _ecm.Each<components::WindFieldVelocity>(
+      [&](const Entity &_entity,
+          const components::WindFieldVelocity *) -> bool
+      {
+        if (_entity != this->impl->worldEntity)
+        {
+          current.push_back(_entity);
+        }
+        return true;
+      });
+  if (current != this->impl->entities)
+  {
+    this->impl->Remap(current);
+  }
+
+  // gather positions and velocities
+  auto &field = *this->impl->field;
+  auto &points = field.Points();
+  for (size_t i = 0; i < this->impl->entities.size(); ++i)
+  {
+    const Entity entity = this->impl->entities[i];
+    auto poseComp = _ecm.Component<components::WorldPose>(entity);
+    auto velComp = _ecm.Component<components::WorldLinearVelocity>(entity);
+    if (!poseComp || !velComp)
+    {
+      // updated by physics from the next step
+      enableComponent<components::WorldPose>(_ecm, entity, true);
+      enableComponent<components::WorldLinearVelocity>(_ecm, entity, true);
+    }
+    const math::Vector3d pos = poseComp ?
+        poseComp->Data().Pos() : worldPose(entity, _ecm).Pos();
+    const math::Vector3d vel = velComp ?
+        velComp->Data() : math::Vector3d::Zero;
+    points.x[i] = pos.X();
+    points.y[i] = pos.Y();
+    points.z[i] = pos.Z();
+    points.vx[i] = vel.X();
+    points.vy[i] = vel.Y();
+    points.vz[i] = vel.Z();
+  }
+
+  const double time = std::chrono::duration<double>(_info.simTime).count();
+  const double dt = std::chrono::duration<double>(
+      _info.simTime - this->impl->lastUpdateTime).count();
+  this->impl->lastUpdateTime = _info.simTime;
+  field.Update(time, dt);
+
+  // write back
+  for (size_t i = 0; i < this->impl->entities.size(); ++i)
+  {
+    auto windComp = _ecm.Component<components::WindFieldVelocity>(
+        this->impl->entities[i]);
+    windComp->Data().Set(points.wx[i], points.wy[i], points.wz[i]);
+  }
+
+  double wind[3];
+  field.ReferenceWind(time, wind);
+  const math::Vector3d refWind(wind[0], wind[1], wind[2]);
+  _ecm.Component<components::WindFieldVelocity>(
+      this->impl->worldEntity)->Data() = refWind;
+
+  if (this->impl->updateGlobalWind)
+  {
+    auto windEntity = _ecm.EntityByComponents(components::Wind());
+    if (windEntity != kNullEntity)
+    {
+      _ecm.SetComponentData<components::WorldLinearVelocity>(
+          windEntity, refWind);
+    }
+  }
+}
+
+//////////////////////////////////////////////////
+
+}  // namespace systems
+}
+}  // namespace sim
+}  // namespace gz
+
+GZ_ADD_PLUGIN(
+    gz::sim::systems::WindFieldPlugin,
+    gz::sim::System,
+    gz::sim::systems::WindFieldPlugin::ISystemConfigure,
+    gz::sim::systems::WindFieldPlugin::ISystemPreUpdate)
+
+GZ_ADD_PLUGIN_ALIAS(
+    gz::sim::systems::WindFieldPlugin,
+    "WindFieldPlugin")
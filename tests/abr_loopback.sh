@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+#
+# Loopback receiver for the GstCameraPlugin adaptive bitrate mode.
+#
+# Receives the RTP stream from the plugin through a netsim element that
+# limits the link rate and drops packets, and returns RTCP receiver
+# reports so the plugin adapts its encoder bitrate.
+#
+# Usage: abr_loopback.sh [max_kbps] [drop_probability] [udp_port]
+#
+#   max_kbps          link capacity, -1 for unlimited (default 1000)
+#   drop_probability  random packet loss in [0, 1] (default 0.0)
+#   udp_port          the plugin <udp_port> (default 5600)
+#
+# The RTCP ports follow the plugin defaults: sender reports arrive on
+# udp_port + 1 and receiver reports are sent to udp_port + 5.
+
+MAX_KBPS=${1:-1000}
+DROP=${2:-0.0}
+PORT=${3:-5600}
+HOST=127.0.0.1
+
+exec gst-launch-1.0 -v rtpbin name=rtpbin \
+    udpsrc port=${PORT} caps="application/x-rtp, media=(string)video, \
+clock-rate=(int)90000, encoding-name=(string)H264" \
+    ! netsim max-kbps=${MAX_KBPS} drop-probability=${DROP} \
+    ! rtpbin.recv_rtp_sink_0 \
+    rtpbin. ! rtph264depay ! avdec_h264 ! videoconvert \
+    ! autovideosink sync=false \
+    udpsrc port=$((PORT + 1)) ! rtpbin.recv_rtcp_sink_0 \
+    rtpbin.send_rtcp_src_0 ! udpsink host=${HOST} port=$((PORT + 5)) \
+        sync=false async=false
@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+#
+# Regression test: an ArduPilotPlugin whose FDM port is already bound must
+# log the error and stay idle, not crash the server.
+#
+# Holds the port of tests/worlds/test_rotor_model.sdf with a socket of
+# another process, runs the world for a number of iterations and checks
+# the server exits cleanly after reporting the failed bind.
+#
+# Usage: fdm_port_in_use.sh [iterations]
+#
+# Requires tests/worlds on GZ_SIM_RESOURCE_PATH and the plugins on
+# GZ_SIM_SYSTEM_PLUGIN_PATH.
+
+ITERATIONS=${1:-2000}
+PORT=9002
+WORLD=$(dirname "$0")/worlds/test_rotor_model.sdf
+LOG=$(mktemp)
+
+python3 -c "
+import socket, time
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+s.bind(('127.0.0.1', ${PORT}))
+time.sleep(3600)
+" &
+HOLDER=$!
+trap 'kill ${HOLDER} 2>/dev/null; rm -f "${LOG}"' EXIT
+sleep 1
+
+gz sim -v3 -s -r --iterations "${ITERATIONS}" "${WORLD}" > "${LOG}" 2>&1
+STATUS=$?
+
+if [ ${STATUS} -ne 0 ]; then
+    cat "${LOG}"
+    echo "FAIL: server exited with status ${STATUS}"
+    exit 1
+fi
+if ! grep -q "failed to bind" "${LOG}"; then
+    cat "${LOG}"
+    echo "FAIL: the failed bind was not reported"
+    exit 1
+fi
+echo "PASS"
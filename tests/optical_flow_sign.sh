@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+#
+# Regression test: the synthetic optical flow of a vehicle moving forward
+# at zero body rate must have the sign of the ArduPilot SITL flow sensor,
+# positive about the body y axis.
+#
+# Runs tests/worlds/test_optical_flow.sdf against the stand-in SITL peer
+# and checks the mean flow it receives.
+#
+# Usage: optical_flow_sign.sh [frames]
+#
+# Requires tests/worlds on GZ_SIM_RESOURCE_PATH and the plugins on
+# GZ_SIM_SYSTEM_PLUGIN_PATH.
+
+FRAMES=${1:-800}
+DIR=$(dirname "$0")
+LOG=$(mktemp)
+
+gz sim -v3 -s -r "${DIR}/worlds/test_optical_flow.sdf" > "${LOG}" 2>&1 &
+SERVER=$!
+trap 'kill ${SERVER} 2>/dev/null; rm -f "${LOG}"' EXIT
+sleep 5
+
+if ! python3 "${DIR}/sitl_peer.py" --count "${FRAMES}" --check-flow; then
+    cat "${LOG}"
+    exit 1
+fi
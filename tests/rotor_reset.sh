@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+#
+# Regression test: a world reset must stop the rotors of the rotor mode
+# controller, so no thrust from before the reset is applied after it.
+#
+# Runs tests/worlds/test_rotor_model.sdf at full throttle, resets the
+# world, then runs it at zero throttle and checks the vehicle stays on the
+# ground.
+#
+# Usage: rotor_reset.sh
+#
+# Requires tests/worlds on GZ_SIM_RESOURCE_PATH and the plugins on
+# GZ_SIM_SYSTEM_PLUGIN_PATH.
+
+DIR=$(dirname "$0")
+LOG=$(mktemp)
+
+gz sim -v3 -s -r "${DIR}/worlds/test_rotor_model.sdf" > "${LOG}" 2>&1 &
+SERVER=$!
+trap 'kill ${SERVER} 2>/dev/null; rm -f "${LOG}"' EXIT
+sleep 5
+
+python3 "${DIR}/sitl_peer.py" --pwm 2000 --count 800 > /dev/null
+
+gz service -s /world/test_rotor_model/control \
+    --reqtype gz.msgs.WorldControl --reptype gz.msgs.Boolean \
+    --timeout 1000 --req 'reset: {all: true}'
+sleep 1
+
+if ! python3 "${DIR}/sitl_peer.py" --pwm 1000 --count 400 \
+        --check-grounded; then
+    cat "${LOG}"
+    exit 1
+fi
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""
+Stand-in ArduPilot peer for the ArduPilotPlugin servo / state protocol.
+
+Sends servo packets to the plugin and decodes the returned state, which
+is either JSON or the binary frame defined in ArduPilotStateFrame.hh.
+
+Usage: sitl_peer.py [--format 16|32|ext] [--binary] [--port 9002]
+                    [--rate 400] [--pwm 1000] [--count 0] [--check-flow]
+                    [--check-grounded]
+
+  --format  servo packet: 16 or 32 channels, or the extended header
+  --binary  advertise the binary state (extended packets only), the
+            plugin must use <state_format>auto</state_format>
+  --count   number of frames to send, 0 to run until interrupted
+  --check-flow
+            check the optical flow of a vehicle moving forward without
+            rotating: flow about the body y axis is positive and flow
+            about the x axis is near zero. Exits 1 on failure.
+  --check-grounded
+            check the vehicle does not climb, for example at zero
+            throttle after a reset. Exits 1 on failure.
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+SERVO_MAGIC_16 = 18458
+SERVO_MAGIC_32 = 29569
+SERVO_MAGIC_EXT = 33471
+SERVO_EXT_VERSION = 1
+SERVO_EXT_FLAG_BINARY_STATE = 1
+
+STATE_BINARY_MAGIC = 30181
+STATE_BINARY_VERSION = 1
+STATE_BINARY_HEADER = struct.Struct("<HBBHBBII")
+STATE_BINARY = struct.Struct("<HBBHBBII25d")
+STATE_FLAG_WINDVANE = 1
+STATE_FLAG_OPTICAL_FLOW = 2
+STATE_FLOW = struct.Struct("<5dB7x")
+
+
+def servo_packet(fmt, binary, frame_rate, frame_count, pwm):
+    if fmt == "16":
+        return struct.pack("<HHI16H", SERVO_MAGIC_16, frame_rate,
+                           frame_count, *([pwm] * 16))
+    if fmt == "32":
+        return struct.pack("<HHI32H", SERVO_MAGIC_32, frame_rate,
+                           frame_count, *([pwm] * 32))
+    flags = SERVO_EXT_FLAG_BINARY_STATE if binary else 0
+    channels = 32
+    header = struct.pack("<HBBHHHHI", SERVO_MAGIC_EXT, SERVO_EXT_VERSION,
+                         flags, frame_rate, channels, 1, 0, frame_count)
+    return header + struct.pack("<%dH" % channels, *([pwm] * channels))
+
+
+def decode_state(data):
+    if len(data) >= STATE_BINARY.size:
+        magic, version = STATE_BINARY_HEADER.unpack_from(data)[:2]
+        if magic == STATE_BINARY_MAGIC and version == STATE_BINARY_VERSION:
+            f = STATE_BINARY.unpack_from(data)
+            (flags, range_count, frame_count) = (f[2], f[4], f[6])
+            v = f[8:]
+            state = {
+                "format": "binary",
+                "frame_count": frame_count,
+                "timestamp": v[0],
+                "imu": {"gyro": v[1:4], "accel_body": v[4:7]},
+                "position": v[7:10],
+                "quaternion": v[10:14],
+                "velocity": v[14:17],
+            }
+            for i in range(range_count):
+                state["rng_%d" % (i + 1)] = v[17 + i]
+            if flags & STATE_FLAG_WINDVANE:
+                state["windvane"] = {"direction": v[23], "speed": v[24]}
+            if flags & STATE_FLAG_OPTICAL_FLOW:
+                w = STATE_FLOW.unpack_from(data, STATE_BINARY.size)
+                state["optical_flow"] = {
+                    "flow_rate": w[0:2], "body_rate": w[2:4],
+                    "distance": w[4], "quality": w[5]}
+            return state
+    state = json.loads(data.decode("ascii"))
+    state["format"] = "json"
+    return state
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--format", choices=["16", "32", "ext"],
+                        default="16")
+    parser.add_argument("--binary", action="store_true")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=9002)
+    parser.add_argument("--rate", type=int, default=400)
+    parser.add_argument("--pwm", type=int, default=1000)
+    parser.add_argument("--count", type=int, default=0)
+    parser.add_argument("--check-flow", action="store_true")
+    parser.add_argument("--check-grounded", action="store_true")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(1.0)
+    period = 1.0 / args.rate
+    frame_count = 0
+    sizes = {}
+    flow_rates = []
+    heights = []
+    while args.count == 0 or frame_count < args.count:
+        frame_count += 1
+        sock.sendto(servo_packet(args.format, args.binary, args.rate,
+                                 frame_count, args.pwm),
+                    (args.host, args.port))
+        try:
+            data, _ = sock.recvfrom(4096)
+        except socket.timeout:
+            print("no state received")
+            continue
+        state = decode_state(data)
+        sizes[state["format"]] = len(data)
+        heights.append(-state["position"][2])
+        if "optical_flow" in state and state["optical_flow"]["quality"]:
+            flow_rates.append(state["optical_flow"]["flow_rate"])
+        if frame_count % args.rate == 0:
+            print("%s state (%d bytes): t=%.3f pos=%s" % (
+                state["format"], len(data), state["timestamp"],
+                ", ".join("%.3f" % p for p in state["position"])))
+            if "optical_flow" in state:
+                flow = state["optical_flow"]
+                print("  optical flow: rate=%s dist=%.3f quality=%d" % (
+                    ", ".join("%.3f" % r for r in flow["flow_rate"]),
+                    flow["distance"], flow["quality"]))
+        time.sleep(period)
+    print("state sizes: %s" % sizes)
+
+    if args.check_flow:
+        # skip the first half while the vehicle comes up to speed
+        samples = flow_rates[len(flow_rates) // 2:]
+        if not samples:
+            print("FAIL: no valid optical flow received")
+            sys.exit(1)
+        flow_x = sum(r[0] for r in samples) / len(samples)
+        flow_y = sum(r[1] for r in samples) / len(samples)
+        print("mean optical flow: %.3f, %.3f" % (flow_x, flow_y))
+        if flow_y <= 0.0 or abs(flow_x) > 0.5 * flow_y:
+            print("FAIL: forward motion must give positive flow about y")
+            sys.exit(1)
+        print("PASS")
+
+    if args.check_grounded:
+        if not heights:
+            print("FAIL: no state received")
+            sys.exit(1)
+        climb = max(heights) - heights[0]
+        print("maximum climb: %.3f m" % climb)
+        if climb > 0.01:
+            print("FAIL: the vehicle climbed")
+            sys.exit(1)
+        print("PASS")
+
+
+if __name__ == "__main__":
+    main()
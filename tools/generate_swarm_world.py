@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+"""
+Generate a world with N vehicles included from one model.
+
+Each vehicle is an <include> of the same model, named <prefix><N>, so
+with <instance>auto</instance> in the ArduPilotPlugin of the model the
+plugin listens on fdm_port_in + 10 * N, the port of SITL started with
+-I N. The vehicles are laid out on a grid.
+
+With --shards K the vehicles are split into K contiguous blocks and one
+world is written per block, <output>_<k>.sdf, each with a
+SwarmShardPlugin so the K servers show each other's vehicles as ghosts.
+The world of block k is named <name>_<k>, or with --template the
+template's world name suffixed with _<k>, so the servers do not share
+their transport topics.
+
+Usage: generate_swarm_world.py --count 16 [--model iris_with_ardupilot]
+                               [--prefix iris_] [--first 0]
+                               [--spacing 2] [--columns 0]
+                               [--template world.sdf] [--name swarm]
+                               [--output swarm.sdf]
+                               [--sitl-script swarm_sitl.sh]
+                               [--shards 1] [--bus-port 9700]
+
+  --template     world to add the vehicles to, the vehicles are inserted
+                 before its closing </world>. Default a flat world with
+                 the systems the iris needs
+  --columns      grid columns, 0 for a square grid
+  --sitl-script  also write a script starting one SITL per vehicle and
+                 stopping them all when it is interrupted
+  --shards       split the vehicles over this many worlds, one per
+                 server, requires --output
+  --bus-port     port of the SwarmShardPlugin bus, shard k listens on
+                 bus-port + k
+
+Example
+
+  tools/generate_swarm_world.py --count 100 --output /tmp/swarm.sdf \\
+      --sitl-script /tmp/swarm_sitl.sh
+  gz sim -v4 -s -r /tmp/swarm.sdf
+  sh /tmp/swarm_sitl.sh
+
+  tools/generate_swarm_world.py --count 400 --shards 4 \\
+      --output /tmp/swarm.sdf --sitl-script /tmp/swarm_sitl.sh
+  for k in 0 1 2 3; do
+    gz sim -v4 -s -r /tmp/swarm_$k.sdf &
+  done
+  sh /tmp/swarm_sitl.sh
+"""
+
+import argparse
+import math
+import os
+import re
+import sys
+from xml.sax.saxutils import escape, quoteattr
+
+DEFAULT_WORLD = """<?xml version="1.0" ?>
+<sdf version="1.9">
+  <world name={name}>
+    <physics name="1ms" type="ignore">
+      <max_step_size>0.001</max_step_size>
+      <real_time_factor>1.0</real_time_factor>
+    </physics>
+
+    <plugin filename="gz-sim-physics-system"
+      name="gz::sim::systems::Physics">
+    </plugin>
+    <plugin filename="gz-sim-user-commands-system"
+      name="gz::sim::systems::UserCommands">
+    </plugin>
+    <plugin filename="gz-sim-scene-broadcaster-system"
+      name="gz::sim::systems::SceneBroadcaster">
+    </plugin>
+    <plugin filename="gz-sim-imu-system"
+      name="gz::sim::systems::Imu">
+    </plugin>
+
+    <spherical_coordinates>
+      <latitude_deg>-35.363262</latitude_deg>
+      <longitude_deg>149.165237</longitude_deg>
+      <elevation>584</elevation>
+      <heading_deg>0</heading_deg>
+      <surface_model>EARTH_WGS84</surface_model>
+    </spherical_coordinates>
+
+    <light type="directional" name="sun">
+      <cast_shadows>true</cast_shadows>
+      <pose>0 0 10 0 0 0</pose>
+      <diffuse>0.8 0.8 0.8 1</diffuse>
+      <specular>0.8 0.8 0.8 1</specular>
+      <direction>-0.5 0.1 -0.9</direction>
+    </light>
+
+    <model name="ground_plane">
+      <static>true</static>
+      <link name="link">
+        <collision name="collision">
+          <geometry>
+            <plane>
+              <normal>0 0 1</normal>
+              <size>{size} {size}</size>
+            </plane>
+          </geometry>
+        </collision>
+        <visual name="visual">
+          <geometry>
+            <plane>
+              <normal>0 0 1</normal>
+              <size>{size} {size}</size>
+            </plane>
+          </geometry>
+          <material>
+            <ambient>0.8 0.8 0.8 1</ambient>
+            <diffuse>0.8 0.8 0.8 1</diffuse>
+            <specular>0.8 0.8 0.8 1</specular>
+          </material>
+        </visual>
+      </link>
+    </model>
+  </world>
+</sdf>
+"""
+
+VEHICLE = """
+    <include>
+      <uri>{uri}</uri>
+      <name>{name}</name>
+      <pose degrees="true">{x:.3f} {y:.3f} {z:.3f} 0 0 {yaw:.1f}</pose>
+    </include>
+"""
+
+SHARD_PLUGIN = """
+    <plugin filename="SwarmShardPlugin"
+      name="gz::sim::systems::SwarmShardPlugin">
+      <shard>{shard}</shard>
+      <shards>{shards}</shards>
+      <bus_port>{bus_port}</bus_port>
+      <vehicle_prefix>{prefix}</vehicle_prefix>
+    </plugin>
+"""
+
+SITL_SCRIPT = """#!/bin/sh
+# Start {count} SITL instances for the vehicles of {world}, -I N for
+# the vehicle named {prefix}N. Stop them all with Ctrl-C.
+#
+# The SITL binary is built once first, the instances then start with -N
+# so they do not all run waf on the same tree. Set SKIP_BUILD=1 if it is
+# already built, and ARDUPILOT_HOME if sim_vehicle.py is not on the PATH
+# of an ArduPilot checkout.
+if [ -z "$SKIP_BUILD" ]; then
+  SIM_VEHICLE=$(command -v sim_vehicle.py)
+  ARDUPILOT_HOME=${{ARDUPILOT_HOME:-$(dirname "$SIM_VEHICLE")/../..}}
+  (cd "$ARDUPILOT_HOME" && ./waf configure --board sitl && \\
+      ./waf {target}) || exit 1
+fi
+trap 'kill $(jobs -p) 2>/dev/null' EXIT INT TERM
+for i in $(seq {first} {last}); do
+  sim_vehicle.py -N -v {vehicle} -f {frame} --model JSON -I "$i" \\
+      --sysid $((i + 1)) --no-mavproxy {extra}> "sitl_$i.log" 2>&1 &
+done
+wait
+"""
+
+# waf target building the SITL binary of each sim_vehicle.py vehicle
+WAF_TARGETS = {
+    "ArduCopter": "copter",
+    "Helicopter": "heli",
+    "ArduPlane": "plane",
+    "Rover": "rover",
+    "ArduSub": "sub",
+    "Blimp": "blimp",
+    "AntennaTracker": "antennatracker",
+}
+
+
+# name attribute of the <world> element of a template
+WORLD_NAME = re.compile(r"""(<world\b[^>]*?\bname\s*=\s*(["']))(.*?)\2""")
+
+
+def vehicles(args, indices):
+    columns = args.columns or math.ceil(math.sqrt(args.count))
+    uri = args.model if "://" in args.model else "model://" + args.model
+    out = []
+    for i in indices:
+        row, col = divmod(i, columns)
+        out.append(VEHICLE.format(
+            uri=escape(uri),
+            name=escape("{}{}".format(args.prefix, args.first + i)),
+            x=col * args.spacing, y=row * args.spacing,
+            z=args.z, yaw=args.yaw))
+    return "".join(out)
+
+
+def shard(args, k):
+    """Vehicles of shard k, a contiguous block so most neighbours of a
+    vehicle are simulated by the same server."""
+    first = k * args.count // args.shards
+    last = (k + 1) * args.count // args.shards
+    return range(first, last)
+
+
+def world(args, k=None):
+    if args.template:
+        with open(args.template) as f:
+            text = f.read()
+        if k is not None:
+            text, found = WORLD_NAME.subn(
+                lambda m: "{}{}_{}{}".format(
+                    m.group(1), m.group(3), k, m.group(2)),
+                text, count=1)
+            if not found:
+                sys.exit("error: no <world name=...> in the template")
+    else:
+        columns = args.columns or math.ceil(math.sqrt(args.count))
+        rows = math.ceil(args.count / columns)
+        size = max(100, 2 * (max(rows, columns) * args.spacing + 10))
+        name = args.name if k is None else "{}_{}".format(args.name, k)
+        text = DEFAULT_WORLD.format(name=quoteattr(name), size=size)
+
+    end = text.rfind("</world>")
+    if end < 0:
+        sys.exit("error: no </world> in the template")
+    line = text.rfind("\n", 0, end) + 1
+    if k is None:
+        insert = vehicles(args, range(args.count))
+    else:
+        insert = SHARD_PLUGIN.format(
+            shard=k, shards=args.shards, bus_port=args.bus_port,
+            prefix=escape(args.prefix)) + vehicles(args, shard(args, k))
+    return text[:line] + insert + text[line:]
+
+
+def shard_output(output, k):
+    base, ext = os.path.splitext(output)
+    return "{}_{}{}".format(base, k, ext or ".sdf")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Generate a world with N vehicles included from one"
+                    " model")
+    parser.add_argument("--count", type=int, required=True)
+    parser.add_argument("--model", default="iris_with_ardupilot",
+                        help="model name or uri")
+    parser.add_argument("--prefix", default="iris_")
+    parser.add_argument("--first", type=int, default=0,
+                        help="instance of the first vehicle")
+    parser.add_argument("--spacing", type=float, default=2.0)
+    parser.add_argument("--columns", type=int, default=0)
+    parser.add_argument("--z", type=float, default=0.195)
+    parser.add_argument("--yaw", type=float, default=90.0,
+                        help="yaw in degrees")
+    parser.add_argument("--template")
+    parser.add_argument("--name", default="swarm", help="world name")
+    parser.add_argument("--output", help="world file, default stdout")
+    parser.add_argument("--sitl-script")
+    parser.add_argument("--vehicle", default="ArduCopter")
+    parser.add_argument("--frame", default="gazebo-iris")
+    parser.add_argument("--sitl-args", default="",
+                        help="extra sim_vehicle.py arguments")
+    parser.add_argument("--shards", type=int, default=1,
+                        help="number of worlds to split the vehicles over")
+    parser.add_argument("--bus-port", type=int, default=9700)
+    args = parser.parse_args()
+
+    if args.count < 1 or args.first < 0:
+        parser.error("--count must be positive and --first non-negative")
+    if args.shards < 1 or args.shards > min(args.count, 255):
+        parser.error("--shards must be between 1 and min(count, 255)")
+    if args.shards > 1 and not args.output:
+        parser.error("--shards needs --output")
+
+    if args.shards > 1:
+        for k in range(args.shards):
+            with open(shard_output(args.output, k), "w") as f:
+                f.write(world(args, k))
+    elif args.output:
+        with open(args.output, "w") as f:
+            f.write(world(args))
+    else:
+        sys.stdout.write(world(args))
+
+    if args.sitl_script:
+        with open(args.sitl_script, "w") as f:
+            f.write(SITL_SCRIPT.format(
+                count=args.count, world=args.output or args.name,
+                prefix=args.prefix, first=args.first,
+                last=args.first + args.count - 1, vehicle=args.vehicle,
+                frame=args.frame,
+                target=WAF_TARGETS.get(args.vehicle, args.vehicle.lower()),
+                extra=args.sitl_args + " " if args.sitl_args else ""))
+
+
+if __name__ == "__main__":
+    main()